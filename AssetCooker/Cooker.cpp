@@ -0,0 +1,189 @@
+#include "Cooker.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "../VulkanExp/AssetPackage.h"
+#include "../VulkanExp/ContentHash.h"
+#include "../VulkanExp/JobSystem.h"
+#include "../VulkanExp/MeshLoader.h"
+#include "../VulkanExp/MipGenerator.h"
+#include "../VulkanExp/TextureData.h"
+
+namespace {
+	std::string DirectoryOf(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	}
+
+	bool FileExists(const std::string& path) {
+		return std::ifstream(path, std::ios::binary).good();
+	}
+}
+
+CookOutcome Cooker::Cook(const CookRequest& request, bool force)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	CookOutcome outcome;
+
+	try {
+		if (!force && IsUpToDate(request)) {
+			outcome.result = CookResult::UpToDate;
+		}
+		else {
+			std::vector<std::string> dependencies;
+			dependencies.push_back(request.objPath);
+
+			std::vector<std::string> materialLibraries = FindMaterialLibraries(request.objPath);
+			dependencies.insert(dependencies.end(), materialLibraries.begin(), materialLibraries.end());
+
+			MeshData mesh;
+			std::vector<Vertex> corners;
+			MeshLoader::ParseObj(request.objPath, corners, &mesh.diffuseTexture);
+			MeshLoader::Deduplicate(corners, mesh);
+			corners.clear();
+			corners.shrink_to_fit();
+
+			// Streamed meshes are optimized chunk by chunk
+			std::vector<MeshData> chunks;
+			std::vector<MeshData> lods;
+			if (request.chunkTriangles > 0) {
+				MeshLoader::Partition(mesh, request.chunkTriangles, chunks);
+				if (chunks.empty()) {
+					throw std::runtime_error("mesh has no triangles to stream: " + request.objPath);
+				}
+				lods.resize(chunks.size());
+				for (size_t i = 0; i < chunks.size(); i++) {
+					MeshLoader::Simplify(chunks[i], LodGridSize, lods[i]);
+				}
+				mesh.vertices.clear();
+				mesh.vertices.shrink_to_fit();
+				mesh.indices.clear();
+				mesh.indices.shrink_to_fit();
+			}
+			else {
+				MeshLoader::OptimizeVertexCache(mesh);
+				MeshLoader::OptimizeVertexFetch(mesh);
+			}
+
+			// Small meshes get 16 bit indices, which halves index memory and bandwidth
+			VkIndexType indexType = mesh.vertices.size() <= UINT16_MAX + 1u ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+			std::string texturePath = request.texturePath;
+			if (texturePath.empty() && !mesh.diffuseTexture.empty()) {
+				texturePath = DirectoryOf(request.objPath) + mesh.diffuseTexture;
+			}
+
+			TextureData texture;
+			bool hasTexture = false;
+			if (!texturePath.empty()) {
+				std::string compressedPath = TextureData::FindCompressed(texturePath);
+				if (!compressedPath.empty()) {
+					// Block compressed sources already carry their mip chain and are stored as is
+					TextureData::LoadCompressed(texturePath, texture);
+					dependencies.push_back(compressedPath);
+					hasTexture = true;
+				}
+				else if (FileExists(texturePath)) {
+					MipGenerator::DecodeImage(texturePath, texture);
+					MipGenerator::GenerateMipChain(texture, MipFilter::Kaiser);
+					dependencies.push_back(texturePath);
+					hasTexture = true;
+				}
+				else {
+					throw std::runtime_error("texture not found: " + texturePath);
+				}
+			}
+
+			if (request.chunkTriangles > 0) {
+				AssetPackage::WriteChunked(request.outputPath, HashDependencies(dependencies, request), dependencies, chunks, lods, hasTexture ? &texture : nullptr);
+			}
+			else {
+				AssetPackage::Write(request.outputPath, HashDependencies(dependencies, request), dependencies, mesh, indexType, hasTexture ? &texture : nullptr);
+			}
+			outcome.result = CookResult::Cooked;
+		}
+	}
+	catch (const std::exception& e) {
+		outcome.result = CookResult::Failed;
+		outcome.error = e.what();
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	outcome.seconds = std::chrono::duration<double>(endTime - startTime).count();
+	return outcome;
+}
+
+std::vector<CookOutcome> Cooker::CookAll(const std::vector<CookRequest>& requests, bool force)
+{
+	std::vector<CookOutcome> outcomes(requests.size());
+
+	// One job per request, the mip chains they generate fan out on the same workers
+	JobSystem::Instance().ParallelFor(requests.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			outcomes[i] = Cook(requests[i], force);
+		}
+	});
+
+	return outcomes;
+}
+
+uint64_t Cooker::HashDependencies(const std::vector<std::string>& dependencies, const CookRequest& request)
+{
+	// Options that change the output are hashed along with the inputs, so changing them recooks. That includes
+	// dropping a texture override, which removes nothing from the inputs when the material names the same file
+	uint32_t versions[3] = { Version, AssetPackage::Version, request.chunkTriangles };
+	uint64_t hash = ContentHash::Hash(versions, sizeof(versions));
+	hash = ContentHash::HashString(request.texturePath, hash);
+	for (const std::string& dependency : dependencies) {
+		hash = ContentHash::HashString(dependency, hash);
+		hash = ContentHash::HashFile(dependency, hash);
+	}
+	return hash;
+}
+
+bool Cooker::IsUpToDate(const CookRequest& request)
+{
+	uint64_t contentHash;
+	std::vector<std::string> dependencies;
+	if (!AssetPackage::ReadDependencies(request.outputPath, contentHash, dependencies)) {
+		return false;
+	}
+	if (dependencies.empty() || dependencies[0] != request.objPath) {
+		return false;
+	}
+	try {
+		return HashDependencies(dependencies, request) == contentHash;
+	}
+	catch (const std::exception&) {
+		// An input went missing
+		return false;
+	}
+}
+
+std::vector<std::string> Cooker::FindMaterialLibraries(const std::string& objPath)
+{
+	std::ifstream file(objPath);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + objPath);
+	}
+
+	std::vector<std::string> libraries;
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.compare(0, 7, "mtllib ") != 0) {
+			continue;
+		}
+		std::istringstream names(line.substr(7));
+		std::string name;
+		while (names >> name) {
+			std::string path = DirectoryOf(objPath) + name;
+			if (FileExists(path)) {
+				libraries.push_back(path);
+			}
+		}
+	}
+	return libraries;
+}
@@ -0,0 +1,52 @@
+#ifndef COOKER_H
+#define COOKER_H
+
+#include <string>
+#include <vector>
+
+struct CookRequest {
+	std::string objPath;
+	// Overrides the diffuse texture named by the OBJ's material library
+	std::string texturePath;
+	std::string outputPath;
+	// Non-zero cooks a streamed mesh, split into chunks of at most this many triangles
+	uint32_t chunkTriangles = 0;
+};
+
+enum class CookResult {
+	Cooked,
+	UpToDate,
+	Failed
+};
+
+struct CookOutcome {
+	CookResult result = CookResult::Failed;
+	std::string error;
+	double seconds = 0.0;
+};
+
+// Turns OBJ files and their textures into AssetPackages. Packages record the content hash of every
+// input, so unchanged assets are skipped without being parsed again.
+class Cooker {
+	public:
+		Cooker() = delete;
+		~Cooker() = delete;
+
+		// Bump whenever the cooked output changes so existing packages are rebuilt
+		static const uint32_t Version = 2;
+		// Cells along the longest side of a chunk for its coarse version
+		static const uint32_t LodGridSize = 16;
+
+		static CookOutcome Cook(const CookRequest& request, bool force);
+
+		// Cooks requests in parallel on all hardware threads, outcomes are in request order
+		static std::vector<CookOutcome> CookAll(const std::vector<CookRequest>& requests, bool force);
+
+	private:
+		// The texture override, empty for none, and the chunk size are hashed with the inputs
+		static uint64_t HashDependencies(const std::vector<std::string>& dependencies, const CookRequest& request);
+		static bool IsUpToDate(const CookRequest& request);
+		static std::vector<std::string> FindMaterialLibraries(const std::string& objPath);
+};
+
+#endif
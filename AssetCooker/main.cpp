@@ -0,0 +1,102 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Cooker.h"
+#include "../VulkanExp/JobSystem.h"
+
+namespace {
+	void PrintUsage() {
+		std::cout << "usage: AssetCooker [-f] [-o <output dir>] [-t <texture>] [-c <triangles>] [--jobs <threads>] <model.obj>..." << std::endl;
+		std::cout << "  -f  recook even if the package is up to date" << std::endl;
+		std::cout << "  -o  directory for the .vkpkg files, defaults to next to each model" << std::endl;
+		std::cout << "  -t  texture to use instead of the material's diffuse texture" << std::endl;
+		std::cout << "  -c  cook a streamed mesh in chunks of at most this many triangles (up to 21845)" << std::endl;
+		std::cout << "  --jobs  threads cooking, defaults to the hardware threads" << std::endl;
+	}
+
+	std::string PackagePath(const std::string& objPath, const std::string& outputDirectory) {
+		size_t slash = objPath.find_last_of("/\\");
+		size_t dot = objPath.find_last_of('.');
+		std::string stem = objPath.substr(0, (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? dot : objPath.size());
+
+		if (!outputDirectory.empty()) {
+			stem = outputDirectory + "/" + (slash == std::string::npos ? stem : stem.substr(slash + 1));
+		}
+		return stem + ".vkpkg";
+	}
+}
+
+int main(int argc, char* argv[]) {
+	bool force = false;
+	std::string outputDirectory;
+	std::string texturePath;
+	uint32_t chunkTriangles = 0;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "-f") {
+			force = true;
+		}
+		else if (argument == "-o" && i + 1 < argc) {
+			outputDirectory = argv[++i];
+		}
+		else if (argument == "-t" && i + 1 < argc) {
+			texturePath = argv[++i];
+		}
+		else if (argument == "-c" && i + 1 < argc) {
+			chunkTriangles = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (JobSystem::ParseArgument(argc, argv, i)) {
+			continue;
+		}
+		else if (!argument.empty() && argument[0] == '-') {
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		else {
+			inputs.push_back(argument);
+		}
+	}
+
+	if (inputs.empty()) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<CookRequest> requests;
+	for (const std::string& input : inputs) {
+		CookRequest request;
+		request.objPath = input;
+		request.texturePath = texturePath;
+		request.chunkTriangles = chunkTriangles;
+		request.outputPath = PackagePath(input, outputDirectory);
+		requests.push_back(request);
+	}
+
+	std::vector<CookOutcome> outcomes = Cooker::CookAll(requests, force);
+
+	size_t cooked = 0, upToDate = 0, failed = 0;
+	for (size_t i = 0; i < outcomes.size(); i++) {
+		const CookOutcome& outcome = outcomes[i];
+		switch (outcome.result) {
+		case CookResult::Cooked:
+			cooked++;
+			std::cout << "cooked     " << requests[i].outputPath << " (" << outcome.seconds << " s)" << std::endl;
+			break;
+		case CookResult::UpToDate:
+			upToDate++;
+			std::cout << "up to date " << requests[i].outputPath << std::endl;
+			break;
+		case CookResult::Failed:
+			failed++;
+			std::cerr << "failed     " << requests[i].objPath << ": " << outcome.error << std::endl;
+			break;
+		}
+	}
+
+	std::cout << cooked << " cooked, " << upToDate << " up to date, " << failed << " failed" << std::endl;
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
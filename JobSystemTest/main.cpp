@@ -0,0 +1,150 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../VulkanExp/JobSystem.h"
+
+// Exercises the scheduler from many threads at once. Meant to run under a race detector as well as on its own,
+// see the README; any failed check, exception or report from the sanitizer fails the run.
+namespace {
+	void Check(bool condition, const std::string& what) {
+		if (!condition) {
+			throw std::runtime_error("check failed: " + what);
+		}
+	}
+
+	// Every element written by exactly one piece
+	void TestParallelFor(JobSystem& jobs) {
+		for (int repeat = 0; repeat < 20; repeat++) {
+			std::vector<uint32_t> values(100000);
+			jobs.ParallelFor(values.size(), 100, [&values](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					values[i] += static_cast<uint32_t>(i % 7) + 1;
+				}
+			});
+			uint64_t expected = 0;
+			for (size_t i = 0; i < values.size(); i++) {
+				expected += i % 7 + 1;
+			}
+			Check(std::accumulate(values.begin(), values.end(), uint64_t(0)) == expected, "parallel for covers the range once");
+		}
+	}
+
+	// Jobs that wait on the jobs they start, down to a depth where every worker is waiting inside a job
+	uint64_t Fibonacci(JobSystem& jobs, uint32_t n) {
+		if (n < 12) {
+			return n < 2 ? n : Fibonacci(jobs, n - 1) + Fibonacci(jobs, n - 2);
+		}
+		uint64_t first = 0;
+		JobCounter counter;
+		jobs.Run([&jobs, &first, n]() { first = Fibonacci(jobs, n - 1); }, &counter);
+		uint64_t second = Fibonacci(jobs, n - 2);
+		jobs.Wait(counter);
+		return first + second;
+	}
+
+	void TestNestedWait(JobSystem& jobs) {
+		Check(Fibonacci(jobs, 25) == 75025, "nested waits");
+
+		// Nested parallel fors, the inner ones run on workers that are inside a piece of the outer one
+		std::atomic<uint64_t> sum{ 0 };
+		jobs.ParallelFor(64, 1, [&jobs, &sum](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				jobs.ParallelFor(1000, 10, [&sum](size_t innerBegin, size_t innerEnd) {
+					sum += innerEnd - innerBegin;
+				});
+			}
+		});
+		Check(sum == 64 * 1000, "nested parallel fors");
+	}
+
+	void TestContinuations(JobSystem& jobs) {
+		for (int repeat = 0; repeat < 50; repeat++) {
+			// A job held back until ten others are done sees all of their writes
+			JobCounter first;
+			JobCounter second;
+			std::atomic<uint32_t> stage{ 0 };
+			uint32_t seen = 0;
+			for (int i = 0; i < 10; i++) {
+				jobs.Run([&stage]() { stage++; }, &first);
+			}
+			jobs.Run([&stage, &seen]() { seen = stage.load(); }, &second, &first);
+			jobs.Wait(second);
+			Check(seen == 10, "continuation runs after its dependency");
+
+			// A chain of continuations, each one held back by the one before. Jobs must not throw, so the order is
+			// recorded and checked afterwards
+			JobCounter chain[4];
+			uint32_t last = 0;
+			bool ordered = true;
+			jobs.Run([&last]() { last = 0; }, &chain[0]);
+			for (uint32_t i = 1; i < 4; i++) {
+				jobs.Run([&last, &ordered, i]() { ordered &= last == i - 1; last = i; }, &chain[i], &chain[i - 1]);
+			}
+			jobs.Wait(chain[3]);
+			Check(ordered && last == 3, "chained continuations");
+
+			// Work outside the job system, finished from a thread of its own like a file read
+			JobCounter read;
+			JobCounter after;
+			uint32_t got = 0;
+			jobs.Add(read);
+			jobs.Run([&got]() { got = 1; }, &after, &read);
+			std::thread reader([&jobs, &read]() { jobs.Done(read); });
+			jobs.Wait(after);
+			reader.join();
+			Check(got == 1, "continuation of external work");
+		}
+	}
+
+	// The first exception reaches the caller once every piece has finished, and the scheduler keeps working
+	void TestThrowingParallelFor(JobSystem& jobs) {
+		for (int repeat = 0; repeat < 20; repeat++) {
+			std::atomic<uint32_t> finished{ 0 };
+			bool threw = false;
+			try {
+				jobs.ParallelFor(1000, 1, [&finished](size_t begin, size_t end) {
+					if (begin > 500) {
+						throw std::runtime_error("piece failed");
+					}
+					finished += static_cast<uint32_t>(end - begin);
+				});
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			Check(threw, "parallel for rethrows");
+			Check(finished < 1000, "the failing pieces stopped early");
+		}
+		TestParallelFor(jobs);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<uint32_t> workerCounts = { 1, 3, 8 };
+	if (argc > 1) {
+		workerCounts = { static_cast<uint32_t>(std::stoul(argv[1])) };
+	}
+
+	try {
+		for (uint32_t workers : workerCounts) {
+			JobSystem jobs(workers);
+			TestParallelFor(jobs);
+			TestNestedWait(jobs);
+			TestContinuations(jobs);
+			TestThrowingParallelFor(jobs);
+			std::cout << workers << (workers == 1 ? " worker" : " workers") << ": ok, " << jobs.jobsRun() << " jobs, " << jobs.steals() << " steals" << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,286 @@
+#include "AssetPackage.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	const char Magic[4] = { 'V', 'K', 'P', 'K' };
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	struct PendingSection {
+		PackageSectionEntry entry;
+		const void* data;
+	};
+
+	void ValidateHeader(const PackageHeader& header, const std::string& path) {
+		if (memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+			throw std::runtime_error("not an asset package: " + path);
+		}
+		if (header.version != AssetPackage::Version) {
+			throw std::runtime_error("asset package was cooked by a different version, recook " + path);
+		}
+		if (header.vertexStride != sizeof(Vertex)) {
+			throw std::runtime_error("asset package vertex layout does not match, recook " + path);
+		}
+	}
+
+	void AddSection(std::vector<PendingSection>& pending, PackageSection type, uint32_t format, const void* data, uint64_t size, uint32_t count, uint32_t width, uint32_t height) {
+		PendingSection section{};
+		section.entry.type = type;
+		section.entry.format = format;
+		section.entry.size = size;
+		section.entry.count = count;
+		section.entry.width = width;
+		section.entry.height = height;
+		section.data = data;
+		pending.push_back(section);
+	}
+
+	void AddTextureSections(std::vector<PendingSection>& pending, const TextureData& texture) {
+		// Levels are written back to back so the whole chain can be staged with a single copy
+		for (size_t i = 0; i < texture.levels.size(); i++) {
+			const MipLevel& level = texture.levels[i];
+			AddSection(pending, PackageSection::TextureLevel, texture.format, texture.pixels.data() + level.offset, level.size, static_cast<uint32_t>(i), level.width, level.height);
+		}
+	}
+
+	void WriteSections(const std::string& path, uint64_t contentHash, std::vector<PendingSection>& pending) {
+		PackageHeader header{};
+		memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = AssetPackage::Version;
+		header.contentHash = contentHash;
+		header.sectionCount = static_cast<uint32_t>(pending.size());
+		header.vertexStride = sizeof(Vertex);
+
+		uint64_t offset = sizeof(PackageHeader) + pending.size() * sizeof(PackageSectionEntry);
+		for (PendingSection& section : pending) {
+			offset = AlignUp(offset, AssetPackage::Alignment);
+			section.entry.offset = offset;
+			offset += section.entry.size;
+		}
+
+		// Write next to the destination and swap it in at the end, so an interrupted cook never leaves a valid looking package.
+		// The name is unique per write, cooks of the same output in parallel or in another process don't share it
+		static std::atomic<uint32_t> s_writeCount{ 0 };
+		std::string temporaryPath = path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+			+ "-" + std::to_string(s_writeCount.fetch_add(1)) + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to create asset package " + path);
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (const PendingSection& section : pending) {
+				file.write(reinterpret_cast<const char*>(&section.entry), sizeof(section.entry));
+			}
+
+			static const char Padding[AssetPackage::Alignment] = {};
+			uint64_t written = sizeof(PackageHeader) + pending.size() * sizeof(PackageSectionEntry);
+			for (const PendingSection& section : pending) {
+				file.write(Padding, static_cast<std::streamsize>(section.entry.offset - written));
+				file.write(static_cast<const char*>(section.data), static_cast<std::streamsize>(section.entry.size));
+				written = section.entry.offset + section.entry.size;
+			}
+
+			if (!file) {
+				throw std::runtime_error("failed to write asset package " + path);
+			}
+		}
+
+		std::remove(path.c_str());
+		if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+			throw std::runtime_error("failed to replace asset package " + path);
+		}
+	}
+}
+
+AssetPackage::AssetPackage(const std::string& path) : m_file(path)
+{
+	if (m_file.size() < sizeof(PackageHeader)) {
+		throw std::runtime_error("asset package is truncated: " + path);
+	}
+
+	m_header = reinterpret_cast<const PackageHeader*>(m_file.data());
+	ValidateHeader(*m_header, path);
+
+	uint64_t tableEnd = sizeof(PackageHeader) + static_cast<uint64_t>(m_header->sectionCount) * sizeof(PackageSectionEntry);
+	if (tableEnd > m_file.size()) {
+		throw std::runtime_error("asset package is truncated: " + path);
+	}
+
+	m_sections = reinterpret_cast<const PackageSectionEntry*>(m_file.data() + sizeof(PackageHeader));
+	for (uint32_t i = 0; i < m_header->sectionCount; i++) {
+		// Written so a corrupt offset or size cannot wrap around and pass
+		if (m_sections[i].offset > m_file.size() || m_sections[i].size > m_file.size() - m_sections[i].offset) {
+			throw std::runtime_error("asset package is truncated: " + path);
+		}
+	}
+}
+
+const PackageSectionEntry* AssetPackage::FindSection(PackageSection type, uint32_t index) const
+{
+	for (uint32_t i = 0; i < m_header->sectionCount; i++) {
+		if (m_sections[i].type == type && (type != PackageSection::TextureLevel || m_sections[i].count == index)) {
+			return &m_sections[i];
+		}
+	}
+	return nullptr;
+}
+
+std::vector<std::string> AssetPackage::Dependencies() const
+{
+	std::vector<std::string> dependencies;
+	const PackageSectionEntry* section = FindSection(PackageSection::Dependencies);
+	if (!section) {
+		return dependencies;
+	}
+
+	const char* begin = reinterpret_cast<const char*>(SectionData(*section));
+	const char* end = begin + section->size;
+	while (begin < end) {
+		size_t length = strnlen(begin, end - begin);
+		dependencies.emplace_back(begin, length);
+		begin += length + 1;
+	}
+	return dependencies;
+}
+
+void AssetPackage::Write(const std::string& path, uint64_t contentHash, const std::vector<std::string>& dependencies, const MeshData& mesh, VkIndexType indexType, const TextureData* texture)
+{
+	std::string dependencyList;
+	for (const std::string& dependency : dependencies) {
+		dependencyList += dependency;
+		dependencyList.push_back('\0');
+	}
+
+	std::vector<uint16_t> shortIndices;
+	if (indexType == VK_INDEX_TYPE_UINT16) {
+		shortIndices.reserve(mesh.indices.size());
+		for (uint32_t index : mesh.indices) {
+			if (index > UINT16_MAX) {
+				throw std::runtime_error("mesh has too many vertices for 16 bit indices!");
+			}
+			shortIndices.push_back(static_cast<uint16_t>(index));
+		}
+	}
+
+	std::vector<PendingSection> pending;
+	AddSection(pending, PackageSection::Dependencies, 0, dependencyList.data(), dependencyList.size(), static_cast<uint32_t>(dependencies.size()), 0, 0);
+	AddSection(pending, PackageSection::Vertices, 0, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), static_cast<uint32_t>(mesh.vertices.size()), 0, 0);
+	if (indexType == VK_INDEX_TYPE_UINT16) {
+		AddSection(pending, PackageSection::Indices, indexType, shortIndices.data(), shortIndices.size() * sizeof(uint16_t), static_cast<uint32_t>(shortIndices.size()), 0, 0);
+	}
+	else {
+		AddSection(pending, PackageSection::Indices, indexType, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), static_cast<uint32_t>(mesh.indices.size()), 0, 0);
+	}
+	if (texture) {
+		AddTextureSections(pending, *texture);
+	}
+
+	WriteSections(path, contentHash, pending);
+}
+
+void AssetPackage::WriteChunked(const std::string& path, uint64_t contentHash, const std::vector<std::string>& dependencies, const std::vector<MeshData>& chunks, const std::vector<MeshData>& lods, const TextureData* texture)
+{
+	std::string dependencyList;
+	for (const std::string& dependency : dependencies) {
+		dependencyList += dependency;
+		dependencyList.push_back('\0');
+	}
+
+	std::vector<PackageChunk> table(chunks.size());
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+	auto append = [&vertices, &indices](const MeshData& mesh, uint32_t& vertexOffset, uint32_t& vertexCount, uint32_t& indexOffset, uint32_t& indexCount) {
+		if (mesh.vertices.size() > UINT16_MAX + 1u) {
+			throw std::runtime_error("mesh chunk has too many vertices for 16 bit indices!");
+		}
+		vertexOffset = static_cast<uint32_t>(vertices.size());
+		vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		indexOffset = static_cast<uint32_t>(indices.size());
+		indexCount = static_cast<uint32_t>(mesh.indices.size());
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		for (uint32_t index : mesh.indices) {
+			indices.push_back(static_cast<uint16_t>(index));
+		}
+	};
+
+	for (size_t i = 0; i < chunks.size(); i++) {
+		PackageChunk& chunk = table[i];
+		chunk = {};
+		glm::vec3 low(std::numeric_limits<float>::max());
+		glm::vec3 high(-std::numeric_limits<float>::max());
+		for (const Vertex& vertex : chunks[i].vertices) {
+			low = glm::min(low, vertex.pos);
+			high = glm::max(high, vertex.pos);
+		}
+		for (int axis = 0; axis < 3; axis++) {
+			chunk.boundsMin[axis] = low[axis];
+			chunk.boundsMax[axis] = high[axis];
+		}
+
+		// A chunk and its coarse version are stored next to each other, so reading one chunk stays local
+		append(chunks[i], chunk.vertexOffset, chunk.vertexCount, chunk.indexOffset, chunk.indexCount);
+		append(lods[i], chunk.lodVertexOffset, chunk.lodVertexCount, chunk.lodIndexOffset, chunk.lodIndexCount);
+	}
+
+	std::vector<PendingSection> pending;
+	AddSection(pending, PackageSection::Dependencies, 0, dependencyList.data(), dependencyList.size(), static_cast<uint32_t>(dependencies.size()), 0, 0);
+	AddSection(pending, PackageSection::ChunkTable, 0, table.data(), table.size() * sizeof(PackageChunk), static_cast<uint32_t>(table.size()), 0, 0);
+	AddSection(pending, PackageSection::ChunkVertices, 0, vertices.data(), vertices.size() * sizeof(Vertex), static_cast<uint32_t>(vertices.size()), 0, 0);
+	AddSection(pending, PackageSection::ChunkIndices, VK_INDEX_TYPE_UINT16, indices.data(), indices.size() * sizeof(uint16_t), static_cast<uint32_t>(indices.size()), 0, 0);
+	if (texture) {
+		AddTextureSections(pending, *texture);
+	}
+
+	WriteSections(path, contentHash, pending);
+}
+
+void AssetPackage::ReadTable(std::istream& file, const std::string& path, PackageHeader& header, std::vector<PackageSectionEntry>& sections)
+{
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		throw std::runtime_error("asset package is truncated: " + path);
+	}
+	ValidateHeader(header, path);
+
+	// The count comes from the file, so the table has to fit in what is left of the stream before anything is allocated
+	std::streampos tableStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streampos streamEnd = file.tellg();
+	file.seekg(tableStart);
+	if (tableStart < 0 || streamEnd < tableStart
+		|| static_cast<uint64_t>(header.sectionCount) * sizeof(PackageSectionEntry) > static_cast<uint64_t>(streamEnd - tableStart)) {
+		throw std::runtime_error("asset package is truncated: " + path);
+	}
+
+	sections.resize(header.sectionCount);
+	if (!file.read(reinterpret_cast<char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(PackageSectionEntry)))) {
+		throw std::runtime_error("asset package is truncated: " + path);
+	}
+}
+
+bool AssetPackage::ReadDependencies(const std::string& path, uint64_t& contentHash, std::vector<std::string>& dependencies)
+{
+	if (!std::ifstream(path, std::ios::binary).good()) {
+		return false;
+	}
+
+	try {
+		AssetPackage package(path);
+		contentHash = package.contentHash();
+		dependencies = package.Dependencies();
+		return true;
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef ASSETPACKAGE_H
+#define ASSETPACKAGE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshLoader.h"
+#include "TextureData.h"
+
+enum class PackageSection : uint32_t {
+	// '\0' separated list of the source files the package was cooked from, first entry is the OBJ
+	Dependencies = 1,
+	Vertices = 2,
+	Indices = 3,
+	TextureLevel = 4,
+	// PackageChunk per chunk of a streamed mesh, which has these three sections instead of Vertices and Indices
+	ChunkTable = 5,
+	ChunkVertices = 6,
+	// 16 bit, relative to the first vertex of their chunk
+	ChunkIndices = 7
+};
+
+struct PackageHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t contentHash;
+	uint32_t sectionCount;
+	uint32_t vertexStride;
+};
+
+struct PackageSectionEntry {
+	PackageSection type;
+	// VkIndexType for indices, VkFormat for texture levels
+	uint32_t format;
+	uint64_t offset;
+	uint64_t size;
+	// Element count for vertices and indices, mip level for texture levels
+	uint32_t count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+};
+
+// Spatial piece of a streamed mesh with its full detail and coarse geometry, offsets count elements
+struct PackageChunk {
+	float boundsMin[3];
+	uint32_t vertexOffset;
+	float boundsMax[3];
+	uint32_t vertexCount;
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	uint32_t lodVertexOffset;
+	uint32_t lodVertexCount;
+	uint32_t lodIndexOffset;
+	uint32_t lodIndexCount;
+	uint32_t reserved[2];
+};
+
+// Where the mip chain of a package lies in the file, for packages read through a stream instead of being mapped
+struct PackageTexture {
+	std::string path;
+	uint64_t contentHash = 0;
+	// In mip order, empty if the package has no texture
+	std::vector<PackageSectionEntry> levels;
+};
+
+// Cooked runtime asset: a header and section table followed by section payloads laid out exactly as they are
+// uploaded, so loading is one read per buffer straight into mapped device memory. Written by the AssetCooker tool.
+class AssetPackage {
+	public:
+		static const uint32_t Version = 1;
+		// Payload alignment, keeps every section valid as a staging buffer offset for any texel block size
+		static const uint64_t Alignment = 256;
+
+		// Maps the package and validates its layout, throws if it is not a package this build can read
+		AssetPackage(const std::string& path);
+
+		inline uint64_t contentHash() const { return m_header->contentHash; }
+		inline uint32_t sectionCount() const { return m_header->sectionCount; }
+		inline const PackageSectionEntry& section(uint32_t index) const { return m_sections[index]; }
+		inline const uint8_t* SectionData(const PackageSectionEntry& section) const { return m_file.data() + section.offset; }
+		// Reads the payload from the file into destination, for data that goes straight to mapped device memory
+		inline void ReadSection(const PackageSectionEntry& section, void* destination) const { m_file.ReadAt(section.offset, static_cast<size_t>(section.size), destination); }
+
+		// Returns nullptr if the package has no such section, index is the mip level for texture levels
+		const PackageSectionEntry* FindSection(PackageSection type, uint32_t index = 0) const;
+		std::vector<std::string> Dependencies() const;
+
+		static void Write(const std::string& path, uint64_t contentHash, const std::vector<std::string>& dependencies, const MeshData& mesh, VkIndexType indexType, const TextureData* texture);
+		// Streamed mesh, chunks and lods come from MeshLoader::Partition and MeshLoader::Simplify
+		static void WriteChunked(const std::string& path, uint64_t contentHash, const std::vector<std::string>& dependencies, const std::vector<MeshData>& chunks, const std::vector<MeshData>& lods, const TextureData* texture);
+
+		// Reads and validates the header and section table through a stream, for packages too large to map
+		static void ReadTable(std::istream& file, const std::string& path, PackageHeader& header, std::vector<PackageSectionEntry>& sections);
+
+		// Reads just enough to decide whether a package is stale, returns false if it is missing or unreadable
+		static bool ReadDependencies(const std::string& path, uint64_t& contentHash, std::vector<std::string>& dependencies);
+
+	private:
+		MappedFile m_file;
+		const PackageHeader* m_header;
+		const PackageSectionEntry* m_sections;
+};
+
+#endif
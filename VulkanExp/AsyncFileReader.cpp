@@ -0,0 +1,586 @@
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ASYNCFILEREADER_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "CpuProfiler.h"
+
+bool AsyncFileReader::s_threadsOnly = false;
+
+FileBuffer::~FileBuffer()
+{
+	Release();
+}
+
+FileBuffer::FileBuffer(FileBuffer&& other) noexcept
+	: m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity)
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_capacity = 0;
+}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& other) noexcept
+{
+	if (this != &other) {
+		Release();
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_capacity = other.m_capacity;
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_capacity = 0;
+	}
+	return *this;
+}
+
+void FileBuffer::Allocate(size_t size)
+{
+	Release();
+	m_capacity = (size + Alignment - 1) / Alignment * Alignment;
+	m_data = static_cast<uint8_t*>(::operator new(std::max(m_capacity, Alignment), std::align_val_t(Alignment)));
+	m_size = size;
+}
+
+void FileBuffer::Release()
+{
+	if (m_data) {
+		::operator delete(m_data, std::align_val_t(Alignment));
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_capacity = 0;
+}
+
+namespace {
+#ifdef _WIN32
+	using FileHandle = HANDLE;
+#else
+	using FileHandle = int;
+#endif
+
+	// direct is set if reads bypass the page cache, they then have to cover the whole aligned capacity
+	FileHandle OpenFile(const std::string& path, bool& direct, uint64_t& size)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("failed to open file " + path);
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to query size of " + path);
+		}
+		size = static_cast<uint64_t>(fileSize.QuadPart);
+
+		direct = false;
+		if (size >= AsyncFileReader::DirectThreshold) {
+			HANDLE unbuffered = ReOpenFile(file, GENERIC_READ, FILE_SHARE_READ, FILE_FLAG_NO_BUFFERING);
+			if (unbuffered != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+				file = unbuffered;
+				direct = true;
+			}
+		}
+		return file;
+#else
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::runtime_error("failed to open file " + path);
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			close(fd);
+			throw std::runtime_error("failed to query size of " + path);
+		}
+		size = static_cast<uint64_t>(info.st_size);
+
+		// File systems without O_DIRECT (tmpfs, some network mounts) refuse the flag and keep buffered reads
+		direct = size >= AsyncFileReader::DirectThreshold && fcntl(fd, F_SETFL, O_DIRECT) == 0;
+		return fd;
+#endif
+	}
+
+	void CloseFile(FileHandle file)
+	{
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		close(file);
+#endif
+	}
+
+	// Returns the bytes read, 0 at the end of the file
+	size_t ReadChunk(FileHandle file, uint64_t offset, size_t size, uint8_t* destination, const std::string& path)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD read = 0;
+		if (!ReadFile(file, destination, static_cast<DWORD>(size), &read, &overlapped)) {
+			if (GetLastError() == ERROR_HANDLE_EOF) {
+				return 0;
+			}
+			throw std::runtime_error("failed to read " + path);
+		}
+		return read;
+#else
+		for (;;) {
+			ssize_t read = pread(file, destination, size, static_cast<off_t>(offset));
+			if (read >= 0) {
+				return static_cast<size_t>(read);
+			}
+			if (errno != EINTR) {
+				throw std::runtime_error("failed to read " + path + ": " + std::strerror(errno));
+			}
+		}
+#endif
+	}
+
+	// Blocking read of the whole file, for the thread fallback
+	void ReadWhole(FileRead& read)
+	{
+		bool direct;
+		uint64_t size;
+		FileHandle file = OpenFile(read.path, direct, size);
+		try {
+			read.contents.Allocate(static_cast<size_t>(size));
+			uint64_t end = direct ? read.contents.capacity() : read.contents.size();
+			uint64_t offset = 0;
+			while (offset < end) {
+				size_t chunk = static_cast<size_t>(std::min<uint64_t>(AsyncFileReader::ChunkSize, end - offset));
+				size_t done = ReadChunk(file, offset, chunk, read.contents.data() + offset, read.path);
+				if (done == 0) {
+					break;
+				}
+				offset += done;
+			}
+			if (offset < size) {
+				throw std::runtime_error("file shrank while reading " + read.path);
+			}
+		}
+		catch (...) {
+			CloseFile(file);
+			throw;
+		}
+		CloseFile(file);
+	}
+}
+
+#ifdef ASYNCFILEREADER_IO_URING
+// The raw io_uring interface: a submission ring, a completion ring and the submission entries, all mapped from
+// the kernel. Only the ring thread touches it
+struct AsyncFileReader::Ring {
+	struct File {
+		Job job;
+		int fd = -1;
+		bool direct = false;
+		// Bytes to read, the aligned capacity for direct reads
+		uint64_t end = 0;
+		// Next offset without a read issued
+		uint64_t next = 0;
+		uint32_t inFlight = 0;
+	};
+
+	// One per read in flight, the submission's user_data is its index
+	struct Slot {
+		File* file = nullptr;
+		uint64_t offset = 0;
+		iovec buffer{};
+	};
+
+	int fd = -1;
+	void* sqMapping = nullptr;
+	size_t sqMappingSize = 0;
+	void* cqMapping = nullptr;
+	size_t cqMappingSize = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqesSize = 0;
+
+	unsigned* sqTail = nullptr;
+	unsigned* sqMask = nullptr;
+	unsigned* sqArray = nullptr;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned* cqMask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	// Queued with Prepare and not yet taken by the kernel
+	uint32_t unsubmitted = 0;
+
+	~Ring()
+	{
+		if (sqes) {
+			munmap(sqes, sqesSize);
+		}
+		if (cqMapping && cqMapping != sqMapping) {
+			munmap(cqMapping, cqMappingSize);
+		}
+		if (sqMapping) {
+			munmap(sqMapping, sqMappingSize);
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+
+	// Returns false if the kernel has no io_uring or does not let us use it
+	bool Create(uint32_t entries)
+	{
+		io_uring_params params{};
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+		if (fd < 0) {
+			return false;
+		}
+
+		sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping) {
+			sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+		}
+
+		sqMapping = Map(sqMappingSize, IORING_OFF_SQ_RING);
+		cqMapping = singleMapping ? sqMapping : Map(cqMappingSize, IORING_OFF_CQ_RING);
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = static_cast<io_uring_sqe*>(Map(sqesSize, IORING_OFF_SQES));
+		if (!sqMapping || !cqMapping || !sqes) {
+			return false;
+		}
+
+		uint8_t* sq = static_cast<uint8_t*>(sqMapping);
+		sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		uint8_t* cq = static_cast<uint8_t*>(cqMapping);
+		cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		// Never more reads in flight than submission entries, so neither ring can overflow
+		slots.resize(entries);
+		for (uint32_t i = entries; i > 0; i--) {
+			freeSlots.push_back(i - 1);
+		}
+		return true;
+	}
+
+	void* Map(size_t size, off_t offset)
+	{
+		void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+		return mapping == MAP_FAILED ? nullptr : mapping;
+	}
+
+	// Takes a free slot, the caller checks there is one
+	void Prepare(File* file, uint64_t offset, size_t size)
+	{
+		uint32_t index = freeSlots.back();
+		freeSlots.pop_back();
+		Slot& slot = slots[index];
+		slot.file = file;
+		slot.offset = offset;
+		slot.buffer.iov_base = file->job.read.contents.data() + offset;
+		slot.buffer.iov_len = size;
+
+		unsigned tail = *sqTail;
+		unsigned entry = tail & *sqMask;
+		io_uring_sqe& sqe = sqes[entry];
+		std::memset(&sqe, 0, sizeof(sqe));
+		// READV rather than READ, which needs 5.6, the iovec stays alive in the slot until completion
+		sqe.opcode = IORING_OP_READV;
+		sqe.fd = file->fd;
+		sqe.off = offset;
+		sqe.addr = reinterpret_cast<uint64_t>(&slot.buffer);
+		sqe.len = 1;
+		sqe.user_data = index;
+		sqArray[entry] = entry;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+		file->inFlight++;
+		unsubmitted++;
+	}
+
+	// Submits what was prepared and waits for at least minComplete completions
+	void Enter(uint32_t minComplete)
+	{
+		for (;;) {
+			long result = syscall(__NR_io_uring_enter, fd, unsubmitted, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (result >= 0) {
+				unsubmitted -= static_cast<uint32_t>(result);
+				return;
+			}
+			// EBUSY and EAGAIN clear up as completions are reaped, which the next iteration does anyway
+			if (errno == EBUSY || errno == EAGAIN) {
+				return;
+			}
+			if (errno != EINTR) {
+				throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+			}
+		}
+	}
+
+	bool Reap(io_uring_cqe& completion)
+	{
+		unsigned head = *cqHead;
+		if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+			return false;
+		}
+		completion = cqes[head & *cqMask];
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+#else
+struct AsyncFileReader::Ring {
+};
+#endif
+
+AsyncFileReader::AsyncFileReader()
+{
+#ifdef ASYNCFILEREADER_IO_URING
+	if (!s_threadsOnly) {
+		auto ring = std::make_unique<Ring>();
+		if (ring->Create(QueueDepth)) {
+			m_ring = std::move(ring);
+			m_threads.emplace_back(&AsyncFileReader::RingLoop, this);
+			return;
+		}
+	}
+#endif
+	for (uint32_t i = 0; i < FallbackThreads; i++) {
+		m_threads.emplace_back(&AsyncFileReader::WorkerLoop, this);
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+bool AsyncFileReader::ParseArgument(int /*argc*/, char* argv[], int& index)
+{
+	std::string arg = argv[index];
+	if (arg == "--io-threads") {
+		s_threadsOnly = true;
+		return true;
+	}
+	return false;
+}
+
+void AsyncFileReader::Read(const std::string& path, Completion completion)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Job job;
+		job.read.path = path;
+		job.completion = std::move(completion);
+		m_queue.push_back(std::move(job));
+		m_unfinished++;
+	}
+	m_wake.notify_one();
+}
+
+void AsyncFileReader::Read(const std::vector<std::string>& paths, Completion completion)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const std::string& path : paths) {
+			Job job;
+			job.read.path = path;
+			job.completion = completion;
+			m_queue.push_back(std::move(job));
+		}
+		m_unfinished += paths.size();
+	}
+	m_wake.notify_all();
+}
+
+void AsyncFileReader::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_unfinished == 0; });
+}
+
+void AsyncFileReader::Finish(Job& job)
+{
+	if (job.read.error.empty()) {
+		m_bytesRead += job.read.contents.size();
+		m_filesRead++;
+	}
+	job.completion(std::move(job.read));
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_unfinished--;
+	}
+	m_idle.notify_all();
+}
+
+void AsyncFileReader::WorkerLoop()
+{
+	if (CpuProfiler::enabled()) {
+		CpuProfiler::SetThreadName("file reader");
+	}
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_queue.empty()) {
+				return;
+			}
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		{
+			CpuZone zone("read file");
+			try {
+				ReadWhole(job.read);
+			}
+			catch (const std::exception& e) {
+				job.read.error = e.what();
+			}
+		}
+		Finish(job);
+	}
+}
+
+void AsyncFileReader::RingLoop()
+{
+#ifdef ASYNCFILEREADER_IO_URING
+	if (CpuProfiler::enabled()) {
+		CpuProfiler::SetThreadName("io_uring");
+	}
+	Ring& ring = *m_ring;
+	// Open files with reads left to issue or in flight, oldest first so files finish roughly in queue order
+	std::deque<std::unique_ptr<Ring::File>> files;
+
+	for (;;) {
+		std::vector<Job> arrived;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			// With reads in flight the thread sleeps in the kernel instead, and picks up new jobs after it wakes
+			if (files.empty()) {
+				m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+				if (m_queue.empty()) {
+					return;
+				}
+			}
+			// Bounded by the queue depth, more open files would only hold descriptors and memory
+			while (!m_queue.empty() && files.size() + arrived.size() < QueueDepth) {
+				arrived.push_back(std::move(m_queue.front()));
+				m_queue.pop_front();
+			}
+		}
+
+		for (Job& job : arrived) {
+			auto file = std::make_unique<Ring::File>();
+			file->job = std::move(job);
+			try {
+				uint64_t size;
+				file->fd = OpenFile(file->job.read.path, file->direct, size);
+				file->job.read.contents.Allocate(static_cast<size_t>(size));
+				file->end = file->direct ? file->job.read.contents.capacity() : size;
+			}
+			catch (const std::exception& e) {
+				file->job.read.error = e.what();
+			}
+			if (file->end == 0) {
+				if (file->fd >= 0) {
+					CloseFile(file->fd);
+				}
+				Finish(file->job);
+				continue;
+			}
+			files.push_back(std::move(file));
+		}
+
+		for (auto& file : files) {
+			while (file->next < file->end && file->job.read.error.empty() && !ring.freeSlots.empty()) {
+				size_t size = static_cast<size_t>(std::min<uint64_t>(ChunkSize, file->end - file->next));
+				ring.Prepare(file.get(), file->next, size);
+				file->next += size;
+			}
+		}
+
+		if (files.empty()) {
+			continue;
+		}
+		ring.Enter(1);
+
+		io_uring_cqe completion;
+		while (ring.Reap(completion)) {
+			uint32_t index = static_cast<uint32_t>(completion.user_data);
+			Ring::Slot slot = ring.slots[index];
+			ring.freeSlots.push_back(index);
+			Ring::File& file = *slot.file;
+			file.inFlight--;
+
+			size_t requested = slot.buffer.iov_len;
+			uint64_t size = file.job.read.contents.size();
+			if (completion.res == -EINTR || completion.res == -EAGAIN) {
+				ring.Prepare(&file, slot.offset, requested);
+			}
+			else if (completion.res < 0) {
+				file.job.read.error = "failed to read " + file.job.read.path + ": " + std::strerror(-completion.res);
+			}
+			else if (static_cast<size_t>(completion.res) < requested && slot.offset + completion.res < size) {
+				if (completion.res == 0) {
+					file.job.read.error = "file shrank while reading " + file.job.read.path;
+				}
+				else {
+					// Short read before the end of the file, the rest goes back in the queue
+					ring.Prepare(&file, slot.offset + completion.res, requested - completion.res);
+				}
+			}
+		}
+
+		for (auto it = files.begin(); it != files.end();) {
+			Ring::File& file = **it;
+			bool done = file.next >= file.end || !file.job.read.error.empty();
+			if (!done || file.inFlight > 0) {
+				++it;
+				continue;
+			}
+			CloseFile(file.fd);
+			Finish(file.job);
+			it = files.erase(it);
+		}
+	}
+#endif
+}
@@ -0,0 +1,118 @@
+#ifndef ASYNCFILEREADER_H
+#define ASYNCFILEREADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whole file contents. The allocation is aligned and padded to Alignment, which unbuffered reads need
+class FileBuffer {
+	public:
+		static constexpr size_t Alignment = 4096;
+
+		FileBuffer() = default;
+		~FileBuffer();
+
+		FileBuffer(FileBuffer&& other) noexcept;
+		FileBuffer& operator=(FileBuffer&& other) noexcept;
+		FileBuffer(const FileBuffer&) = delete;
+		FileBuffer& operator=(const FileBuffer&) = delete;
+
+		// Replaces the contents with size uninitialized bytes
+		void Allocate(size_t size);
+
+		inline uint8_t* data() { return m_data; }
+		inline const uint8_t* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+		// size rounded up to Alignment
+		inline size_t capacity() const { return m_capacity; }
+
+	private:
+		uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		size_t m_capacity = 0;
+
+		void Release();
+};
+
+struct FileRead {
+	std::string path;
+	FileBuffer contents;
+	// Empty if the whole file was read
+	std::string error;
+};
+
+// Reads whole files in the background and hands each one to a completion callback. On Linux the reads go through
+// io_uring: one thread keeps up to QueueDepth reads in flight across files, large files split into ChunkSize reads,
+// and submits each batch with a single system call. Elsewhere, or when the kernel has no io_uring, a pool of
+// threads does blocking positional reads instead. Files of DirectThreshold bytes or more bypass the page cache
+// (O_DIRECT, FILE_FLAG_NO_BUFFERING), they are read once and would only evict something else.
+class AsyncFileReader {
+	public:
+		static constexpr uint32_t QueueDepth = 64;
+		static constexpr size_t ChunkSize = 1024 * 1024;
+		static constexpr size_t DirectThreshold = 4 * 1024 * 1024;
+		// Blocking reads in flight without io_uring
+		static constexpr uint32_t FallbackThreads = 16;
+
+		// Runs on a reader thread, so it should hand the data on rather than process it, and must not throw
+		using Completion = std::function<void(FileRead&& read)>;
+
+		AsyncFileReader();
+		// Finishes every read queued so far
+		~AsyncFileReader();
+
+		AsyncFileReader(const AsyncFileReader&) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+		// Consumes argv[index] if it is an I/O option (--io-threads, which skips io_uring), leaving index on the last
+		// argument used. Returns false for anything else. Applies to readers created afterwards
+		static bool ParseArgument(int argc, char* argv[], int& index);
+
+		void Read(const std::string& path, Completion completion);
+		// Queues the whole batch at once, completions arrive in whatever order the reads finish
+		void Read(const std::vector<std::string>& paths, Completion completion);
+		// Blocks until every read queued so far has run its completion
+		void Wait();
+
+		inline const char* backend() const { return m_ring ? "io_uring" : "threads"; }
+		inline uint64_t bytesRead() const { return m_bytesRead; }
+		inline uint64_t filesRead() const { return m_filesRead; }
+
+	private:
+		struct Job {
+			FileRead read;
+			Completion completion;
+		};
+
+		// io_uring instance, null with the thread fallback
+		struct Ring;
+
+		static bool s_threadsOnly;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_idle;
+		std::deque<Job> m_queue;
+		// Queued or being read, completions included
+		size_t m_unfinished = 0;
+		bool m_stopping = false;
+		std::vector<std::thread> m_threads;
+		std::unique_ptr<Ring> m_ring;
+
+		std::atomic<uint64_t> m_bytesRead{ 0 };
+		std::atomic<uint64_t> m_filesRead{ 0 };
+
+		void RingLoop();
+		void WorkerLoop();
+		void Finish(Job& job);
+};
+
+#endif
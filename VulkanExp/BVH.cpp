@@ -0,0 +1,433 @@
+#include "BVH.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+#include "JobSystem.h"
+
+namespace {
+	const uint32_t MaxDepth = 64;
+	// Subtrees smaller than this are built by the job that reached them
+	const uint32_t ParallelThreshold = 1 << 14;
+	// Triangles per job while computing bounds
+	const size_t BoundsGrain = 1 << 14;
+
+	struct Bounds {
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		inline void grow(const glm::vec3& p) {
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		inline void grow(const Bounds& b) {
+			min = glm::min(min, b.min);
+			max = glm::max(max, b.max);
+		}
+
+		inline float area() const {
+			if (min.x > max.x) {
+				return 0.0f;
+			}
+			glm::vec3 d = max - min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+	};
+
+	struct Bin {
+		Bounds bounds;
+		uint32_t count = 0;
+	};
+}
+
+struct BVH::BuildNode {
+	Bounds bounds;
+	std::unique_ptr<BuildNode> left;
+	std::unique_ptr<BuildNode> right;
+	// Leaf range into BuildContext::order
+	uint32_t begin = 0;
+	uint32_t end = 0;
+};
+
+struct BVH::BuildContext {
+	const Vertex* vertices;
+	const uint32_t* indices;
+
+	std::vector<Bounds> triangleBounds;
+	std::vector<glm::vec3> centroids;
+	std::vector<uint32_t> order;
+
+	std::atomic<uint32_t> nodeCount{ 0 };
+};
+
+void BVH::Build(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+{
+	Clear();
+
+	if (indexCount % 3 != 0) {
+		throw std::invalid_argument("BVH index count is not a multiple of 3!");
+	}
+
+	uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (triangleCount == 0) {
+		return;
+	}
+
+	BuildContext context;
+	context.vertices = vertices;
+	context.indices = indices;
+	context.triangleBounds.resize(triangleCount);
+	context.centroids.resize(triangleCount);
+	context.order.resize(triangleCount);
+
+	JobSystem::Instance().ParallelFor(triangleCount, BoundsGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Bounds bounds;
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				uint32_t index = indices[3 * i + corner];
+				if (index >= vertexCount) {
+					// Out of range triangles are skipped during the leaf packing
+					bounds = Bounds();
+					break;
+				}
+				bounds.grow(vertices[index].pos);
+			}
+			if (bounds.min.x > bounds.max.x) {
+				bounds.min = bounds.max = glm::vec3(0.0f);
+			}
+			context.triangleBounds[i] = bounds;
+			context.centroids[i] = (bounds.min + bounds.max) * 0.5f;
+			context.order[i] = static_cast<uint32_t>(i);
+		}
+	});
+
+	std::unique_ptr<BuildNode> root = BuildRecursive(context, 0, triangleCount, 0);
+
+	m_nodes.reserve(context.nodeCount.load());
+	m_packets.reserve(triangleCount / 3 + 1);
+	Flatten(*root, context);
+
+	m_triangleCount = triangleCount;
+}
+
+void BVH::Clear()
+{
+	m_nodes.clear();
+	m_packets.clear();
+	m_triangleCount = 0;
+}
+
+std::unique_ptr<BVH::BuildNode> BVH::BuildRecursive(BuildContext& context, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	context.nodeCount++;
+
+	auto node = std::make_unique<BuildNode>();
+	node->begin = begin;
+	node->end = end;
+
+	Bounds centroidBounds;
+	for (uint32_t i = begin; i < end; i++) {
+		uint32_t tri = context.order[i];
+		node->bounds.grow(context.triangleBounds[tri]);
+		centroidBounds.grow(context.centroids[tri]);
+	}
+
+	uint32_t count = end - begin;
+	if (count <= 2 || depth >= MaxDepth) {
+		return node;
+	}
+
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	uint32_t mid = begin;
+
+	if (extent[axis] > 0.0f) {
+		// Binned surface area heuristic along the axis with the widest centroid spread
+		Bin bins[BinCount];
+		float scale = BinCount / extent[axis];
+		auto binIndex = [&](uint32_t tri) {
+			uint32_t bin = static_cast<uint32_t>((context.centroids[tri][axis] - centroidBounds.min[axis]) * scale);
+			return std::min(bin, BinCount - 1);
+		};
+
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t tri = context.order[i];
+			Bin& bin = bins[binIndex(tri)];
+			bin.bounds.grow(context.triangleBounds[tri]);
+			bin.count++;
+		}
+
+		float leftArea[BinCount - 1], rightArea[BinCount - 1];
+		uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+		Bounds leftBounds, rightBounds;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (uint32_t i = 0; i < BinCount - 1; i++) {
+			leftSum += bins[i].count;
+			leftBounds.grow(bins[i].bounds);
+			leftCount[i] = leftSum;
+			leftArea[i] = leftBounds.area();
+
+			rightSum += bins[BinCount - 1 - i].count;
+			rightBounds.grow(bins[BinCount - 1 - i].bounds);
+			rightCount[BinCount - 2 - i] = rightSum;
+			rightArea[BinCount - 2 - i] = rightBounds.area();
+		}
+
+		// Leaves are tested four triangles at a time, so costs are counted in packets
+		auto packets = [](uint32_t triangles) { return static_cast<float>((triangles + 3) / 4); };
+
+		float bestCost = std::numeric_limits<float>::max();
+		uint32_t bestSplit = 0;
+		for (uint32_t i = 0; i < BinCount - 1; i++) {
+			float cost = leftArea[i] * packets(leftCount[i]) + rightArea[i] * packets(rightCount[i]);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		// A traversal step is costed as one packet test
+		float parentArea = node->bounds.area();
+		float leafCost = packets(count);
+		float splitCost = 1.0f + (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+		if (count <= MaxLeafTriangles && leafCost <= splitCost) {
+			return node;
+		}
+
+		uint32_t* first = context.order.data() + begin;
+		uint32_t* last = context.order.data() + end;
+		mid = begin + static_cast<uint32_t>(std::partition(first, last, [&](uint32_t tri) { return binIndex(tri) <= bestSplit; }) - first);
+	}
+
+	if (mid == begin || mid == end) {
+		// All centroids ended up on one side, fall back to a median split
+		mid = begin + count / 2;
+		std::nth_element(context.order.begin() + begin, context.order.begin() + mid, context.order.begin() + end,
+			[&](uint32_t a, uint32_t b) { return context.centroids[a][axis] < context.centroids[b][axis]; });
+	}
+
+	if (count > ParallelThreshold) {
+		// The left half goes to the job system, an idle worker steals it while this thread builds the right half
+		JobSystem& jobs = JobSystem::Instance();
+		JobCounter left;
+		jobs.Run([&context, &node, begin, mid, depth]() { node->left = BuildRecursive(context, begin, mid, depth + 1); }, &left);
+		node->right = BuildRecursive(context, mid, end, depth + 1);
+		jobs.Wait(left);
+	}
+	else {
+		node->left = BuildRecursive(context, begin, mid, depth + 1);
+		node->right = BuildRecursive(context, mid, end, depth + 1);
+	}
+
+	return node;
+}
+
+void BVH::Flatten(const BuildNode& buildNode, const BuildContext& context)
+{
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+
+	Node node{};
+	for (int axis = 0; axis < 3; axis++) {
+		node.boundsMin[axis] = buildNode.bounds.min[axis];
+		node.boundsMax[axis] = buildNode.bounds.max[axis];
+	}
+
+	if (buildNode.left) {
+		Flatten(*buildNode.left, context);
+		node.offset = static_cast<uint32_t>(m_nodes.size());
+		node.count = 0;
+		Flatten(*buildNode.right, context);
+		m_nodes[index] = node;
+		return;
+	}
+
+	node.offset = static_cast<uint32_t>(m_packets.size());
+
+	uint32_t lane = 4;
+	for (uint32_t i = buildNode.begin; i < buildNode.end; i++) {
+		uint32_t tri = context.order[i];
+		const uint32_t* corners = context.indices + 3 * tri;
+		if (context.triangleBounds[tri].min == context.triangleBounds[tri].max) {
+			// Skip degenerate and out of range triangles, they can never be hit
+			continue;
+		}
+
+		if (lane == 4) {
+			TrianglePacket packet{};
+			std::fill(std::begin(packet.ids), std::end(packet.ids), RayHit::InvalidTriangle);
+			m_packets.push_back(packet);
+			lane = 0;
+		}
+
+		TrianglePacket& packet = m_packets.back();
+		const glm::vec3& v0 = context.vertices[corners[0]].pos;
+		glm::vec3 e1 = context.vertices[corners[1]].pos - v0;
+		glm::vec3 e2 = context.vertices[corners[2]].pos - v0;
+		for (int axis = 0; axis < 3; axis++) {
+			packet.v0[axis][lane] = v0[axis];
+			packet.e1[axis][lane] = e1[axis];
+			packet.e2[axis][lane] = e2[axis];
+		}
+		packet.ids[lane] = tri;
+		lane++;
+	}
+
+	node.count = static_cast<uint32_t>(m_packets.size()) - node.offset;
+	m_nodes[index] = node;
+}
+
+namespace {
+	// Slab test, returns the entry distance or FLT_MAX on a miss
+	inline float IntersectBounds(const float* boundsMin, const float* boundsMax, const glm::vec3& origin, const glm::vec3& invDir, float tMin, float tMax) {
+		for (int axis = 0; axis < 3; axis++) {
+			float t0 = (boundsMin[axis] - origin[axis]) * invDir[axis];
+			float t1 = (boundsMax[axis] - origin[axis]) * invDir[axis];
+			if (t0 > t1) std::swap(t0, t1);
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+			if (tMin > tMax) {
+				return std::numeric_limits<float>::max();
+			}
+		}
+		return tMin;
+	}
+}
+
+bool BVH::Intersect(const Ray& ray, RayHit& hit) const
+{
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	const float maxFloat = std::numeric_limits<float>::max();
+	glm::vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	RayHit closest;
+	closest.t = ray.tMax;
+
+	const Node& root = m_nodes[0];
+	if (IntersectBounds(root.boundsMin, root.boundsMax, ray.origin, invDir, ray.tMin, closest.t) == maxFloat) {
+		return false;
+	}
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	while (true) {
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; i++) {
+				IntersectPacket(m_packets[node.offset + i], ray, closest);
+			}
+		}
+		else {
+			uint32_t nearChild = nodeIndex + 1;
+			uint32_t farChild = node.offset;
+			float tNear = IntersectBounds(m_nodes[nearChild].boundsMin, m_nodes[nearChild].boundsMax, ray.origin, invDir, ray.tMin, closest.t);
+			float tFar = IntersectBounds(m_nodes[farChild].boundsMin, m_nodes[farChild].boundsMax, ray.origin, invDir, ray.tMin, closest.t);
+
+			if (tFar < tNear) {
+				std::swap(nearChild, farChild);
+				std::swap(tNear, tFar);
+			}
+
+			if (tNear != maxFloat) {
+				if (tFar != maxFloat) {
+					stack[stackSize++] = farChild;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) {
+			break;
+		}
+		nodeIndex = stack[--stackSize];
+	}
+
+	if (!closest.valid()) {
+		return false;
+	}
+
+	hit = closest;
+	return true;
+}
+
+bool BVH::IntersectPacket(const TrianglePacket& packet, const Ray& ray, RayHit& hit) const
+{
+	// Moller-Trumbore for four triangles at once
+	const __m128 dx = _mm_set1_ps(ray.direction.x);
+	const __m128 dy = _mm_set1_ps(ray.direction.y);
+	const __m128 dz = _mm_set1_ps(ray.direction.z);
+
+	const __m128 e1x = _mm_load_ps(packet.e1[0]);
+	const __m128 e1y = _mm_load_ps(packet.e1[1]);
+	const __m128 e1z = _mm_load_ps(packet.e1[2]);
+	const __m128 e2x = _mm_load_ps(packet.e2[0]);
+	const __m128 e2y = _mm_load_ps(packet.e2[1]);
+	const __m128 e2z = _mm_load_ps(packet.e2[2]);
+
+	// p = dir x e2
+	const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	// s = origin - v0
+	const __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(packet.v0[0]));
+	const __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(packet.v0[1]));
+	const __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(packet.v0[2]));
+
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+	// q = s x e1
+	const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 mask = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, _mm_set1_ps(ray.tMin)));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(hit.t)));
+
+	int lanes = _mm_movemask_ps(mask);
+	if (lanes == 0) {
+		return false;
+	}
+
+	alignas(16) float tValues[4], uValues[4], vValues[4];
+	_mm_store_ps(tValues, t);
+	_mm_store_ps(uValues, u);
+	_mm_store_ps(vValues, v);
+
+	for (int lane = 0; lane < 4; lane++) {
+		if ((lanes & (1 << lane)) && tValues[lane] < hit.t) {
+			hit.t = tValues[lane];
+			hit.triangleId = packet.ids[lane];
+			hit.barycentrics = glm::vec2(uValues[lane], vValues[lane]);
+		}
+	}
+
+	return true;
+}
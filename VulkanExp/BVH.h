@@ -0,0 +1,78 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "Vertex.h"
+
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMin = 0.0f;
+	float tMax = std::numeric_limits<float>::max();
+};
+
+struct RayHit {
+	static constexpr uint32_t InvalidTriangle = UINT32_MAX;
+
+	uint32_t triangleId = InvalidTriangle;
+	float t = std::numeric_limits<float>::max();
+	// Barycentric weights of the second and third triangle vertex
+	glm::vec2 barycentrics;
+
+	inline bool valid() const { return triangleId != InvalidTriangle; }
+};
+
+// Bounding volume hierarchy over an indexed triangle list, used for CPU ray queries (picking, measurements)
+class BVH {
+	public:
+		BVH() = default;
+
+		void Build(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+		void Clear();
+
+		// Returns the closest hit along the ray, triangleId is the index of the triangle in the source index list
+		bool Intersect(const Ray& ray, RayHit& hit) const;
+
+		inline bool empty() const { return m_nodes.empty(); }
+		inline size_t nodeCount() const { return m_nodes.size(); }
+		inline size_t triangleCount() const { return m_triangleCount; }
+
+	private:
+		// Nodes are stored depth first, so an interior node's left child is always the next node in the array
+		struct Node {
+			float boundsMin[3];
+			uint32_t offset; // interior: index of the right child, leaf: first triangle packet
+			float boundsMax[3];
+			uint32_t count;  // interior: 0, leaf: number of triangle packets
+		};
+
+		// Four triangles in structure-of-arrays form so a leaf can be tested with one SSE pass per packet.
+		// Unused lanes hold degenerate triangles and RayHit::InvalidTriangle as their id.
+		struct alignas(16) TrianglePacket {
+			float v0[3][4];
+			float e1[3][4];
+			float e2[3][4];
+			uint32_t ids[4];
+		};
+
+		struct BuildNode;
+		struct BuildContext;
+
+		std::vector<Node> m_nodes;
+		std::vector<TrianglePacket> m_packets;
+		size_t m_triangleCount = 0;
+
+		static constexpr uint32_t BinCount = 16;
+		static constexpr uint32_t MaxLeafTriangles = 8;
+
+		static std::unique_ptr<BuildNode> BuildRecursive(BuildContext& context, uint32_t begin, uint32_t end, uint32_t depth);
+		void Flatten(const BuildNode& buildNode, const BuildContext& context);
+		bool IntersectPacket(const TrianglePacket& packet, const Ray& ray, RayHit& hit) const;
+};
+
+#endif
@@ -0,0 +1,855 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BVH.h"
+#include "CommandPool.h"
+#include "Device.h"
+#include "GpuTimeline.h"
+#include "HeadlessRenderer.h"
+#include "Instance.h"
+#include "JobSystem.h"
+#include "MeshLoader.h"
+#include "Model.h"
+#include "Vertex.h"
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	double SecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Noisy grid in the xy plane, close to the triangle distribution of a scanned surface
+	void CreateHeightfield(size_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+		// At least one cell, so there is a spacing and two triangles to build over
+		uint32_t size = std::max(2u, static_cast<uint32_t>(std::sqrt(triangleCount / 2.0)) + 1);
+		float spacing = 2.0f / (size - 1);
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> noise(0.0f, spacing * 0.5f);
+
+		vertices.resize(static_cast<size_t>(size) * size);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				Vertex& vertex = vertices[static_cast<size_t>(y) * size + x];
+				vertex.pos = { x * spacing - 1.0f, y * spacing - 1.0f, noise(rng) };
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+				vertex.texCoord = { x / float(size - 1), y / float(size - 1) };
+			}
+		}
+
+		indices.reserve(static_cast<size_t>(size - 1) * (size - 1) * 6);
+		for (uint32_t y = 0; y + 1 < size; y++) {
+			for (uint32_t x = 0; x + 1 < size; x++) {
+				uint32_t i = y * size + x;
+				indices.insert(indices.end(), { i, i + 1, i + size, i + 1, i + size + 1, i + size });
+			}
+		}
+	}
+
+	// Orbits the origin once over frameCount frames while bobbing up and down, so every run sees the same views
+	glm::mat4 CameraPath(uint32_t frame, uint32_t frameCount) {
+		const float pi = 3.14159265f;
+		float angle = 2.0f * pi * frame / frameCount;
+		float radius = 2.8f + 0.4f * std::sin(2.0f * angle);
+		glm::vec3 eye(radius * std::cos(angle), radius * std::sin(angle), 1.5f + 0.5f * std::sin(3.0f * angle));
+		return glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+
+	uint64_t PeakResidentBytes() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+	}
+
+	double Percentile(std::vector<double> samples, double percentile) {
+		if (samples.empty()) {
+			return 0.0;
+		}
+		size_t rank = std::min(samples.size() - 1, static_cast<size_t>(percentile * samples.size()));
+		std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+		return samples[rank];
+	}
+
+	std::string ModelName(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		return name.substr(0, name.find_last_of('.'));
+	}
+
+	// Metrics of one case in the order they are written. Only fps is better when higher
+	typedef std::vector<std::pair<std::string, double>> Metrics;
+
+	bool HigherIsBetter(const std::string& metric) {
+		return metric == "fps";
+	}
+
+	// Just enough JSON for the results files: every number in the document, keyed by its dotted path. Anything
+	// truncated or malformed throws instead of reading past the end
+	class JsonNumbers {
+		public:
+			JsonNumbers(const std::string& text) : m_text(text) {
+				SkipSpace();
+				Value("");
+				if (m_pos != m_text.size()) {
+					Fail("trailing characters");
+				}
+			}
+
+			std::map<std::string, double> numbers;
+
+		private:
+			const std::string& m_text;
+			size_t m_pos = 0;
+
+			[[noreturn]] void Fail(const std::string& what) const {
+				throw std::runtime_error("malformed benchmark json, " + what + " at offset " + std::to_string(m_pos) + "!");
+			}
+
+			// The next character, which must exist
+			char Peek() const {
+				if (m_pos >= m_text.size()) {
+					Fail("unexpected end");
+				}
+				return m_text[m_pos];
+			}
+
+			void SkipSpace() {
+				while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+					++m_pos;
+				}
+			}
+
+			void Expect(char c) {
+				SkipSpace();
+				if (Peek() != c) {
+					Fail(std::string("expected ") + c);
+				}
+				++m_pos;
+				SkipSpace();
+			}
+
+			std::string String() {
+				SkipSpace();
+				if (Peek() != '"') {
+					Fail("expected \"");
+				}
+				++m_pos;
+				std::string value;
+				for (char c = Peek(); c != '"'; c = Peek()) {
+					++m_pos;
+					if (c != '\\') {
+						value += c;
+						continue;
+					}
+					char escaped = Peek();
+					++m_pos;
+					switch (escaped) {
+						case 'b': value += '\b'; break;
+						case 'f': value += '\f'; break;
+						case 'n': value += '\n'; break;
+						case 'r': value += '\r'; break;
+						case 't': value += '\t'; break;
+						case 'u': {
+							if (m_text.size() - m_pos < 4 || m_text.find_first_not_of("0123456789abcdefABCDEF", m_pos) < m_pos + 4) {
+								Fail("bad \\u escape");
+							}
+							unsigned long code = std::stoul(m_text.substr(m_pos, 4), nullptr, 16);
+							m_pos += 4;
+							// Keys and names are compared, never shown, so anything beyond ASCII only has to stay distinct
+							value += code < 0x80 ? static_cast<char>(code) : '?';
+							break;
+						}
+						case '"': case '\\': case '/': value += escaped; break;
+						default: Fail("bad escape");
+					}
+				}
+				++m_pos;
+				SkipSpace();
+				return value;
+			}
+
+			void Value(const std::string& path) {
+				SkipSpace();
+				char c = Peek();
+				if (c == '{') {
+					Expect('{');
+					while (Peek() != '}') {
+						std::string key = String();
+						Expect(':');
+						Value(path.empty() ? key : path + "." + key);
+						if (Peek() == ',') {
+							Expect(',');
+						}
+						else if (Peek() != '}') {
+							Fail("expected , or }");
+						}
+					}
+					Expect('}');
+				}
+				else if (c == '[') {
+					Expect('[');
+					for (size_t index = 0; Peek() != ']'; ++index) {
+						Value(path + "." + std::to_string(index));
+						if (Peek() == ',') {
+							Expect(',');
+						}
+						else if (Peek() != ']') {
+							Fail("expected , or ]");
+						}
+					}
+					Expect(']');
+				}
+				else if (c == '"') {
+					String();
+				}
+				else {
+					size_t end = std::min(m_text.find_first_of(",}] \t\r\n", m_pos), m_text.size());
+					std::string token = m_text.substr(m_pos, end - m_pos);
+					if (token != "true" && token != "false" && token != "null") {
+						size_t used = 0;
+						double number = 0.0;
+						try {
+							number = std::stod(token, &used);
+						}
+						catch (const std::logic_error&) {
+							used = 0;
+						}
+						if (token.empty() || used != token.size()) {
+							Fail("bad value " + token);
+						}
+						numbers[path] = number;
+					}
+					m_pos = end;
+					SkipSpace();
+				}
+			}
+	};
+
+	// Quotes and backslashes in device and model names would otherwise end the string early
+	std::string JsonEscape(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+				escaped += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				const char* hex = "0123456789abcdef";
+				escaped += "\\u00";
+				escaped += hex[(c >> 4) & 0xf];
+				escaped += hex[c & 0xf];
+			}
+			else {
+				escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	std::string ReadFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	void WriteResults(const std::string& path, const std::string& deviceName, const RenderBenchmarkOptions& options, const std::vector<std::pair<std::string, Metrics>>& results) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+
+		file << std::fixed << std::setprecision(4);
+		file << "{\n\t\"device\": \"" << JsonEscape(deviceName) << "\",\n";
+		file << "\t\"width\": " << options.width << ",\n\t\"height\": " << options.height << ",\n";
+		file << "\t\"frames\": " << options.frames << ",\n\t\"framesInFlight\": " << options.framesInFlight << ",\n";
+		file << "\t\"models\": {";
+		for (size_t i = 0; i < results.size(); ++i) {
+			file << (i ? ",\n" : "\n") << "\t\t\"" << JsonEscape(results[i].first) << "\": {";
+			const Metrics& metrics = results[i].second;
+			for (size_t j = 0; j < metrics.size(); ++j) {
+				file << (j ? ",\n" : "\n") << "\t\t\t\"" << JsonEscape(metrics[j].first) << "\": " << metrics[j].second;
+			}
+			file << "\n\t\t}";
+		}
+		file << "\n\t}\n}\n";
+	}
+
+	// Prints every metric next to its baseline, returns false if any regressed past tolerance
+	bool CompareResults(const std::string& baselinePath, double tolerance, const std::vector<std::pair<std::string, Metrics>>& results) {
+		std::string text = ReadFile(baselinePath);
+		std::map<std::string, double> baseline = JsonNumbers(text).numbers;
+
+		bool passed = true;
+		std::cout << "against " << baselinePath << " (tolerance " << tolerance * 100.0 << "%):\n";
+		for (const auto& result : results) {
+			for (const auto& metric : result.second) {
+				auto found = baseline.find("models." + result.first + "." + metric.first);
+				if (found == baseline.end() || found->second <= 0.0) {
+					std::cout << "\t" << result.first << " " << metric.first << ": no baseline\n";
+					continue;
+				}
+
+				double change = metric.second / found->second - 1.0;
+				bool regressed = HigherIsBetter(metric.first) ? change < -tolerance : change > tolerance;
+				passed &= !regressed;
+				std::cout << "\t" << result.first << " " << metric.first << ": " << metric.second << " vs " << found->second
+					<< " (" << std::showpos << change * 100.0 << std::noshowpos << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+			}
+		}
+		return passed;
+	}
+
+	// Positions and texture coordinates indexed separately per corner, the way OBJ files store them
+	struct ObjMesh {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		// Position and texture coordinate index of every corner
+		std::vector<std::pair<uint32_t, uint32_t>> corners;
+	};
+
+	// Shared vertices everywhere, six corners per vertex
+	ObjMesh CreateGrid(size_t cornerCount) {
+		uint32_t size = static_cast<uint32_t>(std::sqrt(cornerCount / 6.0)) + 2;
+		ObjMesh mesh;
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				mesh.positions.push_back({ x / float(size - 1) * 2.0f - 1.0f, y / float(size - 1) * 2.0f - 1.0f, 0.0f });
+				mesh.texCoords.push_back({ x / float(size - 1), y / float(size - 1) });
+			}
+		}
+		for (uint32_t y = 0; y + 1 < size && mesh.corners.size() < cornerCount; y++) {
+			for (uint32_t x = 0; x + 1 < size && mesh.corners.size() < cornerCount; x++) {
+				uint32_t i = y * size + x;
+				for (uint32_t corner : { i, i + 1, i + size, i + 1, i + size + 1, i + size }) {
+					mesh.corners.push_back({ corner, corner });
+				}
+			}
+		}
+		return mesh;
+	}
+
+	// Latitude/longitude sphere, the seam and poles give the deduplication some texture coordinate splits
+	ObjMesh CreateSphere(size_t cornerCount) {
+		const float pi = 3.14159265f;
+		uint32_t rings = static_cast<uint32_t>(std::sqrt(cornerCount / 12.0)) + 2;
+		uint32_t segments = rings * 2;
+		ObjMesh mesh;
+		for (uint32_t ring = 0; ring <= rings; ring++) {
+			float theta = pi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; segment++) {
+				float phi = 2.0f * pi * segment / segments;
+				mesh.positions.push_back({ std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) });
+				mesh.texCoords.push_back({ segment / float(segments), ring / float(rings) });
+			}
+		}
+		uint32_t stride = segments + 1;
+		for (uint32_t ring = 0; ring < rings && mesh.corners.size() < cornerCount; ring++) {
+			for (uint32_t segment = 0; segment < segments && mesh.corners.size() < cornerCount; segment++) {
+				uint32_t i = ring * stride + segment;
+				for (uint32_t corner : { i, i + stride, i + 1, i + 1, i + stride, i + stride + 1 }) {
+					mesh.corners.push_back({ corner, corner });
+				}
+			}
+		}
+		return mesh;
+	}
+
+	// Independent random triangles, nothing to share: the worst case for deduplication and the vertex cache
+	ObjMesh CreateSoup(size_t cornerCount) {
+		std::mt19937 rng(4321);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		ObjMesh mesh;
+		size_t triangles = std::max<size_t>(1, cornerCount / 3);
+		for (size_t i = 0; i < triangles * 3; i++) {
+			mesh.positions.push_back({ unit(rng) * 2.0f - 1.0f, unit(rng) * 2.0f - 1.0f, unit(rng) * 2.0f - 1.0f });
+			mesh.texCoords.push_back({ unit(rng), unit(rng) });
+			uint32_t index = static_cast<uint32_t>(i);
+			mesh.corners.push_back({ index, index });
+		}
+		return mesh;
+	}
+
+	// Returns the file size
+	size_t WriteObj(const std::string& path, const ObjMesh& mesh) {
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file) {
+			throw std::runtime_error("failed to create " + path + "!");
+		}
+		for (const glm::vec3& position : mesh.positions) {
+			std::fprintf(file, "v %.6f %.6f %.6f\n", position.x, position.y, position.z);
+		}
+		for (const glm::vec2& texCoord : mesh.texCoords) {
+			std::fprintf(file, "vt %.6f %.6f\n", texCoord.x, texCoord.y);
+		}
+		for (size_t i = 0; i + 2 < mesh.corners.size(); i += 3) {
+			std::fprintf(file, "f %u/%u %u/%u %u/%u\n",
+				mesh.corners[i].first + 1, mesh.corners[i].second + 1,
+				mesh.corners[i + 1].first + 1, mesh.corners[i + 1].second + 1,
+				mesh.corners[i + 2].first + 1, mesh.corners[i + 2].second + 1);
+		}
+		size_t size = static_cast<size_t>(std::ftell(file));
+		std::fclose(file);
+		return size;
+	}
+
+	// Google Benchmark style: setup runs before every iteration and isn't timed, run repeats until minSeconds of
+	// timed work or at least once. Prints mean time per iteration and throughput over bytes and corners
+	void Measure(const std::string& name, double minSeconds, size_t bytes, size_t corners, const std::function<void()>& setup, const std::function<void()>& run) {
+		double timed = 0.0;
+		uint64_t iterations = 0;
+		do {
+			if (setup) {
+				setup();
+			}
+			auto start = Clock::now();
+			run();
+			timed += SecondsSince(start);
+			++iterations;
+		} while (timed < minSeconds);
+
+		double seconds = timed / iterations;
+		std::printf("%-36s %12.3f ms %10llu %12.1f MB/s %10.2f Mcorners/s\n", name.c_str(), seconds * 1000.0,
+			static_cast<unsigned long long>(iterations), bytes / seconds / 1e6, corners / seconds / 1e6);
+	}
+
+	bool Matches(const std::string& name, const std::string& filter) {
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+
+	// Device for the upload stages, constructed only when they run
+	struct UploadContext {
+		std::unique_ptr<Instance> instance;
+		std::unique_ptr<Device> device;
+		std::unique_ptr<GpuTimeline> timeline;
+		std::unique_ptr<CommandPool> commandPool;
+
+		UploadContext() {
+			instance.reset(new Instance("Loader Benchmark", "No Engine", false, true));
+			device.reset(new Device(*instance, {}));
+			timeline.reset(new GpuTimeline(*device));
+			commandPool.reset(new CommandPool(*device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT));
+		}
+		~UploadContext() {
+			timeline->Wait(timeline->lastSubmitted());
+			timeline->Collect();
+		}
+	};
+
+	std::vector<Ray> CreateRays(size_t count) {
+		std::mt19937 rng(5678);
+		std::uniform_real_distribution<float> position(-1.2f, 1.2f);
+		std::uniform_real_distribution<float> tilt(-0.3f, 0.3f);
+
+		std::vector<Ray> rays(count);
+		for (Ray& ray : rays) {
+			ray.origin = { position(rng), position(rng), 2.0f };
+			ray.direction = glm::normalize(glm::vec3(tilt(rng), tilt(rng), -1.0f));
+		}
+		return rays;
+	}
+
+	size_t TraceRays(const BVH& bvh, const std::vector<Ray>& rays, uint32_t threadCount) {
+		std::atomic<size_t> hits{ 0 };
+		std::vector<std::thread> threads;
+		size_t chunk = (rays.size() + threadCount - 1) / threadCount;
+
+		for (uint32_t t = 0; t < threadCount; t++) {
+			threads.emplace_back([&, t]() {
+				size_t localHits = 0;
+				size_t end = std::min(rays.size(), (t + 1) * chunk);
+				for (size_t i = t * chunk; i < end; i++) {
+					RayHit hit;
+					if (bvh.Intersect(rays[i], hit)) {
+						localHits++;
+					}
+				}
+				hits += localHits;
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		return hits.load();
+	}
+}
+
+namespace {
+	// Enough arithmetic per element that the parallel-for is compute bound
+	void JobKernel(JobSystem& jobs, std::vector<float>& values) {
+		jobs.ParallelFor(values.size(), 4096, [&values](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				float x = static_cast<float>(i) * 1e-6f;
+				for (int j = 0; j < 64; j++) {
+					x = std::sin(x) * 0.5f + std::cos(x * 1.5f);
+				}
+				values[i] = x;
+			}
+		});
+	}
+
+	// Scheduling overhead: jobs that do next to nothing, queued from outside the workers
+	void TinyJobs(JobSystem& jobs, size_t count, std::atomic<size_t>& sum) {
+		JobCounter counter;
+		for (size_t i = 0; i < count; i++) {
+			jobs.Run([&sum, i]() { sum.fetch_add(i & 1, std::memory_order_relaxed); }, &counter);
+		}
+		jobs.Wait(counter);
+	}
+
+	// Recursive split like the BVH build, every level forks its left half and waits on it
+	uint64_t ForkJoin(JobSystem& jobs, uint32_t depth) {
+		if (depth == 0) {
+			uint64_t x = 1;
+			for (int i = 0; i < 2000; i++) {
+				x = x * 6364136223846793005ull + 1442695040888963407ull;
+			}
+			return x & 1;
+		}
+
+		uint64_t left = 0;
+		JobCounter counter;
+		jobs.Run([&]() { left = ForkJoin(jobs, depth - 1); }, &counter);
+		uint64_t right = ForkJoin(jobs, depth - 1);
+		jobs.Wait(counter);
+		return left + right;
+	}
+}
+
+void Benchmarks::RunBVHBenchmark(size_t triangleCount)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	CreateHeightfield(triangleCount, vertices, indices);
+
+	std::cout << "BVH benchmark: " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices\n";
+
+	BVH bvh;
+	auto start = Clock::now();
+	bvh.Build(vertices.data(), vertices.size(), indices.data(), indices.size());
+	double buildSeconds = SecondsSince(start);
+	std::cout << "\tbuild: " << buildSeconds * 1000.0 << " ms, " << bvh.nodeCount() << " nodes\n";
+
+	const size_t rayCount = 1 << 20;
+	std::vector<Ray> rays = CreateRays(rayCount);
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t threads : { 1u, threadCount }) {
+		start = Clock::now();
+		size_t hits = TraceRays(bvh, rays, threads);
+		double seconds = SecondsSince(start);
+		std::cout << "\t" << threads << " thread(s): " << rayCount / seconds / 1e6 << " Mrays/s (" << hits << " hits)\n";
+	}
+}
+
+std::vector<RenderBenchmarkCase> Benchmarks::ReadSuite(const std::string& path, const std::string& defaultTexture)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+
+	std::vector<RenderBenchmarkCase> cases;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		RenderBenchmarkCase benchmarkCase;
+		if (!(fields >> benchmarkCase.modelPath) || benchmarkCase.modelPath[0] == '#') {
+			continue;
+		}
+		if (!(fields >> benchmarkCase.texturePath)) {
+			benchmarkCase.texturePath = defaultTexture;
+		}
+		cases.push_back(benchmarkCase);
+	}
+	return cases;
+}
+
+bool Benchmarks::RunRenderBenchmark(const RenderBenchmarkOptions& options)
+{
+	if (options.cases.empty() || options.frames == 0) {
+		throw std::runtime_error("render benchmark needs at least one model and one frame!");
+	}
+
+	// One renderer for the whole suite, like an application switching scenes
+	HeadlessRenderer renderer(options.width, options.height, options.framesInFlight, options.validation);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(renderer.device().physical(), &properties);
+	std::cout << "render benchmark on " << properties.deviceName << ", " << options.width << "x" << options.height
+		<< ", " << options.frames << " frames per model\n";
+
+	std::vector<std::pair<std::string, Metrics>> results;
+	const glm::mat4 model(1.0f);
+	for (const RenderBenchmarkCase& benchmarkCase : options.cases) {
+		std::string name = benchmarkCase.name.empty() ? ModelName(benchmarkCase.modelPath) : benchmarkCase.name;
+
+		// Parse and upload, up to the GPU finishing the copies
+		auto start = Clock::now();
+		renderer.LoadScene(benchmarkCase.modelPath, benchmarkCase.texturePath);
+		renderer.WaitIdle();
+		double loadMs = SecondsSince(start) * 1000.0;
+
+		for (uint32_t frame = 0; frame < options.warmupFrames; ++frame) {
+			renderer.RenderSlot(frame % renderer.slotCount(), CameraPath(frame, options.frames), model);
+		}
+		renderer.WaitIdle();
+
+		GpuScopeTiming gpuBefore;
+		if (const GpuScopeTiming* timing = renderer.gpuProfiler().Find("frame")) {
+			gpuBefore = *timing;
+		}
+
+		// CPU time is recording and submitting only, the wait for the slot's previous frame is GPU bound
+		std::vector<double> cpuMs(options.frames);
+		start = Clock::now();
+		for (uint32_t frame = 0; frame < options.frames; ++frame) {
+			uint32_t slot = frame % renderer.slotCount();
+			renderer.WaitSlot(slot);
+			auto recordStart = Clock::now();
+			renderer.RenderSlot(slot, CameraPath(frame, options.frames), model);
+			cpuMs[frame] = SecondsSince(recordStart) * 1000.0;
+		}
+		renderer.WaitIdle();
+		double seconds = SecondsSince(start);
+
+		double gpuMs = 0.0;
+		if (const GpuScopeTiming* timing = renderer.gpuProfiler().Find("frame")) {
+			uint64_t samples = timing->samples - gpuBefore.samples;
+			gpuMs = samples ? (timing->totalMs - gpuBefore.totalMs) / samples : 0.0;
+		}
+
+		double cpuTotal = 0.0;
+		for (double ms : cpuMs) {
+			cpuTotal += ms;
+		}
+
+		Metrics metrics = {
+			{ "load_ms", loadMs },
+			{ "fps", options.frames / seconds },
+			{ "frame_ms", seconds * 1000.0 / options.frames },
+			{ "cpu_ms_mean", cpuTotal / options.frames },
+			{ "cpu_ms_p50", Percentile(cpuMs, 0.50) },
+			{ "cpu_ms_p95", Percentile(cpuMs, 0.95) },
+			{ "cpu_ms_p99", Percentile(cpuMs, 0.99) },
+			{ "gpu_ms_mean", gpuMs },
+			{ "scene_memory_mb", renderer.sceneMemorySize() / (1024.0 * 1024.0) },
+			// Peak of the whole process so far, so it never drops from one case to the next
+			{ "peak_host_memory_mb", PeakResidentBytes() / (1024.0 * 1024.0) }
+		};
+
+		std::cout << "\t" << name << ": load " << loadMs << " ms, " << options.frames / seconds << " fps, cpu p50 "
+			<< Percentile(cpuMs, 0.50) << " ms p99 " << Percentile(cpuMs, 0.99) << " ms, gpu " << gpuMs << " ms\n";
+		results.emplace_back(name, metrics);
+	}
+
+	WriteResults(options.outputPath, properties.deviceName, options, results);
+	std::cout << "results written to " << options.outputPath << "\n";
+
+	if (options.baselinePath.empty()) {
+		return true;
+	}
+	if (options.updateBaseline) {
+		WriteResults(options.baselinePath, properties.deviceName, options, results);
+		std::cout << "baseline " << options.baselinePath << " updated\n";
+		return true;
+	}
+	return CompareResults(options.baselinePath, options.tolerance, results);
+}
+
+void Benchmarks::RunLoaderBenchmark(const LoaderBenchmarkOptions& options)
+{
+	std::unique_ptr<UploadContext> upload;
+	if (options.gpu) {
+		try {
+			upload.reset(new UploadContext());
+		}
+		catch (const std::exception& e) {
+			std::cout << "no Vulkan device (" << e.what() << "), skipping the staging and upload stages\n";
+		}
+	}
+
+	std::printf("%-36s %15s %10s %17s %21s\n", "Benchmark", "Time", "Iterations", "Bytes", "Corners");
+
+	typedef ObjMesh (*Generator)(size_t);
+	const std::pair<const char*, Generator> shapes[] = { { "grid", CreateGrid }, { "sphere", CreateSphere }, { "soup", CreateSoup } };
+	std::string objPath = (std::filesystem::temp_directory_path() / "loader_benchmark.obj").string();
+
+	for (const auto& shape : shapes) {
+		for (size_t size : options.sizes) {
+			std::string suffix = std::string("/") + shape.first + "/" + std::to_string(size);
+			bool any = false;
+			for (const char* stage : { "parse", "dedup", "optimize_cache", "optimize_fetch", "staging_memcpy", "upload" }) {
+				any |= Matches(stage + suffix, options.filter);
+			}
+			if (!any) {
+				continue;
+			}
+
+			size_t objBytes;
+			size_t cornerCount;
+			{
+				ObjMesh obj = shape.second(size);
+				cornerCount = obj.corners.size();
+				objBytes = WriteObj(objPath, obj);
+			}
+
+			// Later stages need the earlier stages' output, so they run even when filtered out, just untimed
+			std::vector<Vertex> corners;
+			if (Matches("parse" + suffix, options.filter)) {
+				Measure("parse" + suffix, options.minSeconds, objBytes, cornerCount, nullptr, [&]() { MeshLoader::ParseObj(objPath, corners); });
+			}
+			else {
+				MeshLoader::ParseObj(objPath, corners);
+			}
+			std::remove(objPath.c_str());
+
+			MeshData mesh;
+			size_t cornerBytes = corners.size() * sizeof(Vertex);
+			auto dedup = [&]() {
+				mesh = MeshData();
+				MeshLoader::Deduplicate(corners, mesh);
+			};
+			if (Matches("dedup" + suffix, options.filter)) {
+				Measure("dedup" + suffix, options.minSeconds, cornerBytes, cornerCount, nullptr, dedup);
+			}
+			else {
+				dedup();
+			}
+			corners.clear();
+			corners.shrink_to_fit();
+
+			size_t meshBytes = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t);
+			MeshData work;
+			if (Matches("optimize_cache" + suffix, options.filter)) {
+				Measure("optimize_cache" + suffix, options.minSeconds, meshBytes, cornerCount, [&]() { work = mesh; }, [&]() { MeshLoader::OptimizeVertexCache(work); });
+			}
+			if (Matches("optimize_fetch" + suffix, options.filter)) {
+				MeshData cacheOptimized = mesh;
+				MeshLoader::OptimizeVertexCache(cacheOptimized);
+				Measure("optimize_fetch" + suffix, options.minSeconds, meshBytes, cornerCount, [&]() { work = cacheOptimized; }, [&]() { MeshLoader::OptimizeVertexFetch(work); });
+			}
+			work = MeshData();
+
+			if (!upload) {
+				continue;
+			}
+
+			if (Matches("staging_memcpy" + suffix, options.filter)) {
+				// What UploadBuffer does before the copy: host visible, coherent memory, mapped once
+				VkBuffer staging;
+				VkDeviceMemory stagingMemory;
+				Model::CreateBuffer(meshBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory, *upload->device, MemoryCategory::Staging);
+				void* data;
+				vkMapMemory(upload->device->logical(), stagingMemory, 0, meshBytes, 0, &data);
+				Measure("staging_memcpy" + suffix, options.minSeconds, meshBytes, cornerCount, nullptr, [&]() {
+					std::memcpy(data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+					std::memcpy(static_cast<uint8_t*>(data) + mesh.vertices.size() * sizeof(Vertex), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+				});
+				vkUnmapMemory(upload->device->logical(), stagingMemory);
+				vkDestroyBuffer(upload->device->logical(), staging, nullptr);
+				upload->device->memory().Free(stagingMemory);
+			}
+
+			if (Matches("upload" + suffix, options.filter)) {
+				// Staging allocation, memcpy, copy submit and the wait for the GPU to finish it
+				std::unique_ptr<Model> model;
+				Measure("upload" + suffix, options.minSeconds, meshBytes, cornerCount, [&]() {
+					model.reset();
+					upload->timeline->Wait(upload->timeline->lastSubmitted());
+					upload->timeline->Collect();
+					model.reset(new Model(*upload->device, *upload->commandPool, *upload->timeline));
+					model->SetMesh(mesh);
+				}, [&]() {
+					model->CreateVertexBuffer();
+					model->CreateIndexBuffer();
+					upload->timeline->Wait(upload->timeline->lastSubmitted());
+				});
+			}
+		}
+	}
+}
+
+void Benchmarks::RunJobBenchmark(uint32_t maxThreads)
+{
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::vector<float> values(1 << 20);
+	const size_t tinyJobCount = 1 << 20;
+	const uint32_t forkDepth = 16;
+	double baseline[3] = {};
+
+	std::cout << "Job system benchmark: up to " << maxThreads << " threads\n";
+	for (uint32_t threads : threadCounts) {
+		// The calling thread waits and helps, so one thread means a single worker that it takes turns with
+		JobSystem jobs(std::max(1u, threads - 1));
+		JobKernel(jobs, values);
+
+		double seconds[3];
+		auto start = Clock::now();
+		JobKernel(jobs, values);
+		seconds[0] = SecondsSince(start);
+
+		std::atomic<size_t> sum{ 0 };
+		start = Clock::now();
+		TinyJobs(jobs, tinyJobCount, sum);
+		seconds[1] = SecondsSince(start);
+
+		start = Clock::now();
+		uint64_t leaves = ForkJoin(jobs, forkDepth);
+		seconds[2] = SecondsSince(start);
+
+		if (threads == threadCounts.front()) {
+			std::copy(seconds, seconds + 3, baseline);
+		}
+
+		std::cout << "\t" << threads << " thread(s):\n" << std::fixed << std::setprecision(2);
+		std::cout << "\t\tparallel for: " << seconds[0] * 1000.0 << " ms, " << baseline[0] / seconds[0] << "x\n";
+		std::cout << "\t\ttiny jobs: " << tinyJobCount / seconds[1] / 1e6 << " M jobs/s, " << baseline[1] / seconds[1] << "x\n";
+		std::cout << "\t\tfork/join: " << seconds[2] * 1000.0 << " ms, " << baseline[2] / seconds[2] << "x (" << leaves << " odd leaves)\n";
+		std::cout << "\t\t" << jobs.jobsRun() << " jobs, " << jobs.steals() << " steals\n";
+		std::cout.unsetf(std::ios::floatfield);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct RenderBenchmarkCase {
+	// Key of the model's results, the model file name without extension unless given
+	std::string name;
+	std::string modelPath;
+	// Ignored for packages that bring their own texture
+	std::string texturePath;
+};
+
+struct RenderBenchmarkOptions {
+	std::vector<RenderBenchmarkCase> cases;
+	uint32_t width = 800;
+	uint32_t height = 600;
+	uint32_t framesInFlight = 2;
+	// Rendered before measuring, so pipeline and driver warm up doesn't count
+	uint32_t warmupFrames = 30;
+	uint32_t frames = 300;
+	bool validation = false;
+	std::string outputPath = "bench_results.json";
+	// Compared against when not empty, overwritten instead with updateBaseline
+	std::string baselinePath;
+	bool updateBaseline = false;
+	// Relative slack before a metric counts as a regression, 0.1 allows 10% slower
+	double tolerance = 0.1;
+};
+
+// Mesh sizes and stages measured by RunLoaderBenchmark
+struct LoaderBenchmarkOptions {
+	// Face corners per synthetic mesh
+	std::vector<size_t> sizes = { 10000, 100000, 1000000, 10000000, 50000000 };
+	// Only benchmarks whose name contains this run, e.g. "dedup/soup"
+	std::string filter;
+	// Every benchmark repeats until it has run this long, at least once
+	double minSeconds = 0.5;
+	// The staging and upload stages need a Vulkan device, parsing and the CPU stages never do
+	bool gpu = true;
+};
+
+// Standalone performance runs, selected from the command line in main.cpp
+class Benchmarks {
+	public:
+		Benchmarks() = delete;
+		~Benchmarks() = delete;
+
+		// Reports BVH build time and ray query throughput on a synthetic heightfield mesh
+		static void RunBVHBenchmark(size_t triangleCount);
+		// Renders every case headless along the same camera path and writes CPU and GPU frame times, load time and
+		// memory use as JSON. Returns false if a metric regressed past the tolerance against the baseline
+		static bool RunRenderBenchmark(const RenderBenchmarkOptions& options);
+		// Reads "model [texture]" lines, texture falling back to defaultTexture; blank lines and # comments are skipped
+		static std::vector<RenderBenchmarkCase> ReadSuite(const std::string& path, const std::string& defaultTexture);
+		// Times each OBJ-to-GPU stage on its own (parse, dedup, vertex cache and fetch optimization, staging memcpy,
+		// full upload) over synthetic grid, sphere and triangle soup meshes, reporting MB/s and corners/s
+		static void RunLoaderBenchmark(const LoaderBenchmarkOptions& options);
+		// Runs a parallel-for over a compute kernel, a flood of tiny jobs and nested fork/join on job systems of
+		// 1, 2, 4 ... up to maxThreads threads, reporting time, speedup over one thread and steals
+		static void RunJobBenchmark(uint32_t maxThreads);
+};
+
+#endif
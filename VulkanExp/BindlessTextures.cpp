@@ -0,0 +1,189 @@
+#include "BindlessTextures.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "Model.h"
+
+BindlessTextures::BindlessTextures(const Device& device) : m_device(device)
+{
+	if (!device.descriptorIndexingEnabled()) {
+		throw std::runtime_error("bindless textures need descriptor indexing!");
+	}
+
+	// Stay inside what the device allows for update after bind sampled images
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(device.physical(), &properties);
+	m_capacity = std::min(MaxTextures, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].descriptorCount = m_capacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	bindings[1].descriptorCount = MaxSamplers;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// Unwritten slots are fine as long as no draw uses them, and free slots can be filled while the set is bound
+	VkDescriptorBindingFlags arrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::array<VkDescriptorBindingFlags, 3> bindingFlags = { arrayFlags, arrayFlags, 0 };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device.logical(), &layoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[0].descriptorCount = m_capacity;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSizes[1].descriptorCount = MaxSamplers;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(device.logical(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_layout;
+
+	if (vkAllocateDescriptorSets(device.logical(), &allocInfo, &m_set) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+
+	// Sampler index per material, written through a persistent mapping
+	VkDeviceSize materialBufferSize = sizeof(uint32_t) * m_capacity;
+	Model::CreateBuffer(materialBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_materialBuffer, m_materialMemory, device, MemoryCategory::Other);
+	void* mapped;
+	vkMapMemory(device.logical(), m_materialMemory, 0, materialBufferSize, 0, &mapped);
+	m_materialSamplers = static_cast<uint32_t*>(mapped);
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = m_materialBuffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = materialBufferSize;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_set;
+	descriptorWrite.dstBinding = 2;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(device.logical(), 1, &descriptorWrite, 0, nullptr);
+}
+
+BindlessTextures::~BindlessTextures()
+{
+	vkUnmapMemory(m_device.logical(), m_materialMemory);
+	vkDestroyBuffer(m_device.logical(), m_materialBuffer, nullptr);
+	m_device.memory().Free(m_materialMemory);
+
+	vkDestroyDescriptorPool(m_device.logical(), m_pool, nullptr);
+	vkDestroyDescriptorSetLayout(m_device.logical(), m_layout, nullptr);
+}
+
+uint32_t BindlessTextures::AddMaterial(Texture& texture, VkSampler sampler)
+{
+	uint32_t material;
+	if (!m_freeMaterials.empty()) {
+		material = m_freeMaterials.back();
+		m_freeMaterials.pop_back();
+	}
+	else if (m_materialCount < m_capacity) {
+		material = m_materialCount++;
+	}
+	else {
+		throw std::runtime_error("bindless texture array is full!");
+	}
+
+	m_materialSamplers[material] = SamplerSlot(sampler);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = texture.imageView();
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_set;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = material;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(m_device.logical(), 1, &descriptorWrite, 0, nullptr);
+	return material;
+}
+
+void BindlessTextures::RemoveMaterial(uint32_t material)
+{
+	// Partially bound arrays do not need the slot cleared, it is simply never indexed until it is reused
+	m_freeMaterials.push_back(material);
+}
+
+uint32_t BindlessTextures::SamplerSlot(VkSampler sampler)
+{
+	auto found = m_samplerSlots.find(sampler);
+	if (found != m_samplerSlots.end()) {
+		return found->second;
+	}
+
+	if (m_samplerSlots.size() >= MaxSamplers) {
+		throw std::runtime_error("bindless sampler array is full!");
+	}
+	uint32_t slot = static_cast<uint32_t>(m_samplerSlots.size());
+
+	VkDescriptorImageInfo samplerInfo{};
+	samplerInfo.sampler = sampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_set;
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = slot;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &samplerInfo;
+
+	vkUpdateDescriptorSets(m_device.logical(), 1, &descriptorWrite, 0, nullptr);
+	m_samplerSlots.emplace(sampler, slot);
+	return slot;
+}
@@ -0,0 +1,60 @@
+#ifndef BINDLESSTEXTURES_H
+#define BINDLESSTEXTURES_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Device.h"
+#include "Texture.h"
+
+// Every texture and sampler of the scene in one descriptor set, for devices with descriptor indexing.
+// A material ID selects the texture at the same index and, through a small storage buffer, its sampler,
+// so all materials are drawn with one set bind. Shaders get the ID from firstInstance of the draw.
+//
+// Set layout (set 1 in the bindless pipeline):
+//   binding 0: texture2D textures[]   partially bound, update after bind
+//   binding 1: sampler samplers[]     partially bound, update after bind
+//   binding 2: uint samplerIndex[]    one entry per material
+class BindlessTextures {
+	public:
+		static const uint32_t MaxTextures = 4096;
+		static const uint32_t MaxSamplers = 64;
+
+		BindlessTextures(const Device& device);
+		~BindlessTextures();
+
+		BindlessTextures(const BindlessTextures&) = delete;
+		BindlessTextures& operator=(const BindlessTextures&) = delete;
+
+		// Writes the texture into a free slot and returns its material ID. Slots can be written while earlier
+		// frames using other slots are still in flight.
+		uint32_t AddMaterial(Texture& texture, VkSampler sampler);
+		// The slot is reused by the next AddMaterial, so no submitted frame may still draw with it
+		void RemoveMaterial(uint32_t material);
+
+		inline VkDescriptorSetLayout layout() const { return m_layout; }
+		inline VkDescriptorSet set() const { return m_set; }
+		inline uint32_t capacity() const { return m_capacity; }
+
+	private:
+		const Device& m_device;
+
+		VkDescriptorSetLayout m_layout;
+		VkDescriptorPool m_pool;
+		VkDescriptorSet m_set;
+		uint32_t m_capacity;
+
+		VkBuffer m_materialBuffer;
+		VkDeviceMemory m_materialMemory;
+		uint32_t* m_materialSamplers;
+
+		std::vector<uint32_t> m_freeMaterials;
+		uint32_t m_materialCount = 0;
+		std::unordered_map<VkSampler, uint32_t> m_samplerSlots;
+
+		uint32_t SamplerSlot(VkSampler sampler);
+};
+
+#endif
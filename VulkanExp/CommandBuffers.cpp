@@ -1,14 +1,19 @@
 #include "CommandBuffers.h"
 
+#include <algorithm>
 #include <array>
 
 #include "DescriptorSets.h"
+#include "GpuProfiler.h"
+#include "GpuTimeline.h"
+#include "JobSystem.h"
 
 
-CommandBuffers::CommandBuffers(const Device& device, const RenderPass& renderPass, const SwapChain& swapChain, const GraphicsPipeline& graphicsPipeline, const CommandPool& commandPool, int maxFramesInFlight) 
-	: m_device(device), m_renderPass(renderPass), m_swapChain(swapChain), m_graphicsPipeline(graphicsPipeline), m_commandPool(commandPool) 
+CommandBuffers::CommandBuffers(const Device& device, const RenderPass& renderPass, const RenderTarget& target, const GraphicsPipeline& graphicsPipeline, const CommandPool& commandPool, int maxFramesInFlight) 
+	: m_device(device), m_renderPass(renderPass), m_target(target), m_graphicsPipeline(graphicsPipeline), m_commandPool(commandPool) 
 {
 	m_commandBuffers.resize(maxFramesInFlight);
+	m_secondaries.resize(maxFramesInFlight);
 
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -31,7 +36,80 @@ void CommandBuffers::ResetCommandBuffer(int currentFrame) {
 	vkResetCommandBuffer(m_commandBuffers[currentFrame], 0);
 }
 
-void CommandBuffers::RecordCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, std::vector<uint32_t> indices, DescriptorSets& descriptorSets)
+void CommandBuffers::RecordCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, uint32_t indexCount, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants)
+{
+	BeginRenderPass(currentFrame, imageIndex, vertexBuffer, indexBuffer, indexType, descriptorSets, uniformOffset);
+
+	vkCmdPushConstants(m_commandBuffers[currentFrame], m_graphicsPipeline.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+	if (m_profiler) {
+		m_profiler->BeginScope(m_commandBuffers[currentFrame], "draw");
+	}
+	vkCmdDrawIndexed(m_commandBuffers[currentFrame], indexCount, 1, 0, 0, 0);
+	if (m_profiler) {
+		m_profiler->EndScope(m_commandBuffers[currentFrame]);
+	}
+
+	EndRenderPass(currentFrame, imageIndex);
+}
+
+void CommandBuffers::RecordIndirectCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, VkDescriptorSet bindlessSet, VkBuffer drawBuffer, uint32_t drawCount)
+{
+	BeginRenderPass(currentFrame, imageIndex, vertexBuffer, indexBuffer, indexType, descriptorSets, uniformOffset);
+
+	// Every material lives in the one bindless set, the draws pick theirs through firstInstance
+	vkCmdBindDescriptorSets(m_commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.layout(), 1, 1, &bindlessSet, 0, nullptr);
+	// The draws of one indirect batch share a transform
+	vkCmdPushConstants(m_commandBuffers[currentFrame], m_graphicsPipeline.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+
+	if (m_profiler) {
+		m_profiler->BeginScope(m_commandBuffers[currentFrame], "indirect draws");
+	}
+	if (m_device.enabledFeatures().multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(m_commandBuffers[currentFrame], drawBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else {
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDrawIndexedIndirect(m_commandBuffers[currentFrame], drawBuffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+	if (m_profiler) {
+		m_profiler->EndScope(m_commandBuffers[currentFrame]);
+	}
+
+	EndRenderPass(currentFrame, imageIndex);
+}
+
+void CommandBuffers::RecordDrawListCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, const std::vector<VkDrawIndexedIndirectCommand>& draws)
+{
+	size_t bufferCount = std::min<size_t>(JobSystem::Instance().workerCount() + 1, draws.size() / MinSecondaryDraws);
+	if (bufferCount > 1) {
+		RecordSecondaryDraws(currentFrame, imageIndex, vertexBuffer, indexBuffer, indexType, descriptorSets, uniformOffset, drawConstants, draws, static_cast<uint32_t>(bufferCount));
+		return;
+	}
+
+	BeginRenderPass(currentFrame, imageIndex, vertexBuffer, indexBuffer, indexType, descriptorSets, uniformOffset);
+
+	vkCmdPushConstants(m_commandBuffers[currentFrame], m_graphicsPipeline.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+	if (m_profiler) {
+		m_profiler->BeginScope(m_commandBuffers[currentFrame], "draw list");
+	}
+	for (const VkDrawIndexedIndirectCommand& draw : draws) {
+		vkCmdDrawIndexed(m_commandBuffers[currentFrame], draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+	}
+	if (m_profiler) {
+		m_profiler->EndScope(m_commandBuffers[currentFrame]);
+	}
+
+	EndRenderPass(currentFrame, imageIndex);
+}
+
+void CommandBuffers::BeginRenderPass(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset)
+{
+	BeginRenderPass(currentFrame, imageIndex, VK_SUBPASS_CONTENTS_INLINE);
+	BindDrawState(m_commandBuffers[currentFrame], vertexBuffer, indexBuffer, indexType, descriptorSets.GetDescriptorSet(), uniformOffset);
+}
+
+void CommandBuffers::BeginRenderPass(int currentFrame, int imageIndex, VkSubpassContents contents)
 {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -40,12 +118,18 @@ void CommandBuffers::RecordCommandBuffer(int currentFrame, int imageIndex, const
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
+	// Query resets have to happen outside the render pass
+	if (m_profiler) {
+		m_profiler->BeginFrame(currentFrame, m_commandBuffers[currentFrame]);
+		m_profiler->BeginScope(m_commandBuffers[currentFrame], "render pass");
+	}
+
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = m_renderPass.handle();
 	renderPassInfo.framebuffer = m_renderPass.frameBuffer(imageIndex);
 	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = m_swapChain.extent();
+	renderPassInfo.renderArea.extent = m_target.extent();
 
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { {0.7f, 0.0f, 0.0f, 1.0f} };
@@ -54,37 +138,113 @@ void CommandBuffers::RecordCommandBuffer(int currentFrame, int imageIndex, const
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(m_commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(m_commandBuffers[currentFrame], &renderPassInfo, contents);
+}
 
-	vkCmdBindPipeline(m_commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.pipeline());
+void CommandBuffers::BindDrawState(VkCommandBuffer commandBuffer, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, VkDescriptorSet descriptorSet, uint32_t uniformOffset)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.pipeline());
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = (float)m_swapChain.extent().width;
-	viewport.height = (float)m_swapChain.extent().height;
+	viewport.width = (float)m_target.extent().width;
+	viewport.height = (float)m_target.extent().height;
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(m_commandBuffers[currentFrame], 0, 1, &viewport);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
-	scissor.extent = m_swapChain.extent();
-	vkCmdSetScissor(m_commandBuffers[currentFrame], 0, 1, &scissor);
+	scissor.extent = m_target.extent();
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
 	VkBuffer vertexBuffers[] = { vertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(m_commandBuffers[currentFrame], 0, 1, vertexBuffers, offsets);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.layout(), 0, 1, &descriptorSet, 1, &uniformOffset);
+}
 
-	vkCmdBindIndexBuffer(m_commandBuffers[currentFrame], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+void CommandBuffers::RecordSecondaryDraws(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, const std::vector<VkDrawIndexedIndirectCommand>& draws, uint32_t bufferCount)
+{
+	BeginRenderPass(currentFrame, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	std::vector<Secondary>& secondaries = m_secondaries[currentFrame];
+	while (secondaries.size() < bufferCount) {
+		Secondary secondary;
+		secondary.pool = std::make_unique<CommandPool>(m_device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = secondary.pool->handle();
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_device.logical(), &allocInfo, &secondary.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		secondaries.push_back(std::move(secondary));
+	}
 
-	// &descriptorSets.GetDescriptorSet(currentFrame)
-	const VkDescriptorSet set = descriptorSets.GetDescriptorSets()[currentFrame];
-	vkCmdBindDescriptorSets(m_commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.layout(), 0, 1, &set, 0, nullptr);
+	// Looked up once here, the descriptor sets are not meant to be shared between threads
+	const VkDescriptorSet set = descriptorSets.GetDescriptorSet();
+	size_t drawsPerBuffer = (draws.size() + bufferCount - 1) / bufferCount;
+
+	JobSystem::Instance().ParallelFor(bufferCount, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			VkCommandBuffer commandBuffer = secondaries[i].buffer;
+			// The frame's fence has been waited on, nothing recorded into the pool last time is still executing
+			vkResetCommandPool(m_device.logical(), secondaries[i].pool->handle(), 0);
+
+			VkCommandBufferInheritanceInfo inheritance{};
+			inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritance.renderPass = m_renderPass.handle();
+			inheritance.subpass = 0;
+			inheritance.framebuffer = m_renderPass.frameBuffer(imageIndex);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			beginInfo.pInheritanceInfo = &inheritance;
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording secondary command buffer!");
+			}
+
+			BindDrawState(commandBuffer, vertexBuffer, indexBuffer, indexType, set, uniformOffset);
+			vkCmdPushConstants(commandBuffer, m_graphicsPipeline.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+			size_t last = std::min(draws.size(), (i + 1) * drawsPerBuffer);
+			for (size_t d = i * drawsPerBuffer; d < last; d++) {
+				const VkDrawIndexedIndirectCommand& draw = draws[d];
+				vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+			}
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record secondary command buffer!");
+			}
+		}
+	});
+
+	std::vector<VkCommandBuffer> buffers(bufferCount);
+	for (uint32_t i = 0; i < bufferCount; i++) {
+		buffers[i] = secondaries[i].buffer;
+	}
+	vkCmdExecuteCommands(m_commandBuffers[currentFrame], bufferCount, buffers.data());
 
-	vkCmdDrawIndexed(m_commandBuffers[currentFrame], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	EndRenderPass(currentFrame, imageIndex);
+}
 
+void CommandBuffers::EndRenderPass(int currentFrame, int imageIndex)
+{
 	vkCmdEndRenderPass(m_commandBuffers[currentFrame]);
+	if (m_profiler) {
+		m_profiler->EndScope(m_commandBuffers[currentFrame]);
+	}
+	m_target.RecordAfterRenderPass(m_commandBuffers[currentFrame], imageIndex);
+	if (m_profiler) {
+		m_profiler->EndFrame(m_commandBuffers[currentFrame]);
+	}
 
 	if (vkEndCommandBuffer(m_commandBuffers[currentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("failed to record command buffer!");
@@ -111,6 +271,14 @@ VkCommandBuffer CommandBuffers::BeginSingleTimeCommands(const Device& device, Co
 	return commandBuffer;
 }
 
+VkCommandBuffer CommandBuffers::BeginSingleTimeCommands(const Device& device, CommandPool& commandPool, GpuTimeline& timeline, const char* scope) {
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
+	if (timeline.profiler()) {
+		timeline.profiler()->BeginUpload(commandBuffer, scope);
+	}
+	return commandBuffer;
+}
+
 void CommandBuffers::EndSingleTimeCommands(VkCommandBuffer commandBuffer, const Device& device, CommandPool& commandPool) {
 	vkEndCommandBuffer(commandBuffer);
 
@@ -123,4 +291,25 @@ void CommandBuffers::EndSingleTimeCommands(VkCommandBuffer commandBuffer, const
 	vkQueueWaitIdle(device.graphicsQueue());
 
 	vkFreeCommandBuffers(device.logical(), commandPool.handle(), 1, &commandBuffer);
-}
\ No newline at end of file
+}
+
+uint64_t CommandBuffers::EndSingleTimeCommands(VkCommandBuffer commandBuffer, const Device& device, CommandPool& commandPool, GpuTimeline& timeline) {
+	GpuProfiler* profiler = timeline.profiler();
+	if (profiler) {
+		profiler->EndUpload(commandBuffer);
+	}
+	vkEndCommandBuffer(commandBuffer);
+
+	uint64_t value = timeline.SubmitUpload(device.graphicsQueue(), commandBuffer);
+	if (profiler) {
+		profiler->UploadSubmitted(commandBuffer, value);
+	}
+
+	VkDevice logical = device.logical();
+	VkCommandPool pool = commandPool.handle();
+	timeline.Retire(value, [logical, pool, commandBuffer]() {
+		vkFreeCommandBuffers(logical, pool, 1, &commandBuffer);
+	});
+
+	return value;
+}
@@ -3,36 +3,74 @@
 
 #include <vulkan/vulkan.h>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "CommandPool.h"
 #include "Device.h"
 #include "GraphicsPipeline.h"
 #include "RenderPass.h"
-#include "SwapChain.h"
+#include "RenderTarget.h"
 #include "DescriptorSets.h"
 
+class GpuTimeline;
+class GpuProfiler;
+
 class CommandBuffers {
 	public:
-		CommandBuffers(const Device& device, const RenderPass& renderpass, const SwapChain& swapChain, const GraphicsPipeline& graphicsPipeline, const CommandPool& commandPool, int maxFramesInFlight);
+		CommandBuffers(const Device& device, const RenderPass& renderpass, const RenderTarget& target, const GraphicsPipeline& graphicsPipeline, const CommandPool& commandPool, int maxFramesInFlight);
 		~CommandBuffers();
 
 		inline VkCommandBuffer& command(uint32_t index) { return m_commandBuffers[index]; }
 		inline const VkCommandBuffer& command(uint32_t index) const { return m_commandBuffers[index]; }
 
+		// Frame, render pass and draw scopes are timed while a profiler is set
+		inline void SetProfiler(GpuProfiler* profiler) { m_profiler = profiler; }
+
 		void ResetCommandBuffer(int currentFrame);
-		void RecordCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, std::vector<uint32_t> indices, DescriptorSets& descriptorSets);
+		// uniformOffset is the dynamic offset of the frame's block in the uniform ring, drawConstants are pushed for the draw
+		void RecordCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, uint32_t indexCount, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants);
+		// Bindless path: drawBuffer holds drawCount VkDrawIndexedIndirectCommands whose firstInstance is the material ID
+		void RecordIndirectCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, VkDescriptorSet bindlessSet, VkBuffer drawBuffer, uint32_t drawCount);
+
+		// Draw lists at least this long are recorded into secondary command buffers on the job system
+		static const size_t MinSecondaryDraws = 512;
+
+		// One vkCmdDrawIndexed per entry of draws, which all share the buffers and the transform. Long lists are
+		// split over secondary command buffers recorded in parallel, those frames have no "draw list" GPU scope
+		void RecordDrawListCommandBuffer(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, const std::vector<VkDrawIndexedIndirectCommand>& draws);
 
 		static VkCommandBuffer BeginSingleTimeCommands(const Device& device, CommandPool& commandPool);
+		// The commands up to the timeline EndSingleTimeCommands are timed as scope if the timeline has a profiler attached
+		static VkCommandBuffer BeginSingleTimeCommands(const Device& device, CommandPool& commandPool, GpuTimeline& timeline, const char* scope);
 		static void EndSingleTimeCommands(VkCommandBuffer commandBuffer, const Device& device, CommandPool& commandPool);
+		// Submits without idling the queue, returns the timeline value the commands signal; the command buffer is freed once it is reached
+		static uint64_t EndSingleTimeCommands(VkCommandBuffer commandBuffer, const Device& device, CommandPool& commandPool, GpuTimeline& timeline);
 
 	protected:
+		// Command pools are externally synchronized, so every secondary command buffer has a pool of its own
+		struct Secondary {
+			std::unique_ptr<CommandPool> pool;
+			VkCommandBuffer buffer = VK_NULL_HANDLE;
+		};
+
 		std::vector<VkCommandBuffer> m_commandBuffers;
+		// Per frame in flight, grown on demand
+		std::vector<std::vector<Secondary>> m_secondaries;
 
 		const Device& m_device;
 		const RenderPass& m_renderPass;
-		const SwapChain& m_swapChain;
+		const RenderTarget& m_target;
 		const GraphicsPipeline& m_graphicsPipeline;
 		const CommandPool& m_commandPool;
+		GpuProfiler* m_profiler = nullptr;
+
+		void BeginRenderPass(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset);
+		void BeginRenderPass(int currentFrame, int imageIndex, VkSubpassContents contents);
+		// Pipeline, viewport, buffers and the per frame descriptor set, for the primary or a secondary command buffer
+		void BindDrawState(VkCommandBuffer commandBuffer, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, VkDescriptorSet descriptorSet, uint32_t uniformOffset);
+		void RecordSecondaryDraws(int currentFrame, int imageIndex, const VkBuffer& vertexBuffer, const VkBuffer& indexBuffer, VkIndexType indexType, DescriptorSets& descriptorSets, uint32_t uniformOffset, const DrawConstants& drawConstants, const std::vector<VkDrawIndexedIndirectCommand>& draws, uint32_t bufferCount);
+		void EndRenderPass(int currentFrame, int imageIndex);
 
 		void createCommandBuffers();
 		void destroyCommandBuffers();
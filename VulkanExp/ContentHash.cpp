@@ -0,0 +1,66 @@
+#include "ContentHash.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	const uint64_t Prime = 1099511628211ULL;
+}
+
+uint64_t ContentHash::Hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+
+	size_t words = size / 8;
+	for (size_t i = 0; i < words; i++) {
+		uint64_t word;
+		memcpy(&word, bytes + i * 8, 8);
+		hash = (hash ^ word) * Prime;
+	}
+	for (size_t i = words * 8; i < size; i++) {
+		hash = (hash ^ bytes[i]) * Prime;
+	}
+
+	// Mix in the length so inputs that only differ by trailing zero bytes differ
+	return (hash ^ size) * Prime;
+}
+
+uint64_t ContentHash::HashString(const std::string& value, uint64_t seed)
+{
+	return Hash(value.data(), value.size(), seed);
+}
+
+uint64_t ContentHash::HashFile(const std::string& path, uint64_t seed)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open file " + path);
+	}
+
+	// Chunks are a multiple of 8 so the result matches hashing the whole file at once, except for the length mix
+	std::vector<char> buffer(1 << 20);
+	uint64_t hash = seed;
+	uint64_t total = 0;
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		size_t count = static_cast<size_t>(file.gcount());
+		if (count == 0) {
+			break;
+		}
+		size_t words = count / 8;
+		for (size_t i = 0; i < words; i++) {
+			uint64_t word;
+			memcpy(&word, buffer.data() + i * 8, 8);
+			hash = (hash ^ word) * Prime;
+		}
+		for (size_t i = words * 8; i < count; i++) {
+			hash = (hash ^ static_cast<uint8_t>(buffer[i])) * Prime;
+		}
+		total += count;
+	}
+
+	return (hash ^ total) * Prime;
+}
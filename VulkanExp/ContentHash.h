@@ -0,0 +1,20 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a over 8 byte words, used to detect changed asset inputs. Not a cryptographic hash.
+class ContentHash {
+	public:
+		ContentHash() = delete;
+		~ContentHash() = delete;
+
+		static const uint64_t Seed = 14695981039346656037ULL;
+
+		static uint64_t Hash(const void* data, size_t size, uint64_t seed = Seed);
+		static uint64_t HashString(const std::string& value, uint64_t seed = Seed);
+		static uint64_t HashFile(const std::string& path, uint64_t seed = Seed);
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	struct Event {
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t thread;
+	};
+
+	// Written by its owning thread only, read by Collect. A ring whose thread has exited is handed to the next new
+	// thread once it has been drained, so pools of short lived worker threads don't grow the list forever
+	struct Ring {
+		Event events[CpuProfiler::RingSize];
+		std::atomic<uint32_t> head{ 0 };
+		std::atomic<uint32_t> tail{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<bool> owned{ true };
+		uint32_t thread = 0;
+	};
+
+	// Below 16 ns one bucket per nanosecond, above that 8 buckets per power of two: within 12.5% everywhere
+	const uint32_t LinearBuckets = 16;
+	const uint32_t SubBuckets = 8;
+	const uint32_t BucketCount = LinearBuckets + (64 - 4) * SubBuckets;
+
+	struct Histogram {
+		std::vector<uint32_t> buckets = std::vector<uint32_t>(BucketCount);
+		uint64_t count = 0;
+		uint64_t maxNs = 0;
+
+		static uint32_t Bucket(uint64_t ns) {
+			if (ns < LinearBuckets) {
+				return static_cast<uint32_t>(ns);
+			}
+			uint32_t exponent = 63;
+			while (!(ns >> exponent)) {
+				--exponent;
+			}
+			uint32_t sub = static_cast<uint32_t>(ns >> (exponent - 3)) & (SubBuckets - 1);
+			return LinearBuckets + (exponent - 4) * SubBuckets + sub;
+		}
+
+		static uint64_t UpperBound(uint32_t bucket) {
+			if (bucket < LinearBuckets) {
+				return bucket;
+			}
+			uint32_t exponent = (bucket - LinearBuckets) / SubBuckets + 4;
+			uint64_t sub = (bucket - LinearBuckets) % SubBuckets;
+			return ((SubBuckets + sub + 1) << (exponent - 3)) - 1;
+		}
+
+		void Add(uint64_t ns) {
+			++buckets[Bucket(ns)];
+			++count;
+			maxNs = std::max(maxNs, ns);
+		}
+
+		double PercentileMs(double percentile) const {
+			uint64_t rank = static_cast<uint64_t>(percentile * count + 0.5);
+			uint64_t seen = 0;
+			for (uint32_t i = 0; i < BucketCount; ++i) {
+				seen += buckets[i];
+				if (seen >= rank && seen > 0) {
+					return std::min(UpperBound(i), maxNs) / 1000000.0;
+				}
+			}
+			return maxNs / 1000000.0;
+		}
+	};
+
+	struct State {
+		// Guards the ring list and the thread names; recording threads only take it for their first zone
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Ring>> rings;
+		std::map<uint32_t, std::string> threadNames;
+		uint32_t nextThread = 0;
+
+		// Owned by whichever thread collects
+		std::map<std::string, Histogram> window;
+		std::map<std::string, Histogram> total;
+		uint64_t dropped = 0;
+		bool reporting = false;
+		Clock::time_point lastReport = Clock::now();
+
+		bool tracing = false;
+		std::string tracePath;
+		std::vector<Event> trace;
+	};
+
+	State& GetState() {
+		static State state;
+		return state;
+	}
+
+	const Clock::time_point Epoch = Clock::now();
+
+	struct RingOwner {
+		Ring* ring = nullptr;
+		~RingOwner() {
+			if (ring) {
+				ring->owned.store(false, std::memory_order_release);
+			}
+		}
+	};
+	thread_local RingOwner t_ring;
+
+	Ring* ThreadRing() {
+		if (t_ring.ring) {
+			return t_ring.ring;
+		}
+
+		State& state = GetState();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (std::unique_ptr<Ring>& ring : state.rings) {
+			if (!ring->owned.load(std::memory_order_acquire) && ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed)) {
+				ring->owned.store(true, std::memory_order_relaxed);
+				ring->thread = state.nextThread++;
+				t_ring.ring = ring.get();
+				return t_ring.ring;
+			}
+		}
+
+		state.rings.emplace_back(new Ring());
+		state.rings.back()->thread = state.nextThread++;
+		t_ring.ring = state.rings.back().get();
+		return t_ring.ring;
+	}
+
+	void WriteEscaped(std::ostream& out, const std::string& text) {
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out << '\\';
+			}
+			out << c;
+		}
+	}
+
+	void PrintHistograms(std::ostream& out, const std::map<std::string, Histogram>& histograms) {
+		std::ios format(nullptr);
+		format.copyfmt(out);
+		out << std::fixed << std::setprecision(3);
+		for (const auto& zone : histograms) {
+			const Histogram& histogram = zone.second;
+			out << "  " << std::left << std::setw(24) << zone.first << std::right << std::setw(8) << histogram.count
+				<< "  p50 " << histogram.PercentileMs(0.50) << "  p95 " << histogram.PercentileMs(0.95)
+				<< "  p99 " << histogram.PercentileMs(0.99) << "  max " << histogram.maxNs / 1000000.0 << " ms" << std::endl;
+		}
+		out.copyfmt(format);
+	}
+}
+
+std::atomic<bool> CpuProfiler::s_enabled{ false };
+
+bool CpuProfiler::ParseArgument(int argc, char* argv[], int& index)
+{
+	std::string arg = argv[index];
+	if (arg == "--cpu-profile") {
+		GetState().reporting = true;
+		SetEnabled(true);
+	}
+	else if (arg == "--trace" && index + 1 < argc) {
+		BeginTrace(argv[++index]);
+	}
+	else {
+		return false;
+	}
+
+	// Options are parsed on the main thread
+	SetThreadName("main");
+	return true;
+}
+
+void CpuProfiler::SetEnabled(bool enabled)
+{
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void CpuProfiler::BeginTrace(const std::string& path)
+{
+	State& state = GetState();
+	state.tracing = true;
+	state.tracePath = path;
+	state.trace.clear();
+	SetEnabled(true);
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+	uint32_t thread = ThreadRing()->thread;
+	State& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.threadNames[thread] = name;
+}
+
+uint64_t CpuProfiler::Now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - Epoch).count());
+}
+
+void CpuProfiler::Record(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	Ring* ring = ThreadRing();
+	uint32_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) == RingSize) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->events[head % RingSize] = { name, beginNs, endNs, ring->thread };
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::Collect()
+{
+	State& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	for (std::unique_ptr<Ring>& ring : state.rings) {
+		uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+		uint32_t head = ring->head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail) {
+			const Event& event = ring->events[tail % RingSize];
+			uint64_t ns = event.end - event.begin;
+			state.window[event.name].Add(ns);
+			state.total[event.name].Add(ns);
+			if (state.tracing && state.trace.size() < MaxTraceEvents) {
+				state.trace.push_back(event);
+			}
+		}
+		ring->tail.store(tail, std::memory_order_release);
+		state.dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+	}
+}
+
+bool CpuProfiler::Report(std::ostream& out, double intervalSeconds)
+{
+	State& state = GetState();
+	Clock::time_point now = Clock::now();
+	if (!state.reporting || std::chrono::duration<double>(now - state.lastReport).count() < intervalSeconds || state.window.empty()) {
+		return false;
+	}
+
+	out << "cpu zones:" << std::endl;
+	PrintHistograms(out, state.window);
+	state.window.clear();
+	state.lastReport = now;
+	return true;
+}
+
+void CpuProfiler::Finish(std::ostream& out)
+{
+	if (!enabled()) {
+		return;
+	}
+
+	Collect();
+	State& state = GetState();
+	if (state.reporting && !state.total.empty()) {
+		out << "cpu zones, whole run:" << std::endl;
+		PrintHistograms(out, state.total);
+	}
+	if (state.dropped > 0) {
+		out << state.dropped << " cpu zones dropped, Collect more often or raise CpuProfiler::RingSize" << std::endl;
+	}
+	if (state.tracing) {
+		WriteTrace(state.tracePath);
+		out << state.trace.size() << " cpu zones written to " << state.tracePath << std::endl;
+	}
+}
+
+void CpuProfiler::WriteTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+
+	State& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	// Complete events, timestamps and durations in microseconds
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+	file << std::fixed << std::setprecision(3);
+	bool first = true;
+	for (const auto& thread : state.threadNames) {
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first << ",\"args\":{\"name\":\"";
+		WriteEscaped(file, thread.second);
+		file << "\"}}";
+		first = false;
+	}
+	for (const Event& event : state.trace) {
+		file << (first ? "" : ",\n") << "{\"name\":\"";
+		WriteEscaped(file, event.name);
+		file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+		first = false;
+	}
+	file << std::endl << "]}" << std::endl;
+}
@@ -0,0 +1,109 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "Device.h"
+
+namespace {
+	// Descriptors of each type reserved per set, pools are sized as a multiple of this
+	const std::pair<VkDescriptorType, uint32_t> PoolRatios[] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4 },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 }
+	};
+}
+
+DescriptorAllocator::DescriptorAllocator(const Device& device, uint32_t setsPerPool) : m_device(device), m_setsPerPool(setsPerPool)
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	for (VkDescriptorPool pool : m_usedPools) {
+		vkDestroyDescriptorPool(m_device.logical(), pool, nullptr);
+	}
+	for (VkDescriptorPool pool : m_freePools) {
+		vkDestroyDescriptorPool(m_device.logical(), pool, nullptr);
+	}
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+	if (m_currentPool == VK_NULL_HANDLE) {
+		m_currentPool = NextPool();
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_currentPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(m_device.logical(), &allocInfo, &set);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		// The current pool is full, retry once with a fresh one
+		m_currentPool = NextPool();
+		allocInfo.descriptorPool = m_currentPool;
+		result = vkAllocateDescriptorSets(m_device.logical(), &allocInfo, &set);
+	}
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor sets!");
+	}
+	return set;
+}
+
+void DescriptorAllocator::Reset()
+{
+	for (VkDescriptorPool pool : m_usedPools) {
+		vkResetDescriptorPool(m_device.logical(), pool, 0);
+		m_freePools.push_back(pool);
+	}
+	m_usedPools.clear();
+	m_currentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorAllocator::NextPool()
+{
+	VkDescriptorPool pool;
+	if (!m_freePools.empty()) {
+		pool = m_freePools.back();
+		m_freePools.pop_back();
+	}
+	else {
+		pool = CreatePool(m_setsPerPool);
+		// Each new pool is twice the size of the last, so a growing scene needs only a handful of them
+		m_setsPerPool = std::min(m_setsPerPool * 2, MaxSetsPerPool);
+	}
+	m_usedPools.push_back(pool);
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool(uint32_t maxSets)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const auto& ratio : PoolRatios) {
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = ratio.first;
+		poolSize.descriptorCount = ratio.second * maxSets;
+		poolSizes.push_back(poolSize);
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = maxSets;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_device.logical(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+	return pool;
+}
@@ -0,0 +1,41 @@
+#ifndef DESCRIPTORALLOCATOR_H
+#define DESCRIPTORALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+class Device;
+
+// Hands out descriptor sets from a list of pools, adding a bigger pool whenever the current one is exhausted,
+// so the number of sets is never fixed up front. Sets are not freed one by one: Reset returns every set at once,
+// which makes one allocator per frame in flight a cheap home for transient sets.
+class DescriptorAllocator {
+	public:
+		DescriptorAllocator(const Device& device, uint32_t setsPerPool = 32);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		// Every set allocated so far becomes invalid, the pools are kept for reuse
+		void Reset();
+
+		inline size_t poolCount() const { return m_usedPools.size() + m_freePools.size(); }
+
+	private:
+		static const uint32_t MaxSetsPerPool = 4096;
+
+		const Device& m_device;
+		uint32_t m_setsPerPool;
+
+		VkDescriptorPool m_currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> m_usedPools;
+		std::vector<VkDescriptorPool> m_freePools;
+
+		VkDescriptorPool NextPool();
+		VkDescriptorPool CreatePool(uint32_t maxSets);
+};
+
+#endif
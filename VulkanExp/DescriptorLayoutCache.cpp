@@ -0,0 +1,97 @@
+#include "DescriptorLayoutCache.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ContentHash.h"
+#include "Device.h"
+
+DescriptorLayoutCache::DescriptorLayoutCache(const Device& device) : m_device(device)
+{
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+	for (const auto& layout : m_layouts) {
+		vkDestroyDescriptorSetLayout(m_device.logical(), layout.second, nullptr);
+	}
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::Get(const VkDescriptorSetLayoutCreateInfo& createInfo)
+{
+	Key key = MakeKey(createInfo);
+	auto found = m_layouts.find(key);
+	if (found != m_layouts.end()) {
+		return found->second;
+	}
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(m_device.logical(), &createInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+	m_layouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+DescriptorLayoutCache::Key DescriptorLayoutCache::MakeKey(const VkDescriptorSetLayoutCreateInfo& createInfo)
+{
+	const VkDescriptorBindingFlags* bindingFlags = nullptr;
+	if (createInfo.pNext) {
+		const VkDescriptorSetLayoutBindingFlagsCreateInfo* flagsInfo = static_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(createInfo.pNext);
+		if (flagsInfo->sType != VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO || flagsInfo->pNext) {
+			throw std::runtime_error("descriptor layout cache only supports binding flags in pNext!");
+		}
+		if (flagsInfo->bindingCount == createInfo.bindingCount) {
+			bindingFlags = flagsInfo->pBindingFlags;
+		}
+	}
+
+	Key key;
+	key.flags = createInfo.flags;
+	key.bindings.resize(createInfo.bindingCount);
+	for (uint32_t i = 0; i < createInfo.bindingCount; i++) {
+		const VkDescriptorSetLayoutBinding& source = createInfo.pBindings[i];
+		Binding& binding = key.bindings[i];
+		binding.binding = source.binding;
+		binding.descriptorType = source.descriptorType;
+		binding.descriptorCount = source.descriptorCount;
+		binding.stageFlags = source.stageFlags;
+		binding.bindingFlags = bindingFlags ? bindingFlags[i] : 0;
+		if (source.pImmutableSamplers) {
+			binding.immutableSamplers.assign(source.pImmutableSamplers, source.pImmutableSamplers + source.descriptorCount);
+		}
+	}
+
+	std::sort(key.bindings.begin(), key.bindings.end(), [](const Binding& a, const Binding& b) {
+		return a.binding < b.binding;
+	});
+	return key;
+}
+
+bool DescriptorLayoutCache::Binding::operator==(const Binding& other) const
+{
+	return binding == other.binding
+		&& descriptorType == other.descriptorType
+		&& descriptorCount == other.descriptorCount
+		&& stageFlags == other.stageFlags
+		&& bindingFlags == other.bindingFlags
+		&& immutableSamplers == other.immutableSamplers;
+}
+
+bool DescriptorLayoutCache::Key::operator==(const Key& other) const
+{
+	return flags == other.flags && bindings == other.bindings;
+}
+
+size_t DescriptorLayoutCache::KeyHash::operator()(const Key& key) const
+{
+	uint64_t hash = ContentHash::Hash(&key.flags, sizeof(key.flags));
+	for (const Binding& binding : key.bindings) {
+		uint32_t fields[5] = { binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, binding.bindingFlags };
+		hash = ContentHash::Hash(fields, sizeof(fields), hash);
+		if (!binding.immutableSamplers.empty()) {
+			hash = ContentHash::Hash(binding.immutableSamplers.data(), binding.immutableSamplers.size() * sizeof(VkSampler), hash);
+		}
+	}
+	return static_cast<size_t>(hash);
+}
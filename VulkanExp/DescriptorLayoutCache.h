@@ -0,0 +1,55 @@
+#ifndef DESCRIPTORLAYOUTCACHE_H
+#define DESCRIPTORLAYOUTCACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Device;
+
+// One VkDescriptorSetLayout per distinct binding signature, shared by everything that asks for it and
+// destroyed with the cache. Binding order in the create info does not matter.
+class DescriptorLayoutCache {
+	public:
+		DescriptorLayoutCache(const Device& device);
+		~DescriptorLayoutCache();
+
+		DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+		DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+		// Accepts a VkDescriptorSetLayoutBindingFlagsCreateInfo in pNext, nothing else
+		VkDescriptorSetLayout Get(const VkDescriptorSetLayoutCreateInfo& createInfo);
+
+		inline size_t size() const { return m_layouts.size(); }
+
+	private:
+		struct Binding {
+			uint32_t binding;
+			uint32_t descriptorType;
+			uint32_t descriptorCount;
+			uint32_t stageFlags;
+			uint32_t bindingFlags;
+			std::vector<VkSampler> immutableSamplers;
+
+			bool operator==(const Binding& other) const;
+		};
+
+		struct Key {
+			uint32_t flags;
+			std::vector<Binding> bindings;
+
+			bool operator==(const Key& other) const;
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		const Device& m_device;
+		std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> m_layouts;
+
+		static Key MakeKey(const VkDescriptorSetLayoutCreateInfo& createInfo);
+};
+
+#endif
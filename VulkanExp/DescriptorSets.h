@@ -5,31 +5,42 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "Texture.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorLayoutCache.h"
 
+// Per-frame data, per-draw transforms come in through push constants (see DrawConstants)
 struct UniformBufferObject {
-	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
+	alignas(16) glm::mat4 viewProj;
 };
 
 class DescriptorSets {
 
 	public:
-		DescriptorSets(const Device& device, uint32_t maxFramesInFlight, std::vector<VkBuffer> uniformBuffers, Texture& texture);
+		// Binding 0 is a dynamic uniform buffer over the whole uniform ring, the per-draw block is picked with a dynamic offset.
+		// A non-null immutableSampler is baked into the set layout and replaces the texture's own sampler.
+		// The layout comes from layoutCache and the set from allocator, both keep ownership.
+		DescriptorSets(const Device& device, DescriptorAllocator& allocator, DescriptorLayoutCache& layoutCache, VkBuffer uniformBuffer, Texture& texture, VkSampler immutableSampler = VK_NULL_HANDLE);
 		~DescriptorSets();
 
-		inline const std::vector<VkDescriptorSet> GetDescriptorSets() { return m_descriptorSets; }
+		// Switches to a new set from frameAllocator with binding 1 pointing at texture. The allocator belongs to the
+		// frame being recorded and is reset once the GPU is done with that frame, so the texture can change every frame
+		void BeginFrame(DescriptorAllocator& frameAllocator, Texture& texture);
+
+		// The set from the last BeginFrame, or the one allocated by the constructor before that
+		inline const VkDescriptorSet GetDescriptorSet() { return m_descriptorSet; }
 		inline const VkDescriptorSetLayout GetLayout() { return m_descriptorSetLayout; }
 
 	private:
-		Device m_device;
+		const Device& m_device;
 
-		VkDescriptorPool m_descriptorPool;
-		std::vector<VkDescriptorSet> m_descriptorSets;
+		VkDescriptorSet m_descriptorSet;
 		VkDescriptorSetLayout m_descriptorSetLayout;
-		uint32_t m_maxFramesInFlight;
+		VkBuffer m_uniformBuffer;
+		VkSampler m_immutableSampler;
 
-		std::vector<VkBuffer> m_uniformBuffers;
+		void Write(VkDescriptorSet set, Texture& texture);
 
 };
 
@@ -1,6 +1,7 @@
 #include "Device.h"
 
 #include "Instance.h"
+#include "MemoryTracker.h"
 #include "Window.h"
 #include "QueueFamily.h"
 #include "SwapChain.h"
@@ -14,12 +15,27 @@ Device::Device(const Instance& instance,
 	const std::vector<const char*>& extensions)
 	: m_physical(VK_NULL_HANDLE),
 	m_logical(VK_NULL_HANDLE),
-	m_window(window),
+	m_window(&window),
 	m_instance(instance),
 	m_graphicsQueue(VK_NULL_HANDLE),
 	m_presentQueue(VK_NULL_HANDLE) {
-	m_physical = PickPhysicalDevice(m_instance.handle(), m_window.surface(), extensions);
-	m_indices = QueueFamily::FindQueueFamilies(m_physical, m_window.surface());
+	CreateDevice(window.surface(), extensions);
+}
+
+Device::Device(const Instance& instance,
+	const std::vector<const char*>& extensions)
+	: m_physical(VK_NULL_HANDLE),
+	m_logical(VK_NULL_HANDLE),
+	m_window(nullptr),
+	m_instance(instance),
+	m_graphicsQueue(VK_NULL_HANDLE),
+	m_presentQueue(VK_NULL_HANDLE) {
+	CreateDevice(VK_NULL_HANDLE, extensions);
+}
+
+void Device::CreateDevice(const VkSurfaceKHR& surface, const std::vector<const char*>& extensions) {
+	m_physical = PickPhysicalDevice(m_instance.handle(), surface, extensions);
+	m_indices = QueueFamily::FindQueueFamilies(m_physical, surface);
 
 	// Setup queue families for device
 	std::set<uint32_t> uniqueQueueFamilies
@@ -36,7 +52,85 @@ Device::Device(const Instance& instance,
 		queueCreateInfos.push_back(createInfo);
 	}
 
-	VkPhysicalDeviceFeatures deviceFeatures = {};
+	// Optional features are enabled whenever the hardware has them
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_physical, &supportedFeatures);
+
+	m_enabledFeatures = {};
+	m_enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	m_enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	m_enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+	std::vector<const char*> enabledExtensions = extensions;
+
+	// Descriptor indexing is core in 1.2 and an extension before that, the feature query itself needs 1.1
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physical, &properties);
+
+	VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+	supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	bool indexingCore = properties.apiVersion >= VK_API_VERSION_1_2;
+	bool indexingExtension = !indexingCore && CheckDeviceExtensionSupport(m_physical, { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME });
+	bool queryIndexing = properties.apiVersion >= VK_API_VERSION_1_1 && (indexingCore || indexingExtension);
+
+	// Timeline semaphores are only used through the core 1.2 entry points
+	VkPhysicalDeviceTimelineSemaphoreFeatures supportedTimeline{};
+	supportedTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	bool queryTimeline = properties.apiVersion >= VK_API_VERSION_1_2;
+
+	if (queryIndexing || queryTimeline) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		void** next = &features2.pNext;
+		if (queryIndexing) {
+			*next = &supportedIndexing;
+			next = &supportedIndexing.pNext;
+		}
+		if (queryTimeline) {
+			*next = &supportedTimeline;
+		}
+		vkGetPhysicalDeviceFeatures2(m_physical, &features2);
+	}
+
+	// Material IDs reach the shader through firstInstance of the indirect draws
+	m_descriptorIndexing = supportedIndexing.runtimeDescriptorArray
+		&& supportedIndexing.descriptorBindingPartiallyBound
+		&& supportedIndexing.descriptorBindingSampledImageUpdateAfterBind
+		&& supportedIndexing.descriptorBindingUpdateUnusedWhilePending
+		&& supportedIndexing.shaderSampledImageArrayNonUniformIndexing
+		&& supportedFeatures.drawIndirectFirstInstance;
+	m_timelineSemaphore = supportedTimeline.timelineSemaphore == VK_TRUE;
+
+	VkPhysicalDeviceDescriptorIndexingFeatures enabledIndexing{};
+	enabledIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	VkPhysicalDeviceFeatures2 enabledFeatures2{};
+	enabledFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	enabledFeatures2.features = m_enabledFeatures;
+	VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimeline{};
+	enabledTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	enabledTimeline.timelineSemaphore = m_timelineSemaphore ? VK_TRUE : VK_FALSE;
+	void** enabledNext = &enabledFeatures2.pNext;
+	if (m_descriptorIndexing) {
+		*enabledNext = &enabledIndexing;
+		enabledNext = &enabledIndexing.pNext;
+		enabledIndexing.runtimeDescriptorArray = VK_TRUE;
+		enabledIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+		enabledIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		enabledIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		enabledIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		if (indexingExtension) {
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+	}
+	if (m_timelineSemaphore) {
+		*enabledNext = &enabledTimeline;
+	}
+
+	// The budget is read through vkGetPhysicalDeviceMemoryProperties2, which needs 1.1
+	m_memoryBudget = properties.apiVersion >= VK_API_VERSION_1_1 && CheckDeviceExtensionSupport(m_physical, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+	if (m_memoryBudget) {
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 
 	// Setup logical device
 	VkDeviceCreateInfo createInfo = {};
@@ -45,10 +139,17 @@ Device::Device(const Instance& instance,
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-	createInfo.pEnabledFeatures = &deviceFeatures;
+	// Features2 in the chain replaces pEnabledFeatures, older devices keep the 1.0 path
+	if (m_descriptorIndexing || m_timelineSemaphore) {
+		createInfo.pNext = &enabledFeatures2;
+		createInfo.pEnabledFeatures = nullptr;
+	}
+	else {
+		createInfo.pEnabledFeatures = &m_enabledFeatures;
+	}
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-	createInfo.ppEnabledExtensionNames = extensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (m_instance.validationLayersEnabled()) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(Instance::ValidationLayers.size());
@@ -65,9 +166,14 @@ Device::Device(const Instance& instance,
 	// Get handles for graphics and presentation queues
 	vkGetDeviceQueue(m_logical, m_indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_logical, m_indices.presentFamily.value(), 0, &m_presentQueue);
+
+	m_memory.reset(new MemoryTracker(*this, m_memoryBudget));
 }
 
-Device::~Device() { vkDestroyDevice(m_logical, nullptr); }
+Device::~Device() {
+	m_memory.reset();
+	vkDestroyDevice(m_logical, nullptr);
+}
 
 bool Device::CheckDeviceExtensionSupport(const VkPhysicalDevice& device,
 	const std::vector<const char*>& extensions) {
@@ -109,29 +215,47 @@ VkPhysicalDevice Device::PickPhysicalDevice(const VkInstance& instance,
 
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	for (const auto& device : devices) {
-		if (IsDeviceSuitable(device, surface)) {
+		if (IsDeviceSuitable(device, surface, requiredExtensions)) {
 			physicalDevice = device;
 			break;
 		}
 	}
 
 	if (physicalDevice == VK_NULL_HANDLE) {
-		throw std::runtime_error("failed to find a suitable GPU!");
+		throw std::runtime_error("failed to find a suitable GPU, one with Vulkan 1.2 and timeline semaphores is required!");
 	}
 
 	return physicalDevice;
 }
 
-bool Device::IsDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surface) {
+bool Device::IsDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surface, const std::vector<const char*>& requiredExtensions) {
 	QueueFamilyIndices indices = QueueFamily::FindQueueFamilies(device, surface);
 
-	bool extensionsSupported = CheckDeviceExtensionSupport(device, Instance::DeviceExtensions);
+	bool extensionsSupported = requiredExtensions.empty() || CheckDeviceExtensionSupport(device, requiredExtensions);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	// Headless devices never present
+	bool swapChainAdequate = surface == VK_NULL_HANDLE;
+	if (extensionsSupported && !swapChainAdequate) {
 		SwapChainSupportDetails swapChainSupport = SwapChain::QuerySwapChainSupport(device, surface);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate;
+	return indices.isComplete() && extensionsSupported && swapChainAdequate && SupportsTimeline(device);
+}
+
+bool Device::SupportsTimeline(const VkPhysicalDevice& device) {
+	// Every mode synchronizes through GpuTimeline, a device without it could not even start
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return false;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timeline{};
+	timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &timeline;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+	return timeline.timelineSemaphore == VK_TRUE;
 }
\ No newline at end of file
@@ -2,15 +2,19 @@
 #define DEVICE_H
 
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <vector>
 #include "QueueFamily.h"
 
 class Instance;
 class Window;
+class MemoryTracker;
 
 class Device {
 	public:
 		Device(const Instance& instance, const Window& window, const std::vector<const char*>& extensions);
+		// Headless, no surface: any device with a graphics queue will do and presentQueue() is the graphics queue
+		Device(const Instance& instance, const std::vector<const char*>& extensions);
 		~Device();
 
 		inline const VkPhysicalDevice& physical() const { return m_physical; }
@@ -18,23 +22,42 @@ class Device {
 		inline const QueueFamilyIndices& queueFamilyIndices() const { return m_indices; }
 		inline const VkQueue& graphicsQueue() const { return m_graphicsQueue; }
 		inline const VkQueue& presentQueue() const { return m_presentQueue; }
+		inline const VkPhysicalDeviceFeatures& enabledFeatures() const { return m_enabledFeatures; }
+		// Everything the bindless texture path needs: runtime sized, partially bound, update after bind sampled image arrays
+		inline bool descriptorIndexingEnabled() const { return m_descriptorIndexing; }
+		// Core 1.2 timeline semaphores, GpuTimeline needs them
+		inline bool timelineSemaphoreEnabled() const { return m_timelineSemaphore; }
+		// VK_EXT_memory_budget, lets MemoryTracker follow the driver's budget instead of guessing one
+		inline bool memoryBudgetEnabled() const { return m_memoryBudget; }
+		// Every device memory allocation and free goes through the tracker
+		inline MemoryTracker& memory() const { return *m_memory; }
 
 	private:
 		VkPhysicalDevice m_physical;
 		VkDevice m_logical;
 
 		const Instance& m_instance;
-		const Window& m_window;
+		// nullptr for headless devices
+		const Window* m_window;
 
 		QueueFamilyIndices m_indices;
+		VkPhysicalDeviceFeatures m_enabledFeatures;
+		bool m_descriptorIndexing = false;
+		bool m_timelineSemaphore = false;
+		bool m_memoryBudget = false;
+		std::unique_ptr<MemoryTracker> m_memory;
 		VkQueue m_graphicsQueue;
 		VkQueue m_presentQueue;
 
+		void CreateDevice(const VkSurfaceKHR& surface, const std::vector<const char*>& extensions);
+
 		static bool CheckDeviceExtensionSupport(const VkPhysicalDevice& device, const std::vector<const char*>& extensions);
 
 		static VkPhysicalDevice PickPhysicalDevice(const VkInstance& instance, const VkSurfaceKHR& surface, const std::vector<const char*>& requiredExtensions);
 
-		static bool IsDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surface);
+		static bool IsDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surface, const std::vector<const char*>& requiredExtensions);
+		// Vulkan 1.2 with the timelineSemaphore feature
+		static bool SupportsTimeline(const VkPhysicalDevice& device);
 };
 
 #endif
\ No newline at end of file
@@ -6,6 +6,8 @@
 
 class Device;
 
+// Binary semaphores for swapchain acquire and present, plus the GpuTimeline value each frame slot last signalled.
+// Waiting for that value replaces the per-frame fence.
 class FencesAndSemaphores {
 	public:
 		FencesAndSemaphores(const Device& device, uint32_t numImages, uint32_t maxFramesInFlight);
@@ -13,7 +15,7 @@ class FencesAndSemaphores {
 
 		inline VkSemaphore& imageAvailable(uint32_t index) { return m_imageAvailable[index]; }
 		inline VkSemaphore& renderFinished(uint32_t index) { return m_renderFinished[index]; }
-		inline VkFence& inFlightFence(uint32_t index) { return m_inFlightFences[index]; }
+		inline uint64_t& frameValue(uint32_t index) { return m_frameValues[index]; }
 
 	private:
 		const Device& m_device;
@@ -22,7 +24,7 @@ class FencesAndSemaphores {
 
 		std::vector<VkSemaphore> m_imageAvailable;
 		std::vector<VkSemaphore> m_renderFinished;
-		std::vector<VkFence> m_inFlightFences;
+		std::vector<uint64_t> m_frameValues;
 };
 
 
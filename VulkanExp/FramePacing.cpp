@@ -0,0 +1,138 @@
+#include "FramePacing.h"
+
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+	struct PresentModeEntry {
+		const char* name;
+		VkPresentModeKHR mode;
+	};
+
+	const PresentModeEntry PresentModes[] = {
+		{ "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+		{ "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+		{ "fifo", VK_PRESENT_MODE_FIFO_KHR },
+		{ "fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+	};
+}
+
+bool FramePacing::ParseArgument(int argc, char* argv[], int& index)
+{
+	std::string arg = argv[index];
+
+	if (arg == "--low-latency") {
+		lowLatency = true;
+		return true;
+	}
+
+	if (arg != "--frames" && arg != "--present") {
+		return false;
+	}
+	if (index + 1 >= argc) {
+		throw std::runtime_error(arg + " needs a value!");
+	}
+	std::string value = argv[++index];
+
+	if (arg == "--frames") {
+		unsigned long frames = std::stoul(value);
+		if (frames < MinFramesInFlight || frames > MaxFramesInFlight) {
+			throw std::runtime_error("--frames must be between 1 and 4!");
+		}
+		framesInFlight = static_cast<uint32_t>(frames);
+	}
+	else if (!ParsePresentMode(value, presentMode)) {
+		throw std::runtime_error("unknown present mode " + value + ", expected immediate, mailbox, fifo or fifo_relaxed!");
+	}
+	return true;
+}
+
+bool FramePacing::ParsePresentMode(const std::string& name, VkPresentModeKHR& mode)
+{
+	for (const PresentModeEntry& entry : PresentModes) {
+		if (name == entry.name) {
+			mode = entry.mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* FramePacing::PresentModeName(VkPresentModeKHR mode)
+{
+	for (const PresentModeEntry& entry : PresentModes) {
+		if (mode == entry.mode) {
+			return entry.name;
+		}
+	}
+	return "unknown";
+}
+
+LatencyTracker::LatencyTracker(uint32_t framesInFlight) : m_pending(framesInFlight), m_windowStart(Clock::now())
+{
+}
+
+void LatencyTracker::InputSampled(uint32_t frame)
+{
+	InputSampled(frame, Clock::now());
+}
+
+void LatencyTracker::InputSampled(uint32_t frame, std::chrono::steady_clock::time_point time)
+{
+	m_pending[frame].input = time;
+	m_pending[frame].value = 0;
+}
+
+void LatencyTracker::Submitted(uint32_t frame, uint64_t timelineValue)
+{
+	m_pending[frame].value = timelineValue;
+}
+
+void LatencyTracker::Update(uint64_t completedValue)
+{
+	Clock::time_point now = Clock::now();
+	for (Pending& pending : m_pending) {
+		if (pending.value == 0 || pending.value > completedValue) {
+			continue;
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(now - pending.input).count();
+		pending.value = 0;
+
+		++m_windowFrames;
+		m_windowMs += ms;
+		if (ms > m_windowMaxMs) {
+			m_windowMaxMs = ms;
+		}
+
+		++m_totalFrames;
+		m_totalMs += ms;
+		if (ms > m_totalMaxMs) {
+			m_totalMaxMs = ms;
+		}
+	}
+}
+
+bool LatencyTracker::Report(std::ostream& out, const std::string& label, double intervalSeconds)
+{
+	Clock::time_point now = Clock::now();
+	double seconds = std::chrono::duration<double>(now - m_windowStart).count();
+	if (seconds < intervalSeconds || m_windowFrames == 0) {
+		return false;
+	}
+
+	std::ios format(nullptr);
+	format.copyfmt(out);
+	out << label << ": " << std::fixed << std::setprecision(1)
+		<< m_windowFrames / seconds << " fps, input-to-present "
+		<< m_windowMs / m_windowFrames << " ms avg, "
+		<< m_windowMaxMs << " ms max" << std::endl;
+	out.copyfmt(format);
+
+	m_windowStart = now;
+	m_windowFrames = 0;
+	m_windowMs = 0.0;
+	m_windowMaxMs = 0.0;
+	return true;
+}
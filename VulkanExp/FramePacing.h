@@ -0,0 +1,70 @@
+#ifndef FRAMEPACING_H
+#define FRAMEPACING_H
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Frame pacing policy, picked per deployment on the command line. More frames in flight and MAILBOX or IMMEDIATE
+// favour throughput; FIFO with one frame in flight and the low latency wait favours input latency.
+struct FramePacing {
+	static const uint32_t MinFramesInFlight = 1;
+	static const uint32_t MaxFramesInFlight = 4;
+
+	uint32_t framesInFlight = 2;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// Waits for the previous frame to finish on the GPU, and so be handed to present, before sampling input
+	bool lowLatency = false;
+
+	// Consumes argv[index] and its value if it is a pacing option (--frames N, --present MODE, --low-latency),
+	// leaving index on the last argument used. Returns false for anything else
+	bool ParseArgument(int argc, char* argv[], int& index);
+
+	static bool ParsePresentMode(const std::string& name, VkPresentModeKHR& mode);
+	static const char* PresentModeName(VkPresentModeKHR mode);
+};
+
+// Input-to-present latency per frame: from sampling input for a frame to the GPU finishing it, right before
+// the present it waits on. Completion is observed from the CPU when the frame's timeline value is next checked,
+// so outside low latency mode samples can be late by up to a frame.
+class LatencyTracker {
+	public:
+		LatencyTracker(uint32_t framesInFlight);
+
+		void InputSampled(uint32_t frame);
+		// Input sampled earlier, possibly on another thread
+		void InputSampled(uint32_t frame, std::chrono::steady_clock::time_point time);
+		void Submitted(uint32_t frame, uint64_t timelineValue);
+		// Records every submitted frame whose timeline value has been reached
+		void Update(uint64_t completedValue);
+
+		// Prints fps and latency for the frames completed since the last report, once per interval
+		bool Report(std::ostream& out, const std::string& label, double intervalSeconds);
+
+		inline uint64_t frameCount() const { return m_totalFrames; }
+		inline double averageMs() const { return m_totalFrames ? m_totalMs / m_totalFrames : 0.0; }
+		inline double maxMs() const { return m_totalMaxMs; }
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Pending {
+			Clock::time_point input;
+			uint64_t value = 0;
+		};
+		std::vector<Pending> m_pending;
+
+		Clock::time_point m_windowStart;
+		uint64_t m_windowFrames = 0;
+		double m_windowMs = 0.0;
+		double m_windowMaxMs = 0.0;
+
+		uint64_t m_totalFrames = 0;
+		double m_totalMs = 0.0;
+		double m_totalMaxMs = 0.0;
+};
+
+#endif
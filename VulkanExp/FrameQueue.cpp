@@ -0,0 +1,53 @@
+#include "FrameQueue.h"
+
+void FrameQueue::Publish(const FrameSnapshot& snapshot)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_snapshots.size() == Capacity) {
+			m_snapshots.pop_front();
+			m_skipped++;
+		}
+		m_snapshots.push_back(snapshot);
+		m_published++;
+	}
+	m_available.notify_one();
+}
+
+bool FrameQueue::WaitLatest(FrameSnapshot& snapshot)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_available.wait(lock, [this] { return m_closed || !m_snapshots.empty(); });
+	if (m_closed) {
+		return false;
+	}
+	PopLatest(snapshot);
+	return true;
+}
+
+bool FrameQueue::TakeLatest(FrameSnapshot& snapshot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_snapshots.empty()) {
+		return false;
+	}
+	PopLatest(snapshot);
+	m_skipped++;
+	return true;
+}
+
+void FrameQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_available.notify_all();
+}
+
+void FrameQueue::PopLatest(FrameSnapshot& snapshot)
+{
+	snapshot = m_snapshots.back();
+	m_skipped += m_snapshots.size() - 1;
+	m_snapshots.clear();
+}
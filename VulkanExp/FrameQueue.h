@@ -0,0 +1,64 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <glm/glm.hpp>
+
+// Everything the update thread decided about one frame. Published by value and never changed afterwards, so the
+// render thread reads it without locking while the next one is being built
+struct FrameSnapshot {
+	uint64_t update = 0;
+	// Seconds since the first update
+	float time = 0.0f;
+	// When input was sampled, where input-to-present latency starts
+	std::chrono::steady_clock::time_point sampled;
+	// Framebuffer size as the window system reported it, 0x0 while minimized
+	uint32_t width = 0;
+	uint32_t height = 0;
+	glm::mat4 view{ 1.0f };
+	glm::mat4 model{ 1.0f };
+};
+
+// Bounded hand-off from the update thread to the render thread. Publishing never blocks: once Capacity snapshots
+// are waiting the oldest is dropped, so a slow present only ever costs stale frames, never input handling. The
+// render thread always takes the newest snapshot and skips the rest.
+class FrameQueue {
+	public:
+		static const uint32_t Capacity = 2;
+
+		FrameQueue() = default;
+
+		FrameQueue(const FrameQueue&) = delete;
+		FrameQueue& operator=(const FrameQueue&) = delete;
+
+		void Publish(const FrameSnapshot& snapshot);
+		// Blocks until a snapshot is waiting and takes the newest. Returns false once closed
+		bool WaitLatest(FrameSnapshot& snapshot);
+		// Swaps snapshot, taken earlier and not drawn, for the newest one if one is waiting
+		bool TakeLatest(FrameSnapshot& snapshot);
+		// Wakes the render thread for good
+		void Close();
+
+		inline uint64_t published() const { return m_published; }
+		// Published snapshots that were dropped or passed over for a newer one before being drawn
+		inline uint64_t skipped() const { return m_skipped; }
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_available;
+		std::deque<FrameSnapshot> m_snapshots;
+		bool m_closed = false;
+
+		uint64_t m_published = 0;
+		uint64_t m_skipped = 0;
+
+		// Caller holds m_mutex and m_snapshots is not empty
+		void PopLatest(FrameSnapshot& snapshot);
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+#include "GpuTimeline.h"
+
+namespace {
+	// Marks a scope opened after the frame ran out of queries, its EndScope writes nothing
+	const uint32_t NoQuery = UINT32_MAX;
+
+	VkQueryPool CreateTimestampPool(const Device& device, uint32_t queryCount) {
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = queryCount;
+
+		VkQueryPool pool;
+		if (vkCreateQueryPool(device.logical(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+		return pool;
+	}
+}
+
+GpuProfiler::GpuProfiler(const Device& device, GpuTimeline& timeline, uint32_t framesInFlight)
+	: m_device(device), m_timeline(timeline), m_frames(framesInFlight), m_lastReport(std::chrono::steady_clock::now())
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device.physical(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device.physical(), &familyCount, families.data());
+
+	uint32_t validBits = families[device.queueFamilyIndices().graphicsFamily.value()].timestampValidBits;
+	if (validBits == 0) {
+		return;
+	}
+	m_timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device.physical(), &properties);
+	m_nsPerTick = properties.limits.timestampPeriod;
+
+	for (FrameQueries& frame : m_frames) {
+		frame.pool = CreateTimestampPool(device, MaxScopesPerFrame * 2);
+		frame.scopes.reserve(MaxScopesPerFrame);
+	}
+	m_uploadPool = CreateTimestampPool(device, MaxUploadsInFlight * 2);
+	m_uploads.resize(MaxUploadsInFlight);
+
+	m_timeline.SetProfiler(this);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (!enabled()) {
+		return;
+	}
+
+	m_timeline.SetProfiler(nullptr);
+	m_timeline.Wait(m_timeline.lastSubmitted());
+	for (FrameQueries& frame : m_frames) {
+		vkDestroyQueryPool(m_device.logical(), frame.pool, nullptr);
+	}
+	vkDestroyQueryPool(m_device.logical(), m_uploadPool, nullptr);
+}
+
+void GpuProfiler::BeginFrame(uint32_t frame, VkCommandBuffer commandBuffer)
+{
+	if (!enabled()) {
+		return;
+	}
+
+	// Results the frame's last use left unread are dropped, its queries are about to be reset
+	FrameQueries& queries = m_frames[frame];
+	vkCmdResetQueryPool(commandBuffer, queries.pool, 0, MaxScopesPerFrame * 2);
+	queries.scopes.clear();
+	queries.value = 0;
+	queries.recorded = true;
+
+	m_recordingFrame = frame;
+	m_openScopes.clear();
+	BeginScope(commandBuffer, "frame");
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (!enabled()) {
+		return;
+	}
+
+	FrameQueries& queries = m_frames[m_recordingFrame];
+	if (queries.scopes.size() == MaxScopesPerFrame) {
+		m_openScopes.push_back(NoQuery);
+		return;
+	}
+
+	uint32_t query = static_cast<uint32_t>(queries.scopes.size()) * 2;
+	m_openScopes.push_back(static_cast<uint32_t>(queries.scopes.size()));
+	queries.scopes.push_back({ name, query });
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.pool, query);
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer)
+{
+	if (!enabled() || m_openScopes.empty()) {
+		return;
+	}
+
+	uint32_t scope = m_openScopes.back();
+	m_openScopes.pop_back();
+	if (scope != NoQuery) {
+		FrameQueries& queries = m_frames[m_recordingFrame];
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.pool, queries.scopes[scope].query + 1);
+	}
+}
+
+void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer)
+{
+	// Scopes left open would never become available, close them along with the frame
+	while (!m_openScopes.empty()) {
+		EndScope(commandBuffer);
+	}
+}
+
+void GpuProfiler::Submitted(uint32_t frame, uint64_t timelineValue)
+{
+	if (enabled()) {
+		m_frames[frame].value = timelineValue;
+	}
+}
+
+void GpuProfiler::BeginUpload(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (!enabled()) {
+		return;
+	}
+
+	// Uploads outnumbering the ring go untimed rather than waiting for a pair to free up
+	Upload& upload = m_uploads[m_nextUpload];
+	if (upload.inUse) {
+		return;
+	}
+
+	uint32_t query = m_nextUpload * 2;
+	m_nextUpload = (m_nextUpload + 1) % MaxUploadsInFlight;
+
+	upload.name = name;
+	upload.commandBuffer = commandBuffer;
+	upload.value = 0;
+	upload.inUse = true;
+	vkCmdResetQueryPool(commandBuffer, m_uploadPool, query, 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_uploadPool, query);
+}
+
+void GpuProfiler::EndUpload(VkCommandBuffer commandBuffer)
+{
+	for (uint32_t i = 0; i < m_uploads.size(); ++i) {
+		if (m_uploads[i].inUse && m_uploads[i].value == 0 && m_uploads[i].commandBuffer == commandBuffer) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_uploadPool, i * 2 + 1);
+			return;
+		}
+	}
+}
+
+void GpuProfiler::UploadSubmitted(VkCommandBuffer commandBuffer, uint64_t timelineValue)
+{
+	for (Upload& upload : m_uploads) {
+		if (upload.inUse && upload.value == 0 && upload.commandBuffer == commandBuffer) {
+			upload.value = timelineValue;
+			upload.commandBuffer = VK_NULL_HANDLE;
+			return;
+		}
+	}
+}
+
+void GpuProfiler::Collect()
+{
+	if (!enabled()) {
+		return;
+	}
+
+	uint64_t completed = m_timeline.CompletedValue();
+	uint64_t results[MaxScopesPerFrame * 2];
+
+	for (FrameQueries& queries : m_frames) {
+		if (!queries.recorded || queries.value == 0 || queries.value > completed) {
+			continue;
+		}
+
+		uint32_t queryCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+		if (queryCount > 0 && vkGetQueryPoolResults(m_device.logical(), queries.pool, 0, queryCount, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			continue;
+		}
+		for (const Scope& scope : queries.scopes) {
+			Record(scope.name, results[scope.query], results[scope.query + 1]);
+		}
+		queries.recorded = false;
+	}
+
+	for (uint32_t i = 0; i < m_uploads.size(); ++i) {
+		Upload& upload = m_uploads[i];
+		if (!upload.inUse || upload.value == 0 || upload.value > completed) {
+			continue;
+		}
+
+		if (vkGetQueryPoolResults(m_device.logical(), m_uploadPool, i * 2, 2, sizeof(uint64_t) * 2, results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			Record(upload.name, results[0], results[1]);
+		}
+		upload.inUse = false;
+	}
+}
+
+void GpuProfiler::Record(const char* name, uint64_t begin, uint64_t end)
+{
+	double ms = ((end - begin) & m_timestampMask) * m_nsPerTick / 1000000.0;
+
+	auto found = std::find_if(m_history.begin(), m_history.end(), [name](const History& history) { return history.timing.name == name; });
+	if (found == m_history.end()) {
+		m_history.emplace_back();
+		found = m_history.end() - 1;
+		found->timing.name = name;
+		found->window.reserve(WindowSize);
+	}
+
+	History& history = *found;
+	if (history.window.size() < WindowSize) {
+		history.window.push_back(ms);
+	}
+	else {
+		history.window[history.next] = ms;
+	}
+	history.next = (history.next + 1) % WindowSize;
+
+	GpuScopeTiming& timing = history.timing;
+	timing.lastMs = ms;
+	timing.totalMs += ms;
+	++timing.samples;
+	double total = 0.0;
+	timing.maxMs = 0.0;
+	for (double sample : history.window) {
+		total += sample;
+		timing.maxMs = std::max(timing.maxMs, sample);
+	}
+	timing.averageMs = total / history.window.size();
+}
+
+std::vector<GpuScopeTiming> GpuProfiler::timings() const
+{
+	std::vector<GpuScopeTiming> timings;
+	timings.reserve(m_history.size());
+	for (const History& history : m_history) {
+		timings.push_back(history.timing);
+	}
+	return timings;
+}
+
+const GpuScopeTiming* GpuProfiler::Find(const std::string& name) const
+{
+	for (const History& history : m_history) {
+		if (history.timing.name == name) {
+			return &history.timing;
+		}
+	}
+	return nullptr;
+}
+
+bool GpuProfiler::Report(std::ostream& out, double intervalSeconds)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<double>(now - m_lastReport).count() < intervalSeconds || m_history.empty()) {
+		return false;
+	}
+
+	std::ios format(nullptr);
+	format.copyfmt(out);
+	out << "gpu:" << std::fixed << std::setprecision(3);
+	for (const History& history : m_history) {
+		out << " " << history.timing.name << " " << history.timing.averageMs << " ms (max " << history.timing.maxMs << ")";
+	}
+	out << std::endl;
+	out.copyfmt(format);
+
+	m_lastReport = now;
+	return true;
+}
@@ -0,0 +1,115 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Device.h"
+
+class GpuTimeline;
+
+struct GpuScopeTiming {
+	std::string name;
+	double lastMs = 0.0;
+	// Over the last GpuProfiler::WindowSize samples
+	double averageMs = 0.0;
+	double maxMs = 0.0;
+	// Over every sample
+	double totalMs = 0.0;
+	uint64_t samples = 0;
+};
+
+// GPU time of named scopes from timestamp queries. Every frame in flight has its own query pool, reset at the start
+// of its command buffer and read back without waiting once the timeline passes the frame's value; uploads
+// submitted through the timeline get their scopes from a shared ring of query pairs. Scopes nest, EndScope closes
+// the innermost one. Without timestamp support on the graphics queue every call does nothing.
+class GpuProfiler {
+	public:
+		static const uint32_t MaxScopesPerFrame = 32;
+		static const uint32_t MaxUploadsInFlight = 64;
+		static const uint32_t WindowSize = 120;
+
+		// Attaches itself to timeline, which then times the uploads it submits
+		GpuProfiler(const Device& device, GpuTimeline& timeline, uint32_t framesInFlight);
+		// Waits for the queries still in flight before the pools go away
+		~GpuProfiler();
+
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+		// Right after vkBeginCommandBuffer, outside a render pass: resets the frame's queries and opens the "frame" scope
+		void BeginFrame(uint32_t frame, VkCommandBuffer commandBuffer);
+		void BeginScope(VkCommandBuffer commandBuffer, const char* name);
+		void EndScope(VkCommandBuffer commandBuffer);
+		// Closes the "frame" scope, right before vkEndCommandBuffer
+		void EndFrame(VkCommandBuffer commandBuffer);
+		void Submitted(uint32_t frame, uint64_t timelineValue);
+
+		// Used by CommandBuffers for the single time command buffers it submits through the timeline
+		void BeginUpload(VkCommandBuffer commandBuffer, const char* name);
+		void EndUpload(VkCommandBuffer commandBuffer);
+		void UploadSubmitted(VkCommandBuffer commandBuffer, uint64_t timelineValue);
+
+		// Resolves every frame and upload the timeline has passed, never waits
+		void Collect();
+
+		// Prints the rolling average and max of every scope, once per interval
+		bool Report(std::ostream& out, double intervalSeconds);
+
+		inline bool enabled() const { return m_timestampMask != 0; }
+		std::vector<GpuScopeTiming> timings() const;
+		// nullptr if the scope has not completed yet
+		const GpuScopeTiming* Find(const std::string& name) const;
+
+	private:
+		struct Scope {
+			const char* name;
+			uint32_t query;
+		};
+
+		struct FrameQueries {
+			VkQueryPool pool = VK_NULL_HANDLE;
+			std::vector<Scope> scopes;
+			uint64_t value = 0;
+			bool recorded = false;
+		};
+
+		struct Upload {
+			const char* name = nullptr;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			uint64_t value = 0;
+			bool inUse = false;
+		};
+
+		struct History {
+			GpuScopeTiming timing;
+			std::vector<double> window;
+			size_t next = 0;
+		};
+
+		const Device& m_device;
+		GpuTimeline& m_timeline;
+
+		uint64_t m_timestampMask = 0;
+		double m_nsPerTick = 1.0;
+
+		std::vector<FrameQueries> m_frames;
+		uint32_t m_recordingFrame = 0;
+		// Indices into the recording frame's scopes that are still open
+		std::vector<uint32_t> m_openScopes;
+
+		VkQueryPool m_uploadPool = VK_NULL_HANDLE;
+		std::vector<Upload> m_uploads;
+		uint32_t m_nextUpload = 0;
+
+		std::vector<History> m_history;
+		std::chrono::steady_clock::time_point m_lastReport;
+
+		void Record(const char* name, uint64_t begin, uint64_t end);
+};
+
+#endif
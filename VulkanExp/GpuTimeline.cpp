@@ -0,0 +1,189 @@
+#include "GpuTimeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "MemoryTracker.h"
+
+GpuTimeline::GpuTimeline(const Device& device) : m_device(device)
+{
+	if (!device.timelineSemaphoreEnabled()) {
+		throw std::runtime_error("timeline semaphores are not supported by this device!");
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(device.logical(), &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+
+	m_reclaimer = device.memory().AddReclaimer([this]() { return ReclaimRetired(); });
+}
+
+GpuTimeline::~GpuTimeline()
+{
+	m_device.memory().RemoveReclaimer(m_reclaimer);
+	Wait(m_lastSubmitted);
+
+	// Some entries may be waiting on a value nothing will signal any more, the device is idle so release them all
+	for (auto& retired : m_retired) {
+		retired.second();
+	}
+	m_retired.clear();
+	vkDestroySemaphore(m_device.logical(), m_semaphore, nullptr);
+}
+
+uint64_t GpuTimeline::Submit(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore)
+{
+	VkSemaphore waitSemaphores[2];
+	uint64_t waitValues[2];
+	VkPipelineStageFlags waitStages[2];
+	uint32_t waitCount = 0;
+
+	if (waitSemaphore != VK_NULL_HANDLE) {
+		waitSemaphores[waitCount] = waitSemaphore;
+		waitValues[waitCount] = 0;
+		waitStages[waitCount] = waitStage;
+		++waitCount;
+	}
+
+	// Only uploads the GPU hasn't finished yet need a wait, anything older is already visible
+	if (m_lastUpload > CompletedValue()) {
+		waitSemaphores[waitCount] = m_semaphore;
+		waitValues[waitCount] = m_lastUpload;
+		waitStages[waitCount] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		++waitCount;
+	}
+
+	return SubmitSignal(queue, commandBuffer, waitCount, waitSemaphores, waitValues, waitStages, signalSemaphore);
+}
+
+uint64_t GpuTimeline::SubmitUpload(VkQueue queue, VkCommandBuffer commandBuffer)
+{
+	m_lastUpload = SubmitSignal(queue, commandBuffer, 0, nullptr, nullptr, nullptr, VK_NULL_HANDLE);
+	return m_lastUpload;
+}
+
+uint64_t GpuTimeline::SubmitSignal(VkQueue queue, VkCommandBuffer commandBuffer, uint32_t waitCount, const VkSemaphore* waitSemaphores, const uint64_t* waitValues, const VkPipelineStageFlags* waitStages, VkSemaphore signalSemaphore)
+{
+	uint64_t value = m_lastSubmitted + 1;
+
+	// Values for binary semaphores are ignored, the timeline one always goes first
+	VkSemaphore signalSemaphores[] = { m_semaphore, signalSemaphore };
+	uint64_t signalValues[] = { value, 0 };
+	uint32_t signalCount = signalSemaphore != VK_NULL_HANDLE ? 2 : 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = signalCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = signalCount;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit command buffer!");
+	}
+
+	m_lastSubmitted = value;
+	return value;
+}
+
+uint64_t GpuTimeline::CompletedValue() const
+{
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(m_device.logical(), m_semaphore, &value) != VK_SUCCESS) {
+		throw std::runtime_error("failed to read timeline semaphore!");
+	}
+	return value;
+}
+
+void GpuTimeline::Wait(uint64_t value) const
+{
+	if (value == 0) {
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_semaphore;
+	waitInfo.pValues = &value;
+
+	if (vkWaitSemaphores(m_device.logical(), &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for timeline semaphore!");
+	}
+}
+
+void GpuTimeline::Retire(uint64_t value, std::function<void()> release)
+{
+	m_retired.emplace(value, std::move(release));
+}
+
+void GpuTimeline::Retire(std::function<void()> release)
+{
+	Retire(m_lastSubmitted, std::move(release));
+}
+
+void GpuTimeline::RetireBuffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+	const Device* device = &m_device;
+	Retire([device, buffer, memory]() {
+		vkDestroyBuffer(device->logical(), buffer, nullptr);
+		device->memory().Free(memory);
+	});
+}
+
+void GpuTimeline::RetireImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+{
+	const Device* device = &m_device;
+	Retire([device, image, view, memory]() {
+		vkDestroyImageView(device->logical(), view, nullptr);
+		vkDestroyImage(device->logical(), image, nullptr);
+		device->memory().Free(memory);
+	});
+}
+
+void GpuTimeline::Collect()
+{
+	if (m_retired.empty()) {
+		return;
+	}
+
+	uint64_t completed = CompletedValue();
+	auto end = m_retired.upper_bound(completed);
+	for (auto it = m_retired.begin(); it != end; ++it) {
+		it->second();
+	}
+	m_retired.erase(m_retired.begin(), end);
+}
+
+bool GpuTimeline::ReclaimRetired()
+{
+	// Entries past the last submit wait on a value nothing has been asked to signal yet
+	if (m_retired.empty() || m_retired.begin()->first > m_lastSubmitted) {
+		return false;
+	}
+
+	size_t pending = m_retired.size();
+	Wait(std::min(m_retired.rbegin()->first, m_lastSubmitted));
+	Collect();
+	return m_retired.size() < pending;
+}
@@ -0,0 +1,66 @@
+#ifndef GPUTIMELINE_H
+#define GPUTIMELINE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+#include "Device.h"
+
+class GpuProfiler;
+
+// A timeline semaphore every queue submission signals with the next value of a monotonically increasing counter.
+// CPU code waits for values instead of fences or vkDeviceWaitIdle, and resources the GPU may still read are handed
+// to Retire with the value of the last submit that used them; Collect releases them once the GPU has passed it.
+// Uploads are submitted through SubmitUpload, and the next Submit waits on them before its vertex and shader stages.
+class GpuTimeline {
+	public:
+		GpuTimeline(const Device& device);
+		// Waits for everything submitted so far and releases every retired resource
+		~GpuTimeline();
+
+		GpuTimeline(const GpuTimeline&) = delete;
+		GpuTimeline& operator=(const GpuTimeline&) = delete;
+
+		// The binary semaphores are for swapchain acquire and present, which can't use timelines, either may be VK_NULL_HANDLE
+		uint64_t Submit(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore);
+		uint64_t SubmitUpload(VkQueue queue, VkCommandBuffer commandBuffer);
+
+		uint64_t CompletedValue() const;
+		void Wait(uint64_t value) const;
+
+		// release runs from Collect once the GPU has reached value
+		void Retire(uint64_t value, std::function<void()> release);
+		// Retires against the last value submitted, for resources the GPU may be using right now
+		void Retire(std::function<void()> release);
+		void RetireBuffer(VkBuffer buffer, VkDeviceMemory memory);
+		void RetireImage(VkImage image, VkImageView view, VkDeviceMemory memory);
+		void Collect();
+		// Waits for the GPU to pass every retired resource and releases them, returns false if that frees nothing.
+		// Registered with the device's MemoryTracker so allocations that do not fit stall here before failing
+		bool ReclaimRetired();
+
+		inline VkSemaphore semaphore() const { return m_semaphore; }
+		inline uint64_t lastSubmitted() const { return m_lastSubmitted; }
+		inline size_t pendingCount() const { return m_retired.size(); }
+
+		// Upload command buffers get timestamp scopes while a profiler is attached, GpuProfiler does this itself
+		inline void SetProfiler(GpuProfiler* profiler) { m_profiler = profiler; }
+		inline GpuProfiler* profiler() const { return m_profiler; }
+
+	private:
+		const Device& m_device;
+
+		VkSemaphore m_semaphore;
+		uint64_t m_lastSubmitted = 0;
+		uint64_t m_lastUpload = 0;
+		GpuProfiler* m_profiler = nullptr;
+		uint32_t m_reclaimer;
+
+		std::multimap<uint64_t, std::function<void()>> m_retired;
+
+		uint64_t SubmitSignal(VkQueue queue, VkCommandBuffer commandBuffer, uint32_t waitCount, const VkSemaphore* waitSemaphores, const uint64_t* waitValues, const VkPipelineStageFlags* waitStages, VkSemaphore signalSemaphore);
+};
+
+#endif
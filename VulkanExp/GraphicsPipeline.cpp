@@ -6,19 +6,20 @@
 #include "Device.h"
 #include "DescriptorSets.h"
 #include "RenderPass.h"
-#include "SwapChain.h"
+#include "RenderTarget.h"
 #include "Vertex.h"
 
 
-GraphicsPipeline::GraphicsPipeline(const Device& device, const SwapChain& swapChain, const RenderPass& renderPass, DescriptorSets& descriptorSets)
+GraphicsPipeline::GraphicsPipeline(const Device& device, const RenderTarget& target, const RenderPass& renderPass, DescriptorSets& descriptorSets, VkDescriptorSetLayout bindlessLayout)
 	: m_pipeline(VK_NULL_HANDLE),
 	m_layout(VK_NULL_HANDLE),
 	m_oldLayout(VK_NULL_HANDLE),
 
 	m_device(device),
-	m_swapChain(swapChain),
+	m_target(target),
 	m_renderPass(renderPass),
-	m_descriptorSets(descriptorSets) {
+	m_descriptorSets(descriptorSets),
+	m_bindlessLayout(bindlessLayout) {
 	createPipeline();
 }
 
@@ -34,8 +35,9 @@ void GraphicsPipeline::recreate() {
 }
 
 void GraphicsPipeline::createPipeline() {
-	auto vertShaderCode = ReadFile("../shaders/vert.spv");
-	auto fragShaderCode = ReadFile("../shaders/frag.spv");
+	bool bindless = m_bindlessLayout != VK_NULL_HANDLE;
+	auto vertShaderCode = ReadFile(bindless ? "../shaders/bindless_vert.spv" : "../shaders/vert.spv");
+	auto fragShaderCode = ReadFile(bindless ? "../shaders/bindless_frag.spv" : "../shaders/frag.spv");
 
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -126,9 +128,16 @@ void GraphicsPipeline::createPipeline() {
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	const VkDescriptorSetLayout layout = m_descriptorSets.GetLayout();
-	pipelineLayoutInfo.pSetLayouts = &layout;
+	const VkDescriptorSetLayout layouts[] = { m_descriptorSets.GetLayout(), m_bindlessLayout };
+	pipelineLayoutInfo.setLayoutCount = bindless ? 2 : 1;
+	pipelineLayoutInfo.pSetLayouts = layouts;
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 
 	if (vkCreatePipelineLayout(m_device.logical(), &pipelineLayoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
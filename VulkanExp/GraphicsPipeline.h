@@ -3,16 +3,24 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <glm/glm.hpp>
 
 class Device;
 class DescriptorSets;
-class SwapChain;
+class RenderTarget;
 class RenderPass;
 struct ShaderDetails;
 
+// Pushed before every draw, the model-view-projection product is done once per draw on the CPU instead of per vertex.
+// 64 bytes, well inside the 128 bytes of push constants every device supports.
+struct DrawConstants {
+	glm::mat4 mvp;
+};
+
 class GraphicsPipeline {
 public:
-	GraphicsPipeline(const Device& device, const SwapChain& swapChain, const RenderPass& renderPass, DescriptorSets& descriptorSets);
+	// With a bindless layout the pipeline uses the bindless shaders and takes that layout as set 1
+	GraphicsPipeline(const Device& device, const RenderTarget& target, const RenderPass& renderPass, DescriptorSets& descriptorSets, VkDescriptorSetLayout bindlessLayout = VK_NULL_HANDLE);
 	~GraphicsPipeline();
 
 	void recreate();
@@ -28,9 +36,10 @@ private:
 	VkPipelineLayout m_oldLayout;
 
 	const Device& m_device;
-	const SwapChain& m_swapChain;
+	const RenderTarget& m_target;
 	const RenderPass& m_renderPass;
 	DescriptorSets& m_descriptorSets;
+	VkDescriptorSetLayout m_bindlessLayout;
 
 	void createPipeline();
 	VkShaderModule createShaderModule(const std::vector<char>& code);
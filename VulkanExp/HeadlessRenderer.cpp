@@ -0,0 +1,195 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "HeadlessRenderer.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CpuProfiler.h"
+
+namespace {
+	// Unreferenced textures stay resident up to this much device memory
+	const VkDeviceSize TextureCacheBudget = 64ull * 1024 * 1024;
+	const VkDeviceSize UniformRingFrameSize = 64 * 1024;
+	// Sets per pool in each slot's descriptor allocator, a frame allocates one
+	const uint32_t SlotDescriptorSets = 4;
+}
+
+HeadlessRenderer::HeadlessRenderer(uint32_t width, uint32_t height, uint32_t framesInFlight, bool validationLayers)
+	: m_slots(framesInFlight) {
+	m_instance.reset(new Instance("OBJ Viewer", "No Engine", validationLayers, true));
+	if (validationLayers) {
+		m_debugMessenger.reset(new DebugMessenger(*m_instance));
+	}
+	m_device.reset(new Device(*m_instance, {}));
+	m_timeline.reset(new GpuTimeline(*m_device));
+	m_gpuProfiler.reset(new GpuProfiler(*m_device, *m_timeline, framesInFlight));
+	m_commandPool.reset(new CommandPool(*m_device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT));
+	m_samplerCache.reset(new SamplerCache(*m_device));
+	m_textureCache.reset(new TextureCache(*m_device, *m_commandPool, *m_samplerCache, *m_timeline, TextureCacheBudget));
+	m_descriptorLayouts.reset(new DescriptorLayoutCache(*m_device));
+	m_descriptorAllocator.reset(new DescriptorAllocator(*m_device));
+	for (Slot& slot : m_slots) {
+		slot.descriptorAllocator.reset(new DescriptorAllocator(*m_device, SlotDescriptorSets));
+	}
+	m_uniformRing.reset(new UniformRing(*m_device, framesInFlight, UniformRingFrameSize));
+	// One image per slot, so a finished frame can be read back while the other slots render
+	m_target.reset(new OffscreenTarget(*m_device, width, height, framesInFlight));
+	m_renderPass.reset(new RenderPass(*m_device, *m_target));
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+	WaitIdle();
+}
+
+void HeadlessRenderer::WaitIdle()
+{
+	m_timeline->Wait(m_timeline->lastSubmitted());
+	m_gpuProfiler->Collect();
+	m_timeline->Collect();
+}
+
+std::unique_ptr<Model> HeadlessRenderer::CreateModel()
+{
+	return std::unique_ptr<Model>(new Model(*m_device, *m_commandPool, *m_timeline));
+}
+
+void HeadlessRenderer::LoadModelFile(Model& model, const std::string& path)
+{
+	bool package = path.size() >= 6 && path.compare(path.size() - 6, 6, ".vkpkg") == 0;
+	if (package) {
+		model.LoadPackage(path);
+	}
+	else {
+		model.LoadModel(path);
+	}
+}
+
+void HeadlessRenderer::SetScene(uint32_t slot, std::shared_ptr<Model> model, const std::string& texturePath)
+{
+	CpuZone zone("set scene");
+	// The slot's last frame may still be drawing the old scene
+	WaitSlot(slot);
+	Slot& target = m_slots[slot];
+
+	// A model shared between slots is uploaded once
+	if (model->GetVertextBuffer() == VK_NULL_HANDLE) {
+		model->CreateVertexBuffer();
+		model->CreateIndexBuffer();
+	}
+	target.model = model;
+
+	if (model->GetPackage() && model->GetPackage()->FindSection(PackageSection::TextureLevel)) {
+		target.texture = m_textureCache->Acquire(*model->GetPackage());
+	}
+	else {
+		target.texture = m_textureCache->Acquire(texturePath);
+	}
+
+	// The texture reaches the set in RenderSlot
+	if (!target.descriptorSets) {
+		target.descriptorSets.reset(new DescriptorSets(*m_device, *m_descriptorAllocator, *m_descriptorLayouts, m_uniformRing->buffer(), *target.texture, m_samplerCache->GetDefault()));
+	}
+
+	// Every slot's set comes from the same cached layout, so the pipeline built for the first one serves them all
+	if (!m_pipeline) {
+		m_pipeline.reset(new GraphicsPipeline(*m_device, *m_target, *m_renderPass, *target.descriptorSets));
+		m_commandBuffers.reset(new CommandBuffers(*m_device, *m_renderPass, *m_target, *m_pipeline, *m_commandPool, slotCount()));
+		m_commandBuffers->SetProfiler(m_gpuProfiler.get());
+	}
+}
+
+void HeadlessRenderer::LoadScene(const std::string& modelPath, const std::string& texturePath)
+{
+	std::shared_ptr<Model> model = CreateModel();
+	LoadModelFile(*model, modelPath);
+	for (uint32_t slot = 0; slot < slotCount(); ++slot) {
+		SetScene(slot, model, texturePath);
+	}
+}
+
+void HeadlessRenderer::RenderSlot(uint32_t slot, float seconds)
+{
+	// Same camera and rotation as the viewer
+	glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 model = glm::rotate(glm::mat4(1.0f), seconds * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	RenderSlot(slot, view, model);
+}
+
+void HeadlessRenderer::RenderSlot(uint32_t slot, const glm::mat4& view, const glm::mat4& model)
+{
+	CpuZone zone("render slot");
+	Slot& target = m_slots[slot];
+	if (!target.model) {
+		throw std::runtime_error("no scene loaded!");
+	}
+
+	WaitSlot(slot);
+	m_gpuProfiler->Collect();
+	m_timeline->Collect();
+
+	const VkExtent2D& size = m_target->extent();
+	UniformBufferObject ubo{};
+	ubo.view = view;
+	ubo.proj = glm::perspective(glm::radians(45.0f), size.width / (float)size.height, 0.1f, 10.0f);
+	ubo.proj[1][1] *= -1;
+	ubo.viewProj = ubo.proj * ubo.view;
+
+	DrawConstants drawConstants;
+	drawConstants.mvp = ubo.viewProj * model;
+
+	// Uniform ring regions, descriptor allocators and command buffers are per slot, like per frame in flight in the viewer
+	m_uniformRing->BeginFrame(slot);
+	target.descriptorAllocator->Reset();
+	target.descriptorSets->BeginFrame(*target.descriptorAllocator, *target.texture);
+	uint32_t uniformOffset = m_uniformRing->Push(ubo);
+
+	m_commandBuffers->ResetCommandBuffer(slot);
+	m_commandBuffers->RecordCommandBuffer(slot, slot, target.model->GetVertextBuffer(), target.model->GetIndexBuffer(), target.model->GetIndexCount(), target.model->GetIndexType(), *target.descriptorSets, uniformOffset, drawConstants);
+	target.value = m_timeline->Submit(m_device->graphicsQueue(), m_commandBuffers->command(slot), VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+	m_gpuProfiler->Submitted(slot, target.value);
+}
+
+uint32_t HeadlessRenderer::RenderFrame(float seconds)
+{
+	uint32_t slot = m_frame % slotCount();
+	RenderSlot(slot, seconds);
+	++m_frame;
+	return slot;
+}
+
+bool HeadlessRenderer::IsSlotDone(uint32_t slot) const
+{
+	return m_timeline->CompletedValue() >= m_slots[slot].value;
+}
+
+void HeadlessRenderer::WaitSlot(uint32_t slot)
+{
+	m_timeline->Wait(m_slots[slot].value);
+}
+
+void HeadlessRenderer::WriteFrame(uint32_t slot, const std::string& path)
+{
+	WaitSlot(slot);
+	const VkExtent2D& size = m_target->extent();
+	OffscreenTarget::WriteImage(path, size.width, size.height, m_target->ReadbackData(slot));
+}
+
+VkDeviceSize HeadlessRenderer::sceneMemorySize() const
+{
+	VkDeviceSize size = m_textureCache->stats().residentBytes;
+	for (uint32_t i = 0; i < slotCount(); ++i) {
+		// LoadScene shares one model between the slots
+		bool counted = false;
+		for (uint32_t j = 0; j < i; ++j) {
+			counted |= m_slots[j].model == m_slots[i].model;
+		}
+		if (m_slots[i].model && !counted) {
+			size += m_slots[i].model->memorySize();
+		}
+	}
+	return size;
+}
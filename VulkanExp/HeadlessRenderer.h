@@ -0,0 +1,109 @@
+#ifndef HEADLESSRENDERER_H
+#define HEADLESSRENDERER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Instance.h"
+#include "DebugMessenger.h"
+#include "Device.h"
+#include "GpuTimeline.h"
+#include "GpuProfiler.h"
+#include "CommandPool.h"
+#include "SamplerCache.h"
+#include "TextureCache.h"
+#include "DescriptorLayoutCache.h"
+#include "DescriptorAllocator.h"
+#include "UniformRing.h"
+#include "OffscreenTarget.h"
+#include "RenderPass.h"
+#include "Model.h"
+#include "DescriptorSets.h"
+#include "GraphicsPipeline.h"
+#include "CommandBuffers.h"
+
+// Renders the viewer's scene without a window or swap chain: offscreen color and depth images, every frame copied
+// into a host visible buffer. Needs nothing but a Vulkan 1.2 driver with a graphics queue, so it runs on render
+// nodes without a display and on software drivers such as lavapipe.
+class HeadlessRenderer {
+	public:
+		// Renders into framesInFlight offscreen images, each one a slot that can hold its own scene
+		HeadlessRenderer(uint32_t width, uint32_t height, uint32_t framesInFlight, bool validationLayers);
+		// Waits for the GPU before anything is destroyed
+		~HeadlessRenderer();
+
+		HeadlessRenderer(const HeadlessRenderer&) = delete;
+		HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+		// Parsing touches no Vulkan objects, so models can be created and loaded on any thread
+		std::unique_ptr<Model> CreateModel();
+		// Cooked packages for .vkpkg paths, OBJ files for everything else
+		static void LoadModelFile(Model& model, const std::string& path);
+
+		// Uploads the model and its texture for slot without waiting for the copies, the slot's next frame does.
+		// A cooked package brings its own texture, an OBJ uses texturePath
+		void SetScene(uint32_t slot, std::shared_ptr<Model> model, const std::string& texturePath);
+		// The same scene in every slot
+		void LoadScene(const std::string& modelPath, const std::string& texturePath);
+
+		// Submits one frame of the slot's scene with the model rotated as far as the viewer has it after seconds
+		void RenderSlot(uint32_t slot, float seconds);
+		// Same with an explicit camera and model transform, for camera paths that don't depend on time
+		void RenderSlot(uint32_t slot, const glm::mat4& view, const glm::mat4& model);
+		// RenderSlot on the next slot in turn, returns the slot
+		uint32_t RenderFrame(float seconds);
+
+		// True once the slot's last frame has finished on the GPU
+		bool IsSlotDone(uint32_t slot) const;
+		void WaitSlot(uint32_t slot);
+		// Waits for every frame and upload submitted so far
+		void WaitIdle();
+		// Tightly packed RGBA8 rows of the slot's last frame, call WaitSlot first
+		inline const uint8_t* ReadbackData(uint32_t slot) const { return m_target->ReadbackData(slot); }
+		// Waits for the slot's last frame and writes it, see OffscreenTarget::WriteImage
+		void WriteFrame(uint32_t slot, const std::string& path);
+
+		inline const Device& device() const { return *m_device; }
+		inline const VkExtent2D& extent() const { return m_target->extent(); }
+		inline uint32_t slotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+		// Frame, render pass, draw and upload scopes of every frame rendered so far
+		inline GpuProfiler& gpuProfiler() { return *m_gpuProfiler; }
+		// Vertex, index and texture memory of the scenes in the slots, textures kept by the cache included
+		VkDeviceSize sceneMemorySize() const;
+
+	private:
+		struct Slot {
+			std::shared_ptr<Model> model;
+			std::shared_ptr<Texture> texture;
+			// Created with the first scene, every frame allocates its set from the slot's descriptor allocator
+			std::unique_ptr<DescriptorSets> descriptorSets;
+			std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+			uint64_t value = 0;
+		};
+
+		uint32_t m_frame = 0;
+
+		// Declared in creation order, destroyed in reverse
+		std::unique_ptr<Instance> m_instance;
+		std::unique_ptr<DebugMessenger> m_debugMessenger;
+		std::unique_ptr<Device> m_device;
+		std::unique_ptr<GpuTimeline> m_timeline;
+		std::unique_ptr<GpuProfiler> m_gpuProfiler;
+		std::unique_ptr<CommandPool> m_commandPool;
+		std::unique_ptr<SamplerCache> m_samplerCache;
+		std::unique_ptr<TextureCache> m_textureCache;
+		std::unique_ptr<DescriptorLayoutCache> m_descriptorLayouts;
+		std::unique_ptr<DescriptorAllocator> m_descriptorAllocator;
+		std::unique_ptr<UniformRing> m_uniformRing;
+		std::unique_ptr<OffscreenTarget> m_target;
+		std::unique_ptr<RenderPass> m_renderPass;
+
+		std::vector<Slot> m_slots;
+		std::unique_ptr<GraphicsPipeline> m_pipeline;
+		std::unique_ptr<CommandBuffers> m_commandBuffers;
+};
+
+#endif
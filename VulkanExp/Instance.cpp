@@ -7,7 +7,7 @@ const std::vector<const char*> Instance::ValidationLayers = { "VK_LAYER_KHRONOS_
 const std::vector<const char*> Instance::DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
 
-Instance::Instance(const char * applicationName, const char * engineName, bool validationLayers)
+Instance::Instance(const char * applicationName, const char * engineName, bool validationLayers, bool headless)
 {
 	m_enableValidationLayers = validationLayers;
 	m_instance = VK_NULL_HANDLE;
@@ -22,7 +22,8 @@ Instance::Instance(const char * applicationName, const char * engineName, bool v
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = engineName;
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 so optional device features can be queried and enabled through the core *2 entry points
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -32,7 +33,7 @@ Instance::Instance(const char * applicationName, const char * engineName, bool v
 	PrintAvailableExtensions();
 
 	std::vector<const char*> extensions;
-	GetRequiredExtensions(extensions, validationLayers);
+	GetRequiredExtensions(extensions, validationLayers, headless);
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -91,9 +92,11 @@ bool Instance::CheckValidationLayerSupport()
 	return true;
 }
 
-void Instance::GetRequiredExtensions(std::vector<const char*>& extensions, bool validationLayers)
+void Instance::GetRequiredExtensions(std::vector<const char*>& extensions, bool validationLayers, bool headless)
 {
-	Window::GetRequiredExtensions(extensions);
+	if (!headless) {
+		Window::GetRequiredExtensions(extensions);
+	}
 
 	if (validationLayers) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
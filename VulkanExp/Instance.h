@@ -9,7 +9,8 @@
 
 class Instance {
 	public:
-		Instance(const char* applicationName, const char* engineName, bool validationLayers);
+		// Headless instances skip the GLFW surface extensions, glfwInit doesn't need to have been called
+		Instance(const char* applicationName, const char* engineName, bool validationLayers, bool headless = false);
 		Instance() = delete;
 		~Instance();
 
@@ -38,7 +39,7 @@ class Instance {
 		bool m_enableValidationLayers;
 
 		static bool CheckValidationLayerSupport();
-		static void GetRequiredExtensions(std::vector<const char*>& extensions, bool validationLayers);
+		static void GetRequiredExtensions(std::vector<const char*>& extensions, bool validationLayers, bool headless);
 		void PrintAvailableExtensions();
 		void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 };
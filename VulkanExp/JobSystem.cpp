@@ -0,0 +1,232 @@
+#include "JobSystem.h"
+
+#include <chrono>
+#include <string>
+
+#include "CpuProfiler.h"
+
+namespace {
+	// Scheduler and deque of the calling thread if it is a worker
+	thread_local JobSystem* t_system = nullptr;
+	thread_local uint32_t t_worker = 0;
+
+	// How long a thread waiting on a counter sleeps before looking for new jobs again
+	const std::chrono::microseconds IdleWaitInterval(200);
+}
+
+uint32_t JobSystem::s_threadCount = 0;
+
+JobSystem& JobSystem::Instance()
+{
+	static JobSystem system(s_threadCount > 0 ? s_threadCount - 1 : std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return system;
+}
+
+bool JobSystem::ParseArgument(int argc, char* argv[], int& index)
+{
+	std::string arg = argv[index];
+	if (arg == "--jobs" && index + 1 < argc) {
+		s_threadCount = static_cast<uint32_t>(std::stoul(argv[++index]));
+		return true;
+	}
+	return false;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+	workerCount = std::max(1u, workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	// Started once every deque exists, workers steal from each other right away
+	for (uint32_t i = 0; i < workerCount; i++) {
+		m_workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker->thread.join();
+	}
+}
+
+void JobSystem::Run(Job job, JobCounter* counter, JobCounter* after)
+{
+	if (counter) {
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Task task;
+	task.job = std::move(job);
+	task.counter = counter;
+	if (after) {
+		std::lock_guard<std::mutex> lock(after->m_mutex);
+		if (after->m_pending.load(std::memory_order_acquire) != 0) {
+			after->m_continuations.push_back({ std::move(task.job), task.counter });
+			return;
+		}
+	}
+	Push(std::move(task));
+}
+
+void JobSystem::Add(JobCounter& counter, uint32_t count)
+{
+	counter.m_pending.fetch_add(count, std::memory_order_relaxed);
+}
+
+void JobSystem::Done(JobCounter& counter)
+{
+	Finish(&counter);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.done()) {
+		if (TryRunOne()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(counter.m_mutex);
+		counter.m_done.wait_for(lock, IdleWaitInterval, [&counter] { return counter.done(); });
+	}
+	// The job that finished the counter may still be inside its critical section
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::Push(Task task)
+{
+	if (t_system == this) {
+		Worker& worker = *m_workers[t_worker];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_shared.push_back(std::move(task));
+	}
+
+	m_queued.fetch_add(1, std::memory_order_release);
+	// Taking the lock orders the increment before a worker's check, so a worker about to sleep cannot miss it
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+bool JobSystem::Take(Task& task)
+{
+	if (m_queued.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+
+	uint32_t self = t_system == this ? t_worker : 0;
+	if (t_system == this) {
+		Worker& worker = *m_workers[self];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		if (!m_shared.empty()) {
+			// Outside threads use the shared queue as their own deque, newest first, so one waiting on nested jobs
+			// finishes its own before starting older, larger ones. Workers take the oldest like any steal
+			if (t_system == this) {
+				task = std::move(m_shared.front());
+				m_shared.pop_front();
+			}
+			else {
+				task = std::move(m_shared.back());
+				m_shared.pop_back();
+			}
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	uint32_t count = workerCount();
+	for (uint32_t i = 1; i <= count; i++) {
+		uint32_t victim = (self + i) % count;
+		if (t_system == this && victim == self) {
+			continue;
+		}
+		Worker& worker = *m_workers[victim];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			m_steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::TryRunOne()
+{
+	Task task;
+	if (!Take(task)) {
+		return false;
+	}
+	task.job();
+	m_jobsRun.fetch_add(1, std::memory_order_relaxed);
+	Finish(task.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter) {
+		return;
+	}
+
+	std::vector<JobCounter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		ready.swap(counter->m_continuations);
+		counter->m_done.notify_all();
+	}
+
+	// The counter may be gone from here on
+	for (JobCounter::Continuation& continuation : ready) {
+		Task task;
+		task.job = std::move(continuation.job);
+		task.counter = continuation.counter;
+		Push(std::move(task));
+	}
+}
+
+void JobSystem::WorkerLoop(uint32_t index)
+{
+	t_system = this;
+	t_worker = index;
+	if (CpuProfiler::enabled()) {
+		CpuProfiler::SetThreadName("job worker " + std::to_string(index));
+	}
+
+	for (;;) {
+		if (TryRunOne()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if (m_stopping && m_queued.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+		m_wake.wait(lock, [this] { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+	}
+}
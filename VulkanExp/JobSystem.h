@@ -0,0 +1,166 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Jobs, or other work such as a file read, that something waits on or that other jobs depend on. Counters must
+// outlive their jobs and must not be destroyed while a thread waits on them
+class JobCounter {
+	public:
+		JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		inline bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		struct Continuation {
+			std::function<void()> job;
+			JobCounter* counter;
+		};
+
+		std::atomic<uint32_t> m_pending{ 0 };
+		// Guards the continuations and the last decrement, so a waiter cannot destroy the counter under a finishing job
+		std::mutex m_mutex;
+		std::condition_variable m_done;
+		// Jobs run once the counter reaches zero
+		std::vector<Continuation> m_continuations;
+};
+
+// Work stealing scheduler. Every worker owns a deque: jobs it runs push to the back and it pops from the back, so
+// recursive work stays hot in its cache, while idle workers steal the oldest job from the front of another's.
+// Jobs from other threads go through a shared queue. Threads waiting on a counter run jobs in the meantime, so
+// jobs can wait on the jobs they start without tying up a worker. Jobs must not throw, ParallelFor passes
+// exceptions on to its caller.
+class JobSystem {
+	public:
+		using Job = std::function<void()>;
+
+		// ParallelFor cuts the range into this many pieces per thread, enough for stealing to even out the load
+		static const uint32_t RangesPerThread = 4;
+
+		// Shared scheduler with the worker count from --jobs, or one less than the hardware threads so the thread
+		// that waits has a core as well. Created on first use
+		static JobSystem& Instance();
+		// Consumes argv[index] if it is a job system option (--jobs N, the total threads including the waiting one),
+		// leaving index on the last argument used. Returns false for anything else. Only works before Instance
+		static bool ParseArgument(int argc, char* argv[], int& index);
+
+		// At least one worker is started, so jobs progress even if nobody waits on them
+		explicit JobSystem(uint32_t workerCount);
+		// Runs whatever is still queued, then stops the workers
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// counter, if any, counts the job until it has run. The job is held back until after, if any, reaches zero
+		void Run(Job job, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+		// Counts work outside the job system, each Add is matched by a Done from whichever thread finishes it
+		void Add(JobCounter& counter, uint32_t count = 1);
+		void Done(JobCounter& counter);
+		// Runs jobs on the calling thread until the counter reaches zero
+		void Wait(JobCounter& counter);
+
+		// Calls func(begin, end) over [0, count) in pieces of at least grain elements, the caller running one of them,
+		// and returns once all have. Rethrows the first exception a piece threw
+		template<typename Func>
+		void ParallelFor(size_t count, size_t grain, Func&& func);
+
+		inline uint32_t workerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+		// Jobs a worker took from another worker's deque
+		inline uint64_t steals() const { return m_steals.load(std::memory_order_relaxed); }
+		inline uint64_t jobsRun() const { return m_jobsRun.load(std::memory_order_relaxed); }
+
+	private:
+		struct Task {
+			Job job;
+			JobCounter* counter = nullptr;
+		};
+
+		struct Worker {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+			std::thread thread;
+		};
+
+		static uint32_t s_threadCount;
+
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::mutex m_sharedMutex;
+		std::deque<Task> m_shared;
+
+		// Tasks in any queue, workers sleep while it is zero
+		std::atomic<size_t> m_queued{ 0 };
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+		bool m_stopping = false;
+
+		std::atomic<uint64_t> m_steals{ 0 };
+		std::atomic<uint64_t> m_jobsRun{ 0 };
+
+		void WorkerLoop(uint32_t index);
+		void Push(Task task);
+		// Takes a task for the calling thread: its own deque first, then the shared queue, then other workers
+		bool Take(Task& task);
+		bool TryRunOne();
+		void Finish(JobCounter* counter);
+};
+
+template<typename Func>
+void JobSystem::ParallelFor(size_t count, size_t grain, Func&& func)
+{
+	if (count == 0) {
+		return;
+	}
+
+	size_t maxRanges = (static_cast<size_t>(workerCount()) + 1) * RangesPerThread;
+	size_t rangeCount = std::min((count + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1), maxRanges);
+	if (rangeCount <= 1) {
+		func(size_t(0), count);
+		return;
+	}
+
+	size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	auto runRange = [&](size_t begin) {
+		try {
+			func(begin, std::min(count, begin + rangeSize));
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	};
+
+	JobCounter counter;
+	for (size_t begin = rangeSize; begin < count; begin += rangeSize) {
+		Run([&runRange, begin]() { runRange(begin); }, &counter);
+	}
+	runRange(0);
+	Wait(counter);
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+{
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		throw std::runtime_error("failed to open file " + path);
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize)) {
+		CloseHandle(m_file);
+		throw std::runtime_error("failed to query size of " + path);
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_size == 0) {
+		return;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping) {
+		CloseHandle(m_file);
+		throw std::runtime_error("failed to map file " + path);
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::runtime_error("failed to map file " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file) {
+		CloseHandle(m_file);
+	}
+}
+
+void MappedFile::ReadAt(uint64_t offset, size_t size, void* destination) const
+{
+	if (offset + size > m_size) {
+		throw std::runtime_error("read past the end of a mapped file!");
+	}
+
+	uint8_t* out = static_cast<uint8_t*>(destination);
+	while (size > 0) {
+		// ReadFile counts in DWORDs. The OVERLAPPED offset picks where every read starts; on a synchronous handle
+		// ReadFile still moves the file pointer past the data, which nothing here reads from
+		DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD read = 0;
+		if (!ReadFile(m_file, out, chunk, &read, &overlapped) || read == 0) {
+			throw std::runtime_error("failed to read mapped file!");
+		}
+		out += read;
+		offset += read;
+		size -= read;
+	}
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+{
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd < 0) {
+		throw std::runtime_error("failed to open file " + path);
+	}
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0) {
+		close(m_fd);
+		throw std::runtime_error("failed to query size of " + path);
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size == 0) {
+		return;
+	}
+
+	void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (mapping == MAP_FAILED) {
+		close(m_fd);
+		throw std::runtime_error("failed to map file " + path);
+	}
+	m_data = static_cast<const uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+void MappedFile::ReadAt(uint64_t offset, size_t size, void* destination) const
+{
+	if (offset + size > m_size) {
+		throw std::runtime_error("read past the end of a mapped file!");
+	}
+
+	uint8_t* out = static_cast<uint8_t*>(destination);
+	while (size > 0) {
+		ssize_t read = pread(m_fd, out, size, static_cast<off_t>(offset));
+		if (read < 0 && errno == EINTR) {
+			continue;
+		}
+		if (read <= 0) {
+			throw std::runtime_error("failed to read mapped file!");
+		}
+		out += read;
+		offset += static_cast<uint64_t>(read);
+		size -= static_cast<size_t>(read);
+	}
+}
+#endif
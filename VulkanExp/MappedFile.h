@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file, pages are faulted in by the OS as they are touched. Bulk data that only
+// passes through on its way somewhere else is better off with ReadAt, which never touches the mapping
+class MappedFile {
+	public:
+		MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		inline const uint8_t* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+
+		// Positional read of size bytes into destination, without faulting in the pages of the mapping, so data
+		// lands in mapped device memory with one copy by the kernel instead of a page fault and a memcpy
+		void ReadAt(uint64_t offset, size_t size, void* destination) const;
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+};
+
+#endif
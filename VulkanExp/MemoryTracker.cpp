@@ -0,0 +1,251 @@
+#include "MemoryTracker.h"
+
+#include "Device.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	const double MB = 1024.0 * 1024.0;
+}
+
+VkDeviceSize MemoryTracker::s_defaultBudget = 0;
+bool MemoryTracker::s_reporting = false;
+bool MemoryTracker::s_stagedUploads = false;
+
+MemoryTracker::MemoryTracker(const Device& device, bool memoryBudget)
+	: m_device(device), m_memoryBudget(memoryBudget), m_budget(s_defaultBudget)
+{
+	vkGetPhysicalDeviceMemoryProperties(device.physical(), &m_properties);
+	m_heapBytes.resize(m_properties.memoryHeapCount, 0);
+	m_heapPeak.resize(m_properties.memoryHeapCount, 0);
+
+	const VkMemoryPropertyFlags direct = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < m_properties.memoryTypeCount && !s_stagedUploads; i++) {
+		const VkMemoryType& type = m_properties.memoryTypes[i];
+		if ((type.propertyFlags & direct) == direct && m_properties.memoryHeaps[type.heapIndex].size > BarWindowSize) {
+			m_directUploads = true;
+		}
+	}
+}
+
+MemoryTracker::~MemoryTracker()
+{
+	// Whatever is left leaks with the device, freeing it here could race an owner that is still alive
+	if (!m_allocations.empty()) {
+		std::cerr << m_allocations.size() << " device memory allocations still alive at device destruction" << std::endl;
+	}
+}
+
+bool MemoryTracker::ParseArgument(int argc, char* argv[], int& index)
+{
+	std::string arg = argv[index];
+	if (arg == "--memory-budget" && index + 1 < argc) {
+		s_defaultBudget = static_cast<VkDeviceSize>(std::stod(argv[++index]) * MB);
+		return true;
+	}
+	if (arg == "--memory-report") {
+		s_reporting = true;
+		return true;
+	}
+	if (arg == "--staged-uploads") {
+		s_stagedUploads = true;
+		return true;
+	}
+	return false;
+}
+
+VkDeviceMemory MemoryTracker::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category)
+{
+	uint32_t type = FindMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t heap = m_properties.memoryTypes[type].heapIndex;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = type;
+
+	for (;;) {
+		if (Fits(heap, requirements.size)) {
+			VkDeviceMemory memory;
+			VkResult result = vkAllocateMemory(m_device.logical(), &allocInfo, nullptr, &memory);
+			if (result == VK_SUCCESS) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_allocations.emplace(memory, Allocation{ requirements.size, heap, category });
+				m_heapBytes[heap] += requirements.size;
+				m_heapPeak[heap] = std::max(m_heapPeak[heap], m_heapBytes[heap]);
+				m_categoryBytes[static_cast<size_t>(category)] += requirements.size;
+				return memory;
+			}
+			// The driver ran out before our limit, that is still worth reclaiming for
+			if (result != VK_ERROR_OUT_OF_DEVICE_MEMORY && result != VK_ERROR_OUT_OF_HOST_MEMORY) {
+				throw std::runtime_error(std::string("failed to allocate ") + CategoryName(category) + " memory!");
+			}
+		}
+
+		if (!Reclaim()) {
+			MemoryHeapUsage usage = heaps()[heap];
+			std::ostringstream message;
+			message << std::fixed << std::setprecision(1) << "out of " << CategoryName(category) << " memory: "
+				<< requirements.size / MB << " MB does not fit in heap " << heap << " ("
+				<< std::max(usage.tracked, usage.driverUsage) / MB << " of " << usage.limit / MB << " MB used)!";
+			throw std::runtime_error(message.str());
+		}
+	}
+}
+
+void MemoryTracker::Free(VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto allocation = m_allocations.find(memory);
+		if (allocation != m_allocations.end()) {
+			m_heapBytes[allocation->second.heap] -= allocation->second.size;
+			m_categoryBytes[static_cast<size_t>(allocation->second.category)] -= allocation->second.size;
+			m_allocations.erase(allocation);
+		}
+	}
+	vkFreeMemory(m_device.logical(), memory, nullptr);
+}
+
+uint32_t MemoryTracker::AddReclaimer(std::function<bool()> reclaim)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reclaimers.emplace_back(m_nextReclaimer, std::move(reclaim));
+	return m_nextReclaimer++;
+}
+
+void MemoryTracker::RemoveReclaimer(uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reclaimers.erase(std::remove_if(m_reclaimers.begin(), m_reclaimers.end(),
+		[id](const std::pair<uint32_t, std::function<bool()>>& reclaimer) { return reclaimer.first == id; }), m_reclaimers.end());
+}
+
+std::vector<MemoryHeapUsage> MemoryTracker::heaps() const
+{
+	std::vector<MemoryHeapUsage> heaps(m_properties.memoryHeapCount);
+
+	// The budget moves with what other processes allocate, so it is queried every time
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+	budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	if (m_memoryBudget) {
+		VkPhysicalDeviceMemoryProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties2.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(m_device.physical(), &properties2);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (uint32_t i = 0; i < m_properties.memoryHeapCount; i++) {
+		MemoryHeapUsage& usage = heaps[i];
+		usage.size = m_properties.memoryHeaps[i].size;
+		usage.deviceLocal = (m_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		usage.tracked = m_heapBytes[i];
+		usage.peak = m_heapPeak[i];
+		usage.driverUsage = budget.heapUsage[i];
+		usage.driverBudget = budget.heapBudget[i];
+
+		usage.limit = m_memoryBudget ? budget.heapBudget[i] : usage.size / 100 * FallbackBudgetPercent;
+		if (usage.deviceLocal && m_budget > 0) {
+			usage.limit = std::min(usage.limit, m_budget);
+		}
+	}
+	return heaps;
+}
+
+VkDeviceSize MemoryTracker::categoryBytes(MemoryCategory category) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_categoryBytes[static_cast<size_t>(category)];
+}
+
+void MemoryTracker::Report(std::ostream& out) const
+{
+	std::vector<MemoryHeapUsage> usage = heaps();
+
+	// out is usually std::cout, its number format is put back at the end
+	std::ios format(nullptr);
+	format.copyfmt(out);
+	out << std::fixed << std::setprecision(1);
+	out << "GPU memory (" << (m_memoryBudget ? "VK_EXT_memory_budget" : "no driver budget") << ", "
+		<< (m_directUploads ? "direct" : "staged") << " uploads, " << m_reclaims << " reclaims):" << std::endl;
+	for (size_t i = 0; i < usage.size(); i++) {
+		out << "  heap " << i << (usage[i].deviceLocal ? " device" : " host") << ": "
+			<< usage[i].tracked / MB << " MB now, " << usage[i].peak / MB << " MB peak, limit "
+			<< usage[i].limit / MB << " of " << usage[i].size / MB << " MB";
+		if (m_memoryBudget) {
+			out << ", process " << usage[i].driverUsage / MB << " MB";
+		}
+		out << std::endl;
+	}
+
+	out << " ";
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+		MemoryCategory category = static_cast<MemoryCategory>(i);
+		out << " " << CategoryName(category) << " " << categoryBytes(category) / MB << " MB";
+	}
+	out << std::endl;
+	out.copyfmt(format);
+}
+
+const char* MemoryTracker::CategoryName(MemoryCategory category)
+{
+	switch (category) {
+	case MemoryCategory::Vertex: return "vertex";
+	case MemoryCategory::Index: return "index";
+	case MemoryCategory::Texture: return "texture";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Attachment: return "attachment";
+	case MemoryCategory::Uniform: return "uniform";
+	default: return "other";
+	}
+}
+
+uint32_t MemoryTracker::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_properties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool MemoryTracker::Fits(uint32_t heap, VkDeviceSize size) const
+{
+	MemoryHeapUsage usage = heaps()[heap];
+	// The driver's figure covers the whole process and lags behind, ours only this device
+	VkDeviceSize used = std::max(usage.tracked, usage.driverUsage);
+	return used + size <= usage.limit;
+}
+
+bool MemoryTracker::Reclaim()
+{
+	std::vector<std::function<bool()>> reclaimers;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& reclaimer : m_reclaimers) {
+			reclaimers.push_back(reclaimer.second);
+		}
+	}
+
+	// Reclaimers free memory through Free, so they run without the lock
+	for (auto& reclaim : reclaimers) {
+		if (reclaim()) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_reclaims++;
+			return true;
+		}
+	}
+	return false;
+}
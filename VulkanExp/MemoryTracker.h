@@ -0,0 +1,117 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Device;
+
+enum class MemoryCategory {
+	Vertex,
+	Index,
+	Texture,
+	Staging,
+	Attachment,
+	Uniform,
+	// Indirect draws, material tables, anything that fits nowhere else
+	Other,
+	Count
+};
+
+struct MemoryHeapUsage {
+	VkDeviceSize size = 0;
+	bool deviceLocal = false;
+	// Allocated through the tracker by this device
+	VkDeviceSize tracked = 0;
+	VkDeviceSize peak = 0;
+	// What the driver reports for the whole process, only with VK_EXT_memory_budget
+	VkDeviceSize driverUsage = 0;
+	VkDeviceSize driverBudget = 0;
+	// The most the tracker lets this heap hold
+	VkDeviceSize limit = 0;
+};
+
+// Every vkAllocateMemory and vkFreeMemory of the device goes through here. Allocations are tagged with a category
+// and checked against a per heap limit: the driver's budget when VK_EXT_memory_budget is enabled, a share of the
+// heap otherwise, and the configured budget on device local heaps. An allocation that does not fit runs the
+// reclaimers in order until it does, and throws if none of them can free anything, so running out is reported
+// here rather than as VK_ERROR_OUT_OF_DEVICE_MEMORY somewhere inside the driver.
+class MemoryTracker {
+	public:
+		// Heap share used as the limit when the driver does not report a budget
+		static const uint32_t FallbackBudgetPercent = 80;
+		// Host visible device local heaps this small are the fixed PCIe BAR window, kept for per frame data
+		static const VkDeviceSize BarWindowSize = 256ull * 1024 * 1024;
+
+		MemoryTracker(const Device& device, bool memoryBudget);
+		~MemoryTracker();
+
+		MemoryTracker(const MemoryTracker&) = delete;
+		MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+		// Consumes argv[index] if it is a memory option (--memory-budget MB, --memory-report, --staged-uploads),
+		// leaving index on the last argument used. Returns false for anything else. Applies to trackers created afterwards
+		static bool ParseArgument(int argc, char* argv[], int& index);
+		static inline bool reporting() { return s_reporting; }
+
+		VkDeviceMemory Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category);
+		// Accepts VK_NULL_HANDLE
+		void Free(VkDeviceMemory memory);
+
+		// Called on the allocating thread when an allocation does not fit, returns true if it released anything.
+		// Reclaimers run in the order they were added
+		uint32_t AddReclaimer(std::function<bool()> reclaim);
+		void RemoveReclaimer(uint32_t id);
+
+		// Cap for every device local heap on top of the driver's budget, 0 leaves only the driver's budget
+		inline VkDeviceSize budget() const { return m_budget; }
+		inline void setBudget(VkDeviceSize budget) { m_budget = budget; }
+		inline bool memoryBudgetEnabled() const { return m_memoryBudget; }
+		// True on integrated GPUs and with resizable BAR, where buffers can be written in place instead of through
+		// a staging copy. Off with --staged-uploads
+		inline bool directUploads() const { return m_directUploads; }
+
+		std::vector<MemoryHeapUsage> heaps() const;
+		VkDeviceSize categoryBytes(MemoryCategory category) const;
+		void Report(std::ostream& out) const;
+
+		static const char* CategoryName(MemoryCategory category);
+
+	private:
+		struct Allocation {
+			VkDeviceSize size;
+			uint32_t heap;
+			MemoryCategory category;
+		};
+
+		static VkDeviceSize s_defaultBudget;
+		static bool s_reporting;
+		static bool s_stagedUploads;
+
+		const Device& m_device;
+		bool m_memoryBudget;
+		VkDeviceSize m_budget;
+		VkPhysicalDeviceMemoryProperties m_properties;
+		bool m_directUploads = false;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+		std::vector<VkDeviceSize> m_heapBytes;
+		std::vector<VkDeviceSize> m_heapPeak;
+		VkDeviceSize m_categoryBytes[static_cast<size_t>(MemoryCategory::Count)] = {};
+		uint64_t m_reclaims = 0;
+
+		std::vector<std::pair<uint32_t, std::function<bool()>>> m_reclaimers;
+		uint32_t m_nextReclaimer = 0;
+
+		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		bool Fits(uint32_t heap, VkDeviceSize size) const;
+		bool Reclaim();
+};
+
+#endif
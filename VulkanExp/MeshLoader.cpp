@@ -0,0 +1,441 @@
+#include "MeshLoader.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "CpuProfiler.h"
+
+void MeshLoader::LoadObj(const std::string& path, MeshData& mesh)
+{
+	std::vector<Vertex> corners;
+	ParseObj(path, corners, &mesh.diffuseTexture);
+	Deduplicate(corners, mesh);
+}
+
+void MeshLoader::LoadObj(const std::string& path, const uint8_t* data, size_t size, MeshData& mesh)
+{
+	std::vector<Vertex> corners;
+	ParseObj(path, data, size, corners, &mesh.diffuseTexture);
+	Deduplicate(corners, mesh);
+}
+
+namespace {
+	// Lets tinyobj parse a buffer in place through its istream interface
+	class MemoryStreamBuffer : public std::streambuf {
+		public:
+			MemoryStreamBuffer(const uint8_t* data, size_t size) {
+				char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+				setg(begin, begin, begin + size);
+			}
+	};
+
+	// Material files are looked up next to the OBJ file
+	std::string BaseDirectory(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	}
+
+	void ExpandCorners(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, std::vector<Vertex>& corners, std::string* diffuseTexture)
+	{
+		if (diffuseTexture) {
+			for (const auto& material : materials) {
+				if (!material.diffuse_texname.empty()) {
+					*diffuseTexture = material.diffuse_texname;
+					break;
+				}
+			}
+		}
+
+		size_t cornerCount = 0;
+		for (const auto& shape : shapes) {
+			cornerCount += shape.mesh.indices.size();
+		}
+		corners.clear();
+		corners.reserve(cornerCount);
+
+		for (const auto& shape : shapes) {
+			for (const auto& index : shape.mesh.indices) {
+				Vertex vertex{};
+
+				vertex.pos = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2]
+				};
+
+				if (index.texcoord_index >= 0) {
+					vertex.texCoord = {
+						attrib.texcoords[2 * index.texcoord_index + 0],
+						1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+					};
+				}
+
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+
+				corners.push_back(vertex);
+			}
+		}
+	}
+}
+
+void MeshLoader::ParseObj(const std::string& path, std::vector<Vertex>& corners, std::string* diffuseTexture)
+{
+	CpuZone zone("parse obj");
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	std::string baseDir = BaseDirectory(path);
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), baseDir.empty() ? nullptr : baseDir.c_str())) {
+		throw std::runtime_error(warn + err);
+	}
+
+	ExpandCorners(attrib, shapes, materials, corners, diffuseTexture);
+}
+
+void MeshLoader::ParseObj(const std::string& path, const uint8_t* data, size_t size, std::vector<Vertex>& corners, std::string* diffuseTexture)
+{
+	CpuZone zone("parse obj");
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	MemoryStreamBuffer buffer(data, size);
+	std::istream stream(&buffer);
+	tinyobj::MaterialFileReader materialReader(BaseDirectory(path));
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader)) {
+		throw std::runtime_error(warn + err);
+	}
+
+	ExpandCorners(attrib, shapes, materials, corners, diffuseTexture);
+}
+
+void MeshLoader::Deduplicate(const std::vector<Vertex>& corners, MeshData& mesh)
+{
+	CpuZone zone("deduplicate");
+	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	uniqueVertices.reserve(corners.size() / 4);
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(corners.size());
+
+	for (const Vertex& vertex : corners) {
+		auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(mesh.vertices.size()));
+		if (inserted.second) {
+			mesh.vertices.push_back(vertex);
+		}
+		mesh.indices.push_back(inserted.first->second);
+	}
+}
+
+namespace {
+	const int CacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, uint32_t remainingTriangles) {
+		if (remainingTriangles == 0) {
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				// The last triangle's vertices get a fixed score so the strip does not immediately turn back on itself
+				score = LastTriangleScore;
+			}
+			else {
+				float scaler = 1.0f / (CacheSize - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few remaining triangles so they get finished off
+		score += ValenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -ValenceBoostPower);
+		return score;
+	}
+}
+
+void MeshLoader::OptimizeVertexCache(MeshData& mesh)
+{
+	CpuZone zone("optimize vertex cache");
+	const size_t vertexCount = mesh.vertices.size();
+	const size_t triangleCount = mesh.indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Vertex to triangle adjacency in compressed rows, the active triangles of a vertex are kept at the front of its row
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : mesh.indices) {
+		remaining[index]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int corner = 0; corner < 3; corner++) {
+			uint32_t v = mesh.indices[3 * t + corner];
+			adjacency[fill[v]++] = static_cast<uint32_t>(t);
+		}
+	}
+
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(mesh.indices.size());
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(CacheSize + 3);
+	newCache.reserve(CacheSize + 3);
+
+	size_t scanCursor = 0;
+	int64_t bestTriangle = -1;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (bestTriangle < 0) {
+			// Nothing adjacent to the cache is left, continue with the next unprocessed triangle
+			while (emitted[scanCursor]) {
+				scanCursor++;
+			}
+			bestTriangle = static_cast<int64_t>(scanCursor);
+		}
+
+		const uint32_t* tri = &mesh.indices[3 * bestTriangle];
+		output.insert(output.end(), tri, tri + 3);
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices' active lists
+		for (int corner = 0; corner < 3; corner++) {
+			uint32_t v = tri[corner];
+			uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+			uint32_t* end = begin + remaining[v];
+			uint32_t* found = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+			if (found != end) {
+				std::swap(*found, *(end - 1));
+				remaining[v]--;
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache
+		newCache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				newCache.push_back(v);
+			}
+		}
+		for (size_t i = CacheSize; i < newCache.size(); i++) {
+			vertexScore[newCache[i]] = VertexScore(-1, remaining[newCache[i]]);
+		}
+		if (newCache.size() > static_cast<size_t>(CacheSize)) {
+			newCache.resize(CacheSize);
+		}
+		cache.swap(newCache);
+
+		for (size_t i = 0; i < cache.size(); i++) {
+			vertexScore[cache[i]] = VertexScore(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		// Rescore the triangles touching the cache and pick the best one
+		float bestScore = -1.0f;
+		bestTriangle = -1;
+		for (uint32_t v : cache) {
+			for (uint32_t i = 0; i < remaining[v]; i++) {
+				uint32_t t = adjacency[adjacencyOffsets[v] + i];
+				const uint32_t* candidate = &mesh.indices[3 * t];
+				float score = vertexScore[candidate[0]] + vertexScore[candidate[1]] + vertexScore[candidate[2]];
+				if (score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	mesh.indices.swap(output);
+}
+
+void MeshLoader::OptimizeVertexFetch(MeshData& mesh)
+{
+	CpuZone zone("optimize vertex fetch");
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// Vertices no triangle refers to are dropped
+	mesh.vertices.swap(vertices);
+}
+
+void MeshLoader::Partition(const MeshData& mesh, uint32_t maxTriangles, std::vector<MeshData>& chunks)
+{
+	CpuZone zone("partition mesh");
+	maxTriangles = std::max(1u, std::min(maxTriangles, MaxChunkTriangles));
+
+	size_t triangleCount = mesh.indices.size() / 3;
+	std::vector<glm::vec3> centroids(triangleCount);
+	std::vector<uint32_t> triangles(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++) {
+		centroids[i] = (mesh.vertices[mesh.indices[i * 3]].pos + mesh.vertices[mesh.indices[i * 3 + 1]].pos + mesh.vertices[mesh.indices[i * 3 + 2]].pos) / 3.0f;
+		triangles[i] = static_cast<uint32_t>(i);
+	}
+
+	// Chunk local index of every source vertex, reset after each chunk
+	std::vector<uint32_t> localIndex(mesh.vertices.size(), UINT32_MAX);
+	std::vector<uint32_t> used;
+
+	// Depth first with the lower half on top, so consecutive chunks are spatial neighbours
+	std::vector<std::pair<size_t, size_t>> ranges;
+	ranges.emplace_back(0, triangleCount);
+	while (!ranges.empty()) {
+		size_t begin = ranges.back().first;
+		size_t end = ranges.back().second;
+		ranges.pop_back();
+
+		// Only a mesh without triangles gets here with an empty range, it has no chunks at all
+		if (begin == end) {
+			continue;
+		}
+		if (end - begin > maxTriangles) {
+			glm::vec3 low(std::numeric_limits<float>::max());
+			glm::vec3 high(-std::numeric_limits<float>::max());
+			for (size_t i = begin; i < end; i++) {
+				low = glm::min(low, centroids[triangles[i]]);
+				high = glm::max(high, centroids[triangles[i]]);
+			}
+			glm::vec3 extent = high - low;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+			size_t middle = begin + (end - begin) / 2;
+			std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end, [&centroids, axis](uint32_t a, uint32_t b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+			ranges.emplace_back(middle, end);
+			ranges.emplace_back(begin, middle);
+			continue;
+		}
+
+		MeshData chunk;
+		chunk.indices.reserve((end - begin) * 3);
+		for (size_t i = begin; i < end; i++) {
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				uint32_t index = mesh.indices[triangles[i] * 3 + corner];
+				if (localIndex[index] == UINT32_MAX) {
+					localIndex[index] = static_cast<uint32_t>(chunk.vertices.size());
+					chunk.vertices.push_back(mesh.vertices[index]);
+					used.push_back(index);
+				}
+				chunk.indices.push_back(localIndex[index]);
+			}
+		}
+		for (uint32_t index : used) {
+			localIndex[index] = UINT32_MAX;
+		}
+		used.clear();
+
+		OptimizeVertexCache(chunk);
+		OptimizeVertexFetch(chunk);
+		chunks.push_back(std::move(chunk));
+	}
+}
+
+void MeshLoader::Simplify(const MeshData& mesh, uint32_t gridSize, MeshData& lod)
+{
+	lod.vertices.clear();
+	lod.indices.clear();
+	if (mesh.vertices.empty()) {
+		return;
+	}
+
+	glm::vec3 low = mesh.vertices[0].pos;
+	glm::vec3 high = mesh.vertices[0].pos;
+	for (const Vertex& vertex : mesh.vertices) {
+		low = glm::min(low, vertex.pos);
+		high = glm::max(high, vertex.pos);
+	}
+	glm::vec3 extent = high - low;
+	float cellSize = std::max(extent.x, std::max(extent.y, extent.z)) / std::max(1u, gridSize);
+	if (cellSize <= 0.0f) {
+		cellSize = 1.0f;
+	}
+
+	// Cells keep the attributes of their first vertex and the average position of all of them
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<glm::vec3> positionSums;
+	std::vector<uint32_t> positionCounts;
+	std::vector<uint32_t> remap(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++) {
+		glm::uvec3 cell = glm::uvec3(glm::min((mesh.vertices[i].pos - low) / cellSize, glm::vec3(static_cast<float>(gridSize))));
+		uint64_t key = static_cast<uint64_t>(cell.x) | static_cast<uint64_t>(cell.y) << 21 | static_cast<uint64_t>(cell.z) << 42;
+
+		auto inserted = cells.emplace(key, static_cast<uint32_t>(lod.vertices.size()));
+		if (inserted.second) {
+			lod.vertices.push_back(mesh.vertices[i]);
+			positionSums.push_back(mesh.vertices[i].pos);
+			positionCounts.push_back(1);
+		}
+		else {
+			positionSums[inserted.first->second] += mesh.vertices[i].pos;
+			positionCounts[inserted.first->second]++;
+		}
+		remap[i] = inserted.first->second;
+	}
+	for (size_t i = 0; i < lod.vertices.size(); i++) {
+		lod.vertices[i].pos = positionSums[i] / static_cast<float>(positionCounts[i]);
+	}
+
+	// Rotated so the smallest index comes first, which keeps the winding and makes duplicates compare equal
+	std::unordered_set<uint64_t> seen;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		uint32_t a = remap[mesh.indices[i]];
+		uint32_t b = remap[mesh.indices[i + 1]];
+		uint32_t c = remap[mesh.indices[i + 2]];
+		if (a == b || b == c || a == c) {
+			continue;
+		}
+		while (a > b || a > c) {
+			uint32_t first = a;
+			a = b;
+			b = c;
+			c = first;
+		}
+		uint64_t key = static_cast<uint64_t>(a) | static_cast<uint64_t>(b) << 21 | static_cast<uint64_t>(c) << 42;
+		if (seen.insert(key).second) {
+			lod.indices.push_back(a);
+			lod.indices.push_back(b);
+			lod.indices.push_back(c);
+		}
+	}
+
+	OptimizeVertexCache(lod);
+	OptimizeVertexFetch(lod);
+}
@@ -0,0 +1,49 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	// Diffuse texture of the first material that has one, relative to the OBJ file's directory
+	std::string diffuseTexture;
+};
+
+// CPU side OBJ loading and mesh optimization, shared by Model and the asset cooker
+class MeshLoader {
+	public:
+		MeshLoader() = delete;
+		~MeshLoader() = delete;
+
+		// Parse and deduplicate in one go
+		static void LoadObj(const std::string& path, MeshData& mesh);
+		// Same for an OBJ file that is already in memory, path only locates its material files
+		static void LoadObj(const std::string& path, const uint8_t* data, size_t size, MeshData& mesh);
+
+		// One vertex per face corner, in file order
+		static void ParseObj(const std::string& path, std::vector<Vertex>& corners, std::string* diffuseTexture = nullptr);
+		static void ParseObj(const std::string& path, const uint8_t* data, size_t size, std::vector<Vertex>& corners, std::string* diffuseTexture = nullptr);
+		static void Deduplicate(const std::vector<Vertex>& corners, MeshData& mesh);
+
+		// Reorders triangles for post-transform vertex cache hits (Forsyth's linear-speed algorithm)
+		static void OptimizeVertexCache(MeshData& mesh);
+		// Reorders vertices into first-use order so vertex fetches walk memory linearly
+		static void OptimizeVertexFetch(MeshData& mesh);
+
+		// Three corners per triangle never reach 65536 vertices, so every chunk fits 16 bit indices
+		static constexpr uint32_t MaxChunkTriangles = 65536 / 3;
+
+		// Splits the mesh at the median triangle centroid along the longest axis until every piece has at most
+		// maxTriangles triangles. Chunks have their own vertices and are optimized like whole meshes, a mesh without
+		// triangles gives no chunks
+		static void Partition(const MeshData& mesh, uint32_t maxTriangles, std::vector<MeshData>& chunks);
+		// Coarse stand-in for a chunk by vertex clustering: vertices in the same cell of a grid with gridSize cells
+		// along the longest side merge into their average, triangles that collapse are dropped
+		static void Simplify(const MeshData& mesh, uint32_t gridSize, MeshData& lod);
+};
+
+#endif
@@ -0,0 +1,411 @@
+#include "MipGenerator.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "CpuProfiler.h"
+#include "JobSystem.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIP_TARGET_AVX2
+#else
+#define MIP_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+	const size_t LevelAlignment = 16;
+
+	// Filter support in destination texels on each side of the texel center
+	const float KaiserRadius = 2.0f;
+	const float KaiserAlpha = 4.0f;
+
+	// Levels smaller than this are not worth handing to other threads
+	const size_t ParallelTexelThreshold = 64 * 1024;
+
+	const float Pi = 3.14159265358979f;
+
+	// Upper bound on taps per axis, a level is never less than a third of its parent
+	const uint32_t MaxTaps = 32;
+
+	template<typename Func>
+	void ParallelRows(size_t rows, size_t texelsPerRow, Func func) {
+		// Every job gets at least ParallelTexelThreshold texels, smaller levels stay on the calling thread
+		size_t grain = std::max<size_t>(1, ParallelTexelThreshold / std::max<size_t>(1, texelsPerRow));
+		JobSystem::Instance().ParallelFor(rows, grain, func);
+	}
+
+	float BesselI0(float x) {
+		// Power series, converges quickly for the small arguments the window uses
+		float sum = 1.0f;
+		float term = 1.0f;
+		float halfX = x * 0.5f;
+		for (int k = 1; k < 20; k++) {
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float Sinc(float x) {
+		if (std::fabs(x) < 1e-6f) {
+			return 1.0f;
+		}
+		return std::sin(Pi * x) / (Pi * x);
+	}
+
+	float Kaiser(float x) {
+		if (std::fabs(x) >= 1.0f) {
+			return 0.0f;
+		}
+		return BesselI0(KaiserAlpha * std::sqrt(1.0f - x * x)) / BesselI0(KaiserAlpha);
+	}
+
+	struct SrgbTables {
+		float toLinear[256];
+		// Linear values are quantized to 16 bits before the lookup, enough to round-trip every 8 bit sRGB value
+		uint8_t fromLinear[65536];
+
+		SrgbTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 65536; i++) {
+				float l = i / 65535.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+		}
+	};
+
+	const SrgbTables& Srgb() {
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	bool DetectAVX2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+	const bool HasAVX2 = DetectAVX2();
+
+	// Weighted sum of source rows into one destination row, rows are plain float arrays so this is a straight SAXPY chain
+	void FilterColumnSSE(const float* const* rows, const float* weights, uint32_t count, size_t floatCount, float* dst) {
+		size_t i = 0;
+		for (; i + 4 <= floatCount; i += 4) {
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t k = 0; k < count; k++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+			}
+			_mm_storeu_ps(dst + i, sum);
+		}
+		for (; i < floatCount; i++) {
+			float sum = 0.0f;
+			for (uint32_t k = 0; k < count; k++) {
+				sum += weights[k] * rows[k][i];
+			}
+			dst[i] = sum;
+		}
+	}
+
+	MIP_TARGET_AVX2 void FilterColumnAVX2(const float* const* rows, const float* weights, uint32_t count, size_t floatCount, float* dst) {
+		size_t i = 0;
+		for (; i + 16 <= floatCount; i += 16) {
+			__m256 sum0 = _mm256_setzero_ps();
+			__m256 sum1 = _mm256_setzero_ps();
+			for (uint32_t k = 0; k < count; k++) {
+				__m256 weight = _mm256_set1_ps(weights[k]);
+				sum0 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(rows[k] + i), sum0);
+				sum1 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(rows[k] + i + 8), sum1);
+			}
+			_mm256_storeu_ps(dst + i, sum0);
+			_mm256_storeu_ps(dst + i + 8, sum1);
+		}
+		if (i < floatCount) {
+			const float* tail[MaxTaps];
+			for (uint32_t k = 0; k < count; k++) {
+				tail[k] = rows[k] + i;
+			}
+			FilterColumnSSE(tail, weights, count, floatCount - i, dst + i);
+		}
+	}
+
+	// Horizontal pass, one RGBA texel is exactly one SSE register
+	void FilterRowSSE(const float* src, const uint32_t* first, const uint32_t* count, const float* weights, uint32_t maxCount, uint32_t dstWidth, float* dst) {
+		for (uint32_t x = 0; x < dstWidth; x++) {
+			const float* texel = src + static_cast<size_t>(first[x]) * 4;
+			const float* w = weights + static_cast<size_t>(x) * maxCount;
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t k = 0; k < count[x]; k++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(texel + k * 4)));
+			}
+			_mm_storeu_ps(dst + static_cast<size_t>(x) * 4, sum);
+		}
+	}
+
+	// Two destination texels per iteration, one in each 128 bit lane
+	MIP_TARGET_AVX2 void FilterRowAVX2(const float* src, const uint32_t* first, const uint32_t* count, const float* weights, uint32_t maxCount, uint32_t dstWidth, float* dst) {
+		uint32_t x = 0;
+		for (; x + 2 <= dstWidth; x += 2) {
+			const float* texel0 = src + static_cast<size_t>(first[x]) * 4;
+			const float* texel1 = src + static_cast<size_t>(first[x + 1]) * 4;
+			const float* w0 = weights + static_cast<size_t>(x) * maxCount;
+			const float* w1 = w0 + maxCount;
+			uint32_t taps = std::max(count[x], count[x + 1]);
+
+			__m256 sum = _mm256_setzero_ps();
+			for (uint32_t k = 0; k < taps; k++) {
+				// Weights past a texel's own tap count are zero, clamp the read so it stays inside its footprint
+				uint32_t k0 = std::min(k, count[x] - 1);
+				uint32_t k1 = std::min(k, count[x + 1] - 1);
+				__m256 weight = _mm256_setr_m128(_mm_set1_ps(k < count[x] ? w0[k] : 0.0f), _mm_set1_ps(k < count[x + 1] ? w1[k] : 0.0f));
+				__m256 value = _mm256_setr_m128(_mm_loadu_ps(texel0 + k0 * 4), _mm_loadu_ps(texel1 + k1 * 4));
+				sum = _mm256_fmadd_ps(weight, value, sum);
+			}
+			_mm256_storeu_ps(dst + static_cast<size_t>(x) * 4, sum);
+		}
+		if (x < dstWidth) {
+			FilterRowSSE(src, first + x, count + x, weights + static_cast<size_t>(x) * maxCount, maxCount, dstWidth - x, dst + static_cast<size_t>(x) * 4);
+		}
+	}
+}
+
+void MipGenerator::DecodeImage(const std::string& path, TextureData& data)
+{
+	CpuZone zone("decode image");
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image " + path);
+	}
+
+	data = TextureData();
+	data.format = VK_FORMAT_R8G8B8A8_SRGB;
+	data.width = static_cast<uint32_t>(texWidth);
+	data.height = static_cast<uint32_t>(texHeight);
+
+	MipLevel level;
+	level.width = data.width;
+	level.height = data.height;
+	level.offset = 0;
+	level.size = TextureData::LevelSize(data.format, data.width, data.height);
+
+	data.pixels.assign(pixels, pixels + level.size);
+	data.levels.push_back(level);
+
+	stbi_image_free(pixels);
+}
+
+bool MipGenerator::UsesAVX2()
+{
+	return HasAVX2;
+}
+
+void MipGenerator::GenerateMipChain(TextureData& data, MipFilter filter)
+{
+	CpuZone zone("generate mips");
+	if (data.levels.empty() || TextureData::BlockSize(data.format) != 0) {
+		throw std::runtime_error("mip chains can only be generated for uncompressed textures!");
+	}
+
+	bool srgb = data.format == VK_FORMAT_R8G8B8A8_SRGB || data.format == VK_FORMAT_B8G8R8A8_SRGB;
+
+	data.levels.resize(1);
+	data.pixels.resize(data.levels[0].size);
+
+	// Size everything up front so level pointers stay valid while filtering
+	size_t totalSize = data.pixels.size();
+	uint32_t width = data.width;
+	uint32_t height = data.height;
+	while (width > 1 || height > 1) {
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+
+		MipLevel level;
+		level.width = width;
+		level.height = height;
+		level.offset = (totalSize + LevelAlignment - 1) / LevelAlignment * LevelAlignment;
+		level.size = TextureData::LevelSize(data.format, width, height);
+		data.levels.push_back(level);
+
+		totalSize = level.offset + level.size;
+	}
+	data.pixels.resize(totalSize);
+
+	// Every level is filtered from the previous one at full float precision, only the stored copy is quantized
+	const MipLevel& base = data.levels[0];
+	std::vector<float> current(static_cast<size_t>(base.width) * base.height * 4);
+	std::vector<float> next;
+	std::vector<float> scratch;
+	DecodeLevel(data.pixels.data(), static_cast<size_t>(base.width) * base.height, srgb, current.data());
+
+	for (size_t i = 1; i < data.levels.size(); i++) {
+		const MipLevel& src = data.levels[i - 1];
+		const MipLevel& dst = data.levels[i];
+
+		next.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+		Downsample(current.data(), src.width, src.height, next.data(), dst.width, dst.height, filter, scratch);
+		EncodeLevel(next.data(), static_cast<size_t>(dst.width) * dst.height, srgb, data.pixels.data() + dst.offset);
+
+		current.swap(next);
+	}
+}
+
+void MipGenerator::ComputeTaps(MipFilter filter, uint32_t srcSize, uint32_t dstSize, FilterTaps& taps)
+{
+	float scale = static_cast<float>(srcSize) / dstSize;
+	float support = filter == MipFilter::Box ? scale * 0.5f : scale * KaiserRadius;
+
+	taps.first.resize(dstSize);
+	taps.count.resize(dstSize);
+	taps.maxCount = static_cast<uint32_t>(std::ceil(support * 2.0f)) + 2;
+	taps.weights.assign(static_cast<size_t>(dstSize) * taps.maxCount, 0.0f);
+
+	for (uint32_t x = 0; x < dstSize; x++) {
+		float center = (x + 0.5f) * scale;
+		int begin = static_cast<int>(std::floor(center - support));
+		int end = static_cast<int>(std::ceil(center + support));
+
+		// Taps outside the image are folded onto the edge texels
+		begin = std::max(begin, 0);
+		end = std::min(end, static_cast<int>(srcSize));
+
+		float* weights = &taps.weights[static_cast<size_t>(x) * taps.maxCount];
+		float total = 0.0f;
+		for (int s = begin; s < end; s++) {
+			float weight;
+			if (filter == MipFilter::Box) {
+				// Overlap of source texel [s, s + 1] with the footprint
+				weight = std::max(0.0f, std::min(s + 1.0f, center + support) - std::max(static_cast<float>(s), center - support));
+			}
+			else {
+				float distance = (s + 0.5f - center) / scale;
+				weight = Sinc(distance) * Kaiser(distance / KaiserRadius);
+			}
+			weights[s - begin] = weight;
+			total += weight;
+		}
+		for (int s = begin; s < end; s++) {
+			weights[s - begin] /= total;
+		}
+
+		taps.first[x] = static_cast<uint32_t>(begin);
+		taps.count[x] = static_cast<uint32_t>(end - begin);
+	}
+}
+
+void MipGenerator::Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t dstHeight, MipFilter filter, std::vector<float>& scratch)
+{
+	FilterTaps horizontal;
+	FilterTaps vertical;
+	ComputeTaps(filter, srcWidth, dstWidth, horizontal);
+	ComputeTaps(filter, srcHeight, dstHeight, vertical);
+
+	// Horizontal pass into a dstWidth x srcHeight intermediate, then vertical pass into dst
+	scratch.resize(static_cast<size_t>(dstWidth) * srcHeight * 4);
+	float* intermediate = scratch.data();
+
+	ParallelRows(srcHeight, dstWidth, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			const float* srcRow = src + y * srcWidth * 4;
+			float* dstRow = intermediate + y * dstWidth * 4;
+			if (HasAVX2) {
+				FilterRowAVX2(srcRow, horizontal.first.data(), horizontal.count.data(), horizontal.weights.data(), horizontal.maxCount, dstWidth, dstRow);
+			}
+			else {
+				FilterRowSSE(srcRow, horizontal.first.data(), horizontal.count.data(), horizontal.weights.data(), horizontal.maxCount, dstWidth, dstRow);
+			}
+		}
+	});
+
+	ParallelRows(dstHeight, dstWidth, [&](size_t begin, size_t end) {
+		const float* rows[MaxTaps];
+		for (size_t y = begin; y < end; y++) {
+			uint32_t count = vertical.count[y];
+			for (uint32_t k = 0; k < count; k++) {
+				rows[k] = intermediate + static_cast<size_t>(vertical.first[y] + k) * dstWidth * 4;
+			}
+			const float* weights = &vertical.weights[y * vertical.maxCount];
+			float* dstRow = dst + y * dstWidth * 4;
+			if (HasAVX2) {
+				FilterColumnAVX2(rows, weights, count, static_cast<size_t>(dstWidth) * 4, dstRow);
+			}
+			else {
+				FilterColumnSSE(rows, weights, count, static_cast<size_t>(dstWidth) * 4, dstRow);
+			}
+		}
+	});
+}
+
+void MipGenerator::DecodeLevel(const uint8_t* src, size_t texelCount, bool srgb, float* dst)
+{
+	const SrgbTables& tables = Srgb();
+	ParallelRows(texelCount, 1, [&](size_t begin, size_t end) {
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+		for (size_t i = begin; i < end; i++) {
+			uint32_t packed;
+			memcpy(&packed, src + i * 4, 4);
+			__m128i bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed)), _mm_setzero_si128()), _mm_setzero_si128());
+			__m128 texel = _mm_mul_ps(_mm_cvtepi32_ps(bytes), scale);
+			_mm_storeu_ps(dst + i * 4, texel);
+			if (srgb) {
+				dst[i * 4 + 0] = tables.toLinear[src[i * 4 + 0]];
+				dst[i * 4 + 1] = tables.toLinear[src[i * 4 + 1]];
+				dst[i * 4 + 2] = tables.toLinear[src[i * 4 + 2]];
+			}
+		}
+	});
+}
+
+void MipGenerator::EncodeLevel(const float* src, size_t texelCount, bool srgb, uint8_t* dst)
+{
+	const SrgbTables& tables = Srgb();
+	ParallelRows(texelCount, 1, [&](size_t begin, size_t end) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		// sRGB color channels index the 16 bit table, alpha and UNORM channels are rounded directly
+		const __m128 scale = srgb ? _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f) : _mm_set1_ps(255.0f);
+		for (size_t i = begin; i < end; i++) {
+			// Kaiser overshoots at sharp edges, clamp before quantizing
+			__m128 texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i * 4), zero), one);
+			alignas(16) int32_t values[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvtps_epi32(_mm_mul_ps(texel, scale)));
+
+			if (srgb) {
+				dst[i * 4 + 0] = tables.fromLinear[values[0]];
+				dst[i * 4 + 1] = tables.fromLinear[values[1]];
+				dst[i * 4 + 2] = tables.fromLinear[values[2]];
+			}
+			else {
+				dst[i * 4 + 0] = static_cast<uint8_t>(values[0]);
+				dst[i * 4 + 1] = static_cast<uint8_t>(values[1]);
+				dst[i * 4 + 2] = static_cast<uint8_t>(values[2]);
+			}
+			dst[i * 4 + 3] = static_cast<uint8_t>(values[3]);
+		}
+	});
+}
@@ -0,0 +1,47 @@
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include <string>
+#include <vector>
+
+#include "TextureData.h"
+
+enum class MipFilter {
+	// Averages the source footprint of each texel, cheap and never rings
+	Box,
+	// Kaiser windowed sinc, keeps more detail in the smaller levels at roughly twice the cost
+	Kaiser
+};
+
+// Builds RGBA8 mip chains on the CPU so the whole chain can be uploaded with one copy instead of a blit per level.
+// Filtering happens in linear light, sRGB formats are decoded before and encoded after each level.
+class MipGenerator {
+	public:
+		MipGenerator() = delete;
+		~MipGenerator() = delete;
+
+		// Decodes any image stb_image understands into a single RGBA8 level
+		static void DecodeImage(const std::string& path, TextureData& data);
+
+		// Replaces everything after level 0 with a filtered chain down to 1x1
+		static void GenerateMipChain(TextureData& data, MipFilter filter = MipFilter::Box);
+
+		// True when the AVX2 paths are used, SSE2 otherwise
+		static bool UsesAVX2();
+
+	private:
+		// Source texels and weights contributing to one destination texel along one axis
+		struct FilterTaps {
+			std::vector<uint32_t> first;
+			std::vector<uint32_t> count;
+			std::vector<float> weights;
+			uint32_t maxCount = 0;
+		};
+
+		static void ComputeTaps(MipFilter filter, uint32_t srcSize, uint32_t dstSize, FilterTaps& taps);
+		static void Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t dstHeight, MipFilter filter, std::vector<float>& scratch);
+		static void DecodeLevel(const uint8_t* src, size_t texelCount, bool srgb, float* dst);
+		static void EncodeLevel(const float* src, size_t texelCount, bool srgb, uint8_t* dst);
+};
+
+#endif
@@ -1,111 +1,156 @@
 #include "Model.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#include <unordered_map>
+#include <stdexcept>
 
 #include "Vertex.h"
+#include "CpuProfiler.h"
+#include "MeshLoader.h"
 #include "Device.h"
 #include "CommandPool.h"
 #include "CommandBuffers.h"
+#include "GpuTimeline.h"
 
 
-Model::Model(const Device & device, CommandPool& commandPool)
-	: m_device(device), m_commandPool(commandPool)
+Model::Model(const Device & device, CommandPool& commandPool, GpuTimeline& timeline)
+	: m_device(device), m_commandPool(commandPool), m_timeline(timeline)
 {
 }
 
 Model::~Model()
 {
-	vkDestroyBuffer(m_device.logical(), m_indexBuffer, nullptr);
-	vkFreeMemory(m_device.logical(), m_indexBufferMemory, nullptr);
-
-	vkDestroyBuffer(m_device.logical(), m_vertexBuffer, nullptr);
-	vkFreeMemory(m_device.logical(), m_vertexBufferMemory, nullptr);
+	m_timeline.RetireBuffer(m_indexBuffer, m_indexBufferMemory);
+	m_timeline.RetireBuffer(m_vertexBuffer, m_vertexBufferMemory);
 }
 
 void Model::LoadModel(std::string modelPath)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
+	CpuZone zone("load model");
+	MeshData mesh;
+	MeshLoader::LoadObj(modelPath, mesh);
+	SetMesh(std::move(mesh));
+}
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str())) {
-		throw std::runtime_error(warn + err);
-	}
+void Model::LoadModel(const std::string& modelPath, const uint8_t* data, size_t size)
+{
+	CpuZone zone("load model");
+	MeshData mesh;
+	MeshLoader::LoadObj(modelPath, data, size, mesh);
+	SetMesh(std::move(mesh));
+}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+void Model::SetMesh(MeshData mesh)
+{
+	m_vertices = std::move(mesh.vertices);
+	m_indices = std::move(mesh.indices);
+	m_indexCount = static_cast<uint32_t>(m_indices.size());
+	m_indexType = VK_INDEX_TYPE_UINT32;
+}
 
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
+void Model::LoadPackage(const std::string& packagePath)
+{
+	CpuZone zone("load package");
+	m_package = std::make_unique<AssetPackage>(packagePath);
+
+	const PackageSectionEntry* vertices = m_package->FindSection(PackageSection::Vertices);
+	const PackageSectionEntry* indices = m_package->FindSection(PackageSection::Indices);
+	if (!vertices || !indices) {
+		if (m_package->FindSection(PackageSection::ChunkTable)) {
+			throw std::runtime_error("asset package holds a streamed mesh, open it with StreamingMesh: " + packagePath);
+		}
+		throw std::runtime_error("asset package has no mesh: " + packagePath);
+	}
 
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+	m_indexCount = indices->count;
+	m_indexType = static_cast<VkIndexType>(indices->format);
+}
 
-			vertex.texCoord = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
+void Model::BuildBVH()
+{
+	if (!m_package) {
+		m_bvh.Build(m_vertices.data(), m_vertices.size(), m_indices.data(), m_indices.size());
+		return;
+	}
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
+	const PackageSectionEntry& vertices = *m_package->FindSection(PackageSection::Vertices);
+	const PackageSectionEntry& indices = *m_package->FindSection(PackageSection::Indices);
+	const Vertex* vertexData = reinterpret_cast<const Vertex*>(m_package->SectionData(vertices));
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-				m_vertices.push_back(vertex);
-			}
-			m_indices.push_back(uniqueVertices[vertex]);
-		}
+	if (m_indexType == VK_INDEX_TYPE_UINT32) {
+		m_bvh.Build(vertexData, vertices.count, reinterpret_cast<const uint32_t*>(m_package->SectionData(indices)), indices.count);
+	}
+	else {
+		// The BVH only takes 32 bit indices
+		const uint16_t* shortIndices = reinterpret_cast<const uint16_t*>(m_package->SectionData(indices));
+		std::vector<uint32_t> wideIndices(shortIndices, shortIndices + indices.count);
+		m_bvh.Build(vertexData, vertices.count, wideIndices.data(), wideIndices.size());
 	}
 }
 
 void Model::CreateVertexBuffer() {
-	VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device);
-
-	void* data;
-	vkMapMemory(m_device.logical(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_device.logical(), stagingBufferMemory);
+	if (m_package) {
+		const PackageSectionEntry& vertices = *m_package->FindSection(PackageSection::Vertices);
+		UploadBuffer(vertices.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::Vertex, m_vertexBuffer, m_vertexBufferMemory,
+			[this, &vertices](void* destination) { m_package->ReadSection(vertices, destination); });
+		return;
+	}
 
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory, m_device);
+	VkDeviceSize bufferSize = sizeof(Vertex) * m_vertices.size();
+	UploadBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::Vertex, m_vertexBuffer, m_vertexBufferMemory,
+		[this, bufferSize](void* destination) { memcpy(destination, m_vertices.data(), (size_t)bufferSize); });
+}
 
-	CopyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
+void Model::CreateIndexBuffer() {
+	if (m_package) {
+		const PackageSectionEntry& indices = *m_package->FindSection(PackageSection::Indices);
+		UploadBuffer(indices.size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryCategory::Index, m_indexBuffer, m_indexBufferMemory,
+			[this, &indices](void* destination) { m_package->ReadSection(indices, destination); });
+		return;
+	}
 
-	vkDestroyBuffer(m_device.logical(), stagingBuffer, nullptr);
-	vkFreeMemory(m_device.logical(), stagingBufferMemory, nullptr);
+	VkDeviceSize bufferSize = sizeof(uint32_t) * m_indices.size();
+	UploadBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryCategory::Index, m_indexBuffer, m_indexBufferMemory,
+		[this, bufferSize](void* destination) { memcpy(destination, m_indices.data(), (size_t)bufferSize); });
 }
 
-void Model::CreateIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
+void Model::UploadBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags usage, MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::function<void(void*)>& write) {
+	CpuZone zone("upload buffer");
+	if (m_device.memory().directUploads()) {
+		// The data goes where the GPU reads it, no staging buffer and no copy on the GPU. Host writes to coherent
+		// memory are visible to everything submitted afterwards, so there is nothing to wait for either
+		CreateBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory, m_device, category);
+		m_memorySize += bufferSize;
+
+		void* data;
+		vkMapMemory(m_device.logical(), bufferMemory, 0, bufferSize, 0, &data);
+		write(data);
+		vkUnmapMemory(m_device.logical(), bufferMemory);
+		return;
+	}
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device);
+	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device, MemoryCategory::Staging);
 
 	void* data;
 	vkMapMemory(m_device.logical(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_indices.data(), (size_t)bufferSize);
+	write(data);
 	vkUnmapMemory(m_device.logical(), stagingBufferMemory);
 
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory, m_device);
+	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory, m_device, category);
+	m_memorySize += bufferSize;
 
-	CopyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
-
-	vkDestroyBuffer(m_device.logical(), stagingBuffer, nullptr);
-	vkFreeMemory(m_device.logical(), stagingBufferMemory, nullptr);
+	// The staging buffer lives until the copy has run, nothing here waits for it
+	uint64_t copied = CopyBuffer(stagingBuffer, buffer, bufferSize);
+	const Device* device = &m_device;
+	m_timeline.Retire(copied, [device, stagingBuffer, stagingBufferMemory]() {
+		vkDestroyBuffer(device->logical(), stagingBuffer, nullptr);
+		device->memory().Free(stagingBufferMemory);
+	});
 }
 
 
 
-void Model::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const Device & device) {
+void Model::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const Device & device, MemoryCategory category) {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -119,27 +164,20 @@ void Model::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPr
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device.logical(), buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties, device);
-
-	if (vkAllocateMemory(device.logical(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate vertex buffer memory!");
-	}
+	bufferMemory = device.memory().Allocate(memRequirements, properties, category);
 
 	//Memory allocation was successful, associate memory with the buffer
 	vkBindBufferMemory(device.logical(), buffer, bufferMemory, 0);
 }
 
-void Model::CopyBuffer(VkBuffer srcBuffer, VkBuffer destBuffer, VkDeviceSize size) {
-	VkCommandBuffer commandBuffer = CommandBuffers::BeginSingleTimeCommands(m_device, m_commandPool);
+uint64_t Model::CopyBuffer(VkBuffer srcBuffer, VkBuffer destBuffer, VkDeviceSize size) {
+	VkCommandBuffer commandBuffer = CommandBuffers::BeginSingleTimeCommands(m_device, m_commandPool, m_timeline, "buffer upload");
 
 	VkBufferCopy copyRegion{};
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, destBuffer, 1, &copyRegion);
 
-	CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool);
+	return CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool, m_timeline);
 }
 
 
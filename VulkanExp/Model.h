@@ -2,44 +2,79 @@
 #define MODEL_H
 
 #include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "Vertex.h"
+#include "BVH.h"
+#include "AssetPackage.h"
+#include "MeshLoader.h"
+#include "MemoryTracker.h"
 
 class Device;
 class CommandBuffers;
 class CommandPool;
+class GpuTimeline;
 
 class Model {
 
 	public:
-		Model(const Device & device, CommandPool& commandPool);
+		// Buffers are uploaded and released on the timeline, so the model can go away while a frame still draws it
+		Model(const Device & device, CommandPool& commandPool, GpuTimeline& timeline);
 		~Model();
 
 		void LoadModel(std::string modelPath);
+		// Parses an OBJ file that was already read into memory, modelPath only locates its material files
+		void LoadModel(const std::string& modelPath, const uint8_t* data, size_t size);
+		// Uses a cooked package instead, vertex and index data stay in the mapped file until they are uploaded
+		void LoadPackage(const std::string& packagePath);
+		// Takes a mesh that is already in memory, generated or loaded elsewhere
+		void SetMesh(MeshData mesh);
 		void CreateVertexBuffer();
 		void CreateIndexBuffer();
 		inline VkBuffer GetVertextBuffer() { return m_vertexBuffer; }
 		inline VkBuffer GetIndexBuffer() { return m_indexBuffer; }
 		inline std::vector<uint32_t> GetIndices() { return m_indices; }
 		inline std::vector<Vertex> GetVertices() { return m_vertices; }
+		inline uint32_t GetIndexCount() const { return m_indexCount; }
+		inline VkIndexType GetIndexType() const { return m_indexType; }
+		// nullptr unless the model was loaded from a package
+		inline const AssetPackage* GetPackage() const { return m_package.get(); }
+		// Bytes of the vertex and index buffers uploaded so far
+		inline VkDeviceSize memorySize() const { return m_memorySize; }
 
-		static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const Device& device);
+		// Builds the CPU ray query structure over the loaded triangles, used for picking
+		void BuildBVH();
+		inline const BVH& GetBVH() const { return m_bvh; }
+
+		static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const Device& device, MemoryCategory category);
 		static uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, const Device& device);
 
 
 	private:
 		std::vector<Vertex> m_vertices;
 		std::vector<uint32_t> m_indices;
-		VkBuffer m_vertexBuffer;
-		VkDeviceMemory m_vertexBufferMemory;
-		VkBuffer m_indexBuffer;
-		VkDeviceMemory m_indexBufferMemory;
+		std::unique_ptr<AssetPackage> m_package;
+		uint32_t m_indexCount = 0;
+		VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+		BVH m_bvh;
+		VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+		VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
+		VkDeviceSize m_memorySize = 0;
 
 		const Device& m_device;
 		CommandPool& m_commandPool;
+		GpuTimeline& m_timeline;
 
-		void CopyBuffer(VkBuffer srcBuffer, VkBuffer destBuffer, VkDeviceSize size);
+		// write fills the bufferSize bytes at the pointer it is given, which is mapped device local memory when the
+		// device has host visible device local memory (integrated GPUs, resizable BAR) and staging otherwise
+		void UploadBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags usage, MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::function<void(void*)>& write);
+		// Returns the timeline value that signals once the copy is done
+		uint64_t CopyBuffer(VkBuffer srcBuffer, VkBuffer destBuffer, VkDeviceSize size);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
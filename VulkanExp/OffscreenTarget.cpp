@@ -0,0 +1,190 @@
+#include "OffscreenTarget.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include "CpuProfiler.h"
+#include "Model.h"
+
+namespace {
+	bool HasMemoryType(const Device& device, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(device.physical(), &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+OffscreenTarget::OffscreenTarget(const Device& device, uint32_t width, uint32_t height, uint32_t numImages)
+	: m_device(device),
+	m_format(VK_FORMAT_R8G8B8A8_SRGB),
+	m_images(numImages),
+	m_imageMemory(numImages),
+	m_imageViews(numImages),
+	m_readbackBuffers(numImages),
+	m_readbackMemory(numImages),
+	m_readbackMapped(numImages) {
+	m_extent = { width, height };
+
+	// The CPU reads every byte of the readback buffers, cached memory makes that a lot faster where it exists
+	VkMemoryPropertyFlags readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	if (!HasMemoryType(device, readbackProperties)) {
+		readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+	m_readbackCoherent = (readbackProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	for (uint32_t i = 0; i < numImages; i++) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = m_format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device.logical(), &imageInfo, nullptr, &m_images[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device.logical(), m_images[i], &memRequirements);
+
+		m_imageMemory[i] = device.memory().Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Attachment);
+		vkBindImageMemory(device.logical(), m_images[i], m_imageMemory[i], 0);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = m_images[i];
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = m_format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device.logical(), &viewInfo, nullptr, &m_imageViews[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image view!");
+		}
+
+		Model::CreateBuffer(frameSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackProperties, m_readbackBuffers[i], m_readbackMemory[i], device, MemoryCategory::Staging);
+
+		void* mapped;
+		if (vkMapMemory(device.logical(), m_readbackMemory[i], 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map readback buffer!");
+		}
+		m_readbackMapped[i] = static_cast<uint8_t*>(mapped);
+	}
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+	for (size_t i = 0; i < m_images.size(); i++) {
+		vkUnmapMemory(m_device.logical(), m_readbackMemory[i]);
+		vkDestroyBuffer(m_device.logical(), m_readbackBuffers[i], nullptr);
+		m_device.memory().Free(m_readbackMemory[i]);
+
+		vkDestroyImageView(m_device.logical(), m_imageViews[i], nullptr);
+		vkDestroyImage(m_device.logical(), m_images[i], nullptr);
+		m_device.memory().Free(m_imageMemory[i]);
+	}
+}
+
+void OffscreenTarget::RecordAfterRenderPass(VkCommandBuffer commandBuffer, uint32_t index) const
+{
+	// The render pass already left the image in TRANSFER_SRC_OPTIMAL, this only orders the copy after the color writes
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = m_images[index];
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { m_extent.width, m_extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, m_images[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_readbackBuffers[index], 1, &region);
+
+	VkBufferMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	hostBarrier.buffer = m_readbackBuffers[index];
+	hostBarrier.offset = 0;
+	hostBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		0, nullptr,
+		1, &hostBarrier,
+		0, nullptr);
+}
+
+const uint8_t* OffscreenTarget::ReadbackData(uint32_t index) const
+{
+	if (!m_readbackCoherent) {
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = m_readbackMemory[index];
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(m_device.logical(), 1, &range);
+	}
+	return m_readbackMapped[index];
+}
+
+void OffscreenTarget::WriteImage(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels)
+{
+	CpuZone zone("write image");
+	bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+	if (png) {
+		if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels, static_cast<int>(width) * 4)) {
+			throw std::runtime_error("failed to write " + path + "!");
+		}
+		return;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.write(reinterpret_cast<const char*>(pixels), static_cast<std::streamsize>(width) * height * 4)) {
+		throw std::runtime_error("failed to write " + path + "!");
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef OFFSCREENTARGET_H
+#define OFFSCREENTARGET_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Device.h"
+#include "RenderTarget.h"
+
+// RGBA8 color images rendered without a surface. Every image has a host visible buffer it is copied into at the
+// end of its render pass, so a frame can be read on the CPU once the submit that drew it has completed.
+class OffscreenTarget : public RenderTarget {
+	public:
+		OffscreenTarget(const Device& device, uint32_t width, uint32_t height, uint32_t numImages);
+		~OffscreenTarget();
+
+		OffscreenTarget(const OffscreenTarget&) = delete;
+		OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+		inline const VkFormat& imageFormat() const override { return m_format; }
+		inline const VkExtent2D& extent() const override { return m_extent; }
+		inline size_t numImages() const override { return m_images.size(); }
+		inline VkImageView imageView(uint32_t index) const override { return m_imageViews[index]; }
+		inline VkImageLayout finalLayout() const override { return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; }
+		void RecordAfterRenderPass(VkCommandBuffer commandBuffer, uint32_t index) const override;
+
+		// Tightly packed rows, width * 4 bytes each
+		const uint8_t* ReadbackData(uint32_t index) const;
+		inline VkDeviceSize frameSize() const { return static_cast<VkDeviceSize>(m_extent.width) * m_extent.height * 4; }
+
+		// PNG for paths ending in .png, raw RGBA8 rows for anything else
+		static void WriteImage(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels);
+
+	private:
+		const Device& m_device;
+
+		VkFormat m_format;
+		VkExtent2D m_extent;
+
+		std::vector<VkImage> m_images;
+		std::vector<VkDeviceMemory> m_imageMemory;
+		std::vector<VkImageView> m_imageViews;
+
+		std::vector<VkBuffer> m_readbackBuffers;
+		std::vector<VkDeviceMemory> m_readbackMemory;
+		std::vector<uint8_t*> m_readbackMapped;
+		bool m_readbackCoherent;
+};
+
+#endif
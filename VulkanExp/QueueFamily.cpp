@@ -18,8 +18,14 @@ QueueFamilyIndices QueueFamily::FindQueueFamilies(const VkPhysicalDevice & devic
 			indices.graphicsFamily = i;
 		}
 
+		// Without a surface nothing is presented, the graphics queue stands in for the present queue
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if (surface == VK_NULL_HANDLE) {
+			presentSupport = indices.graphicsFamily.has_value() && indices.graphicsFamily.value() == static_cast<uint32_t>(i);
+		}
+		else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
 
 		if (presentSupport) {
 			indices.presentFamily = i;
@@ -3,14 +3,15 @@
 #include <array>
 
 #include "Device.h"
+#include "GpuTimeline.h"
 #include "Model.h"
-#include "SwapChain.h"
+#include "RenderTarget.h"
 
 
-RenderPass::RenderPass(const Device& device, const SwapChain& swapChain)
+RenderPass::RenderPass(const Device& device, const RenderTarget& target)
 	: m_renderPass(VK_NULL_HANDLE),
 	m_device(device),
-	m_swapChain(swapChain) {
+	m_target(target) {
 	CreateRenderPass();
 	CreateDepthResources();
 	CreateFramebuffers();
@@ -22,24 +23,36 @@ RenderPass::~RenderPass() {
 	vkDestroyRenderPass(m_device.logical(), m_renderPass, nullptr);
 }
 
-void RenderPass::recreate() {
-	destroyDepthResources();
-	destroyFrameBuffers();
-	CreateDepthResources();
+void RenderPass::recreate(GpuTimeline& timeline) {
+	VkDevice device = m_device.logical();
+	std::vector<VkFramebuffer> oldFrameBuffers = m_frameBuffers;
+	timeline.Retire([device, oldFrameBuffers]() {
+		for (VkFramebuffer fb : oldFrameBuffers) {
+			vkDestroyFramebuffer(device, fb, nullptr);
+		}
+	});
+
+	// Attachments may be larger than the framebuffer, so a shrinking target keeps the depth image
+	const VkExtent2D& extent = m_target.extent();
+	if (extent.width > m_depthExtent.width || extent.height > m_depthExtent.height) {
+		timeline.RetireImage(m_depthImage, m_depthImageView, m_depthImageMemory);
+		CreateDepthResources();
+	}
+
 	//CreateRenderPass();
 	CreateFramebuffers();
 }
 
 
 void RenderPass::CreateFramebuffers() {
-	size_t numImages = m_swapChain.numImages();
+	size_t numImages = m_target.numImages();
 
 	m_frameBuffers.resize(numImages);
 
 	// Create a framebuffer for each image view
 	for (size_t i = 0; i < numImages; ++i) {
 		std::array<VkImageView, 2> attachments = {
-			m_swapChain.imageView(i),
+			m_target.imageView(i),
 			m_depthImageView
 		};
 
@@ -48,8 +61,8 @@ void RenderPass::CreateFramebuffers() {
 		framebufferInfo.renderPass = m_renderPass;
 		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 		framebufferInfo.pAttachments = attachments.data();
-		framebufferInfo.width = m_swapChain.extent().width;
-		framebufferInfo.height = m_swapChain.extent().height;
+		framebufferInfo.width = m_target.extent().width;
+		framebufferInfo.height = m_target.extent().height;
 		framebufferInfo.layers = 1;
 
 		if (vkCreateFramebuffer(m_device.logical(), &framebufferInfo, nullptr, &m_frameBuffers[i]) != VK_SUCCESS) {
@@ -67,19 +80,19 @@ void RenderPass::destroyFrameBuffers() {
 void RenderPass::destroyDepthResources() {
 	vkDestroyImageView(m_device.logical(), m_depthImageView, nullptr);
 	vkDestroyImage(m_device.logical(), m_depthImage, nullptr);
-	vkFreeMemory(m_device.logical(), m_depthImageMemory, nullptr);
+	m_device.memory().Free(m_depthImageMemory);
 }
 
 void RenderPass::CreateRenderPass() {
 	VkAttachmentDescription colorAttachment{};
-	colorAttachment.format = m_swapChain.imageFormat();
+	colorAttachment.format = m_target.imageFormat();
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = m_target.finalLayout();
 
 	VkAttachmentDescription depthAttachment{};
 	depthAttachment.format = FindDepthFormat();
@@ -133,7 +146,8 @@ void RenderPass::CreateDepthResources()
 {
 	VkFormat depthFormat = FindDepthFormat();
 
-	CreateImage(m_swapChain.extent().width, m_swapChain.extent().height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+	m_depthExtent = m_target.extent();
+	CreateImage(m_depthExtent.width, m_depthExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
 	m_depthImageView = CreateImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
@@ -184,14 +198,7 @@ void RenderPass::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(m_device.logical(), image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = Model::FindMemoryType(memRequirements.memoryTypeBits, properties, m_device);
-
-	if (vkAllocateMemory(m_device.logical(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	imageMemory = m_device.memory().Allocate(memRequirements, properties, MemoryCategory::Attachment);
 
 	vkBindImageMemory(m_device.logical(), image, imageMemory, 0);
 }
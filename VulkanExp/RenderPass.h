@@ -5,11 +5,12 @@
 #include <vector>
 
 class Device;
-class SwapChain;
+class RenderTarget;
+class GpuTimeline;
 
 class RenderPass {
 public:
-	RenderPass(const Device& device, const SwapChain& swapChain);
+	RenderPass(const Device& device, const RenderTarget& target);
 	~RenderPass();
 
 	void destroyDepthResources();
@@ -21,7 +22,9 @@ public:
 	inline const VkFramebuffer& frameBuffer(uint32_t index) const { return m_frameBuffers[index]; }
 	inline size_t size() const { return m_frameBuffers.size(); }
 
-	void recreate();
+	// Rebuilds the framebuffers for the current target images, the old ones are retired on the timeline.
+	// The depth image is kept when the new extent fits inside it
+	void recreate(GpuTimeline& timeline);
 
 private:
 	VkRenderPass m_renderPass;
@@ -31,9 +34,11 @@ private:
 	VkImage m_depthImage;
 	VkDeviceMemory m_depthImageMemory;
 	VkImageView m_depthImageView;
+	// Size the depth image was created with, may be larger than the swap chain after a shrink
+	VkExtent2D m_depthExtent = { 0, 0 };
 
 	const Device& m_device;
-	const SwapChain& m_swapChain;
+	const RenderTarget& m_target;
 
 	void CreateRenderPass();
 
@@ -0,0 +1,24 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+
+// Color images a RenderPass builds its framebuffers over, either the swap chain or offscreen images
+class RenderTarget {
+	public:
+		virtual ~RenderTarget() {}
+
+		virtual const VkFormat& imageFormat() const = 0;
+		virtual const VkExtent2D& extent() const = 0;
+		virtual size_t numImages() const = 0;
+		virtual VkImageView imageView(uint32_t index) const = 0;
+
+		// Layout the render pass leaves the color image in
+		virtual VkImageLayout finalLayout() const = 0;
+		// Recorded right after the render pass that drew into image index, before the command buffer ends
+		virtual void RecordAfterRenderPass(VkCommandBuffer, uint32_t) const {}
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "SamplerCache.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "ContentHash.h"
+#include "Device.h"
+
+SamplerCache::SamplerCache(const Device& device) : m_device(device)
+{
+	// Queried once here instead of for every texture
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(m_device.physical(), &properties);
+	m_maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+}
+
+SamplerCache::~SamplerCache()
+{
+	for (const auto& sampler : m_samplers) {
+		vkDestroySampler(m_device.logical(), sampler.second, nullptr);
+	}
+}
+
+VkSampler SamplerCache::Get(const VkSamplerCreateInfo& createInfo)
+{
+	if (createInfo.pNext) {
+		throw std::runtime_error("sampler cache does not support extension structures!");
+	}
+
+	Key key = MakeKey(createInfo);
+	auto found = m_samplers.find(key);
+	if (found != m_samplers.end()) {
+		return found->second;
+	}
+
+	VkSampler sampler;
+	if (vkCreateSampler(m_device.logical(), &createInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+	m_samplers.emplace(key, sampler);
+	return sampler;
+}
+
+VkSamplerCreateInfo SamplerCache::DefaultCreateInfo() const
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.maxAnisotropy = m_maxAnisotropy;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.mipLodBias = 0.0f;
+	return samplerInfo;
+}
+
+SamplerCache::Key SamplerCache::MakeKey(const VkSamplerCreateInfo& createInfo)
+{
+	Key key;
+	key.flags = createInfo.flags;
+	key.magFilter = createInfo.magFilter;
+	key.minFilter = createInfo.minFilter;
+	key.mipmapMode = createInfo.mipmapMode;
+	key.addressModeU = createInfo.addressModeU;
+	key.addressModeV = createInfo.addressModeV;
+	key.addressModeW = createInfo.addressModeW;
+	key.mipLodBias = createInfo.mipLodBias;
+	key.anisotropyEnable = createInfo.anisotropyEnable;
+	// Fields the driver ignores are zeroed so they cannot split otherwise identical samplers
+	key.maxAnisotropy = createInfo.anisotropyEnable ? createInfo.maxAnisotropy : 0.0f;
+	key.compareEnable = createInfo.compareEnable;
+	key.compareOp = createInfo.compareEnable ? createInfo.compareOp : 0;
+	key.minLod = createInfo.minLod;
+	key.maxLod = createInfo.maxLod;
+	key.borderColor = createInfo.borderColor;
+	key.unnormalizedCoordinates = createInfo.unnormalizedCoordinates;
+	return key;
+}
+
+bool SamplerCache::Key::operator==(const Key& other) const
+{
+	return std::memcmp(this, &other, sizeof(Key)) == 0;
+}
+
+size_t SamplerCache::KeyHash::operator()(const Key& key) const
+{
+	return static_cast<size_t>(ContentHash::Hash(&key, sizeof(Key)));
+}
@@ -0,0 +1,63 @@
+#ifndef SAMPLERCACHE_H
+#define SAMPLERCACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+
+class Device;
+
+// Hands out one VkSampler per distinct sampler state. Samplers are immutable and shared, they are only
+// destroyed together with the cache, so handles stay valid in descriptor sets and set layouts.
+class SamplerCache {
+	public:
+		SamplerCache(const Device& device);
+		~SamplerCache();
+
+		SamplerCache(const SamplerCache&) = delete;
+		SamplerCache& operator=(const SamplerCache&) = delete;
+
+		VkSampler Get(const VkSamplerCreateInfo& createInfo);
+
+		// Trilinear, repeating and with the highest anisotropy the device allows. The LOD range is left
+		// unclamped, so the same sampler works for textures with any number of mip levels.
+		VkSamplerCreateInfo DefaultCreateInfo() const;
+		inline VkSampler GetDefault() { return Get(DefaultCreateInfo()); }
+
+		inline size_t size() const { return m_samplers.size(); }
+
+	private:
+		// Every VkSamplerCreateInfo field that affects sampling, all 4 bytes wide so the key has no padding
+		struct Key {
+			uint32_t flags;
+			uint32_t magFilter;
+			uint32_t minFilter;
+			uint32_t mipmapMode;
+			uint32_t addressModeU;
+			uint32_t addressModeV;
+			uint32_t addressModeW;
+			float mipLodBias;
+			uint32_t anisotropyEnable;
+			float maxAnisotropy;
+			uint32_t compareEnable;
+			uint32_t compareOp;
+			float minLod;
+			float maxLod;
+			uint32_t borderColor;
+			uint32_t unnormalizedCoordinates;
+
+			bool operator==(const Key& other) const;
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		const Device& m_device;
+		float m_maxAnisotropy;
+		std::unordered_map<Key, VkSampler, KeyHash> m_samplers;
+
+		static Key MakeKey(const VkSamplerCreateInfo& createInfo);
+};
+
+#endif
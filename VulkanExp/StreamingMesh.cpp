@@ -0,0 +1,424 @@
+#include "StreamingMesh.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+#include "CommandBuffers.h"
+#include "CommandPool.h"
+#include "CpuProfiler.h"
+#include "Device.h"
+#include "GpuTimeline.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "Vertex.h"
+
+StreamingMesh::StreamingMesh(const Device& device, CommandPool& commandPool, GpuTimeline& timeline, const std::string& packagePath, VkDeviceSize poolSize)
+	: m_device(device), m_commandPool(commandPool), m_timeline(timeline), m_path(packagePath)
+{
+	ReadChunkTable();
+
+	VkDeviceSize slotVertexBytes = static_cast<VkDeviceSize>(m_slotVertices) * sizeof(Vertex);
+	VkDeviceSize slotIndexBytes = static_cast<VkDeviceSize>(m_slotIndices) * sizeof(uint16_t);
+	// More than both versions of every chunk is never needed
+	VkDeviceSize slotCount = std::min<VkDeviceSize>(std::max<VkDeviceSize>(1, poolSize / (slotVertexBytes + slotIndexBytes)), m_chunks.size() * 2);
+	m_slots.resize(static_cast<size_t>(slotCount));
+	m_stats.chunkCount = static_cast<uint32_t>(m_chunks.size());
+	m_stats.slotCount = static_cast<uint32_t>(slotCount);
+
+	Model::CreateBuffer(slotCount * slotVertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexMemory, device, MemoryCategory::Vertex);
+	Model::CreateBuffer(slotCount * slotIndexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexMemory, device, MemoryCategory::Index);
+
+	// Vertices at the start of a staging buffer, indices right after the slot's vertex capacity
+	m_staging.resize(StagingCount);
+	for (Staging& staging : m_staging) {
+		Model::CreateBuffer(slotVertexBytes + slotIndexBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.memory, device, MemoryCategory::Staging);
+		void* mapped;
+		if (vkMapMemory(device.logical(), staging.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map chunk staging buffer!");
+		}
+		staging.mapped = static_cast<uint8_t*>(mapped);
+	}
+
+	m_reader = std::thread(&StreamingMesh::ReaderLoop, this);
+}
+
+StreamingMesh::~StreamingMesh()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_one();
+	m_reader.join();
+
+	// Freeing the memory unmaps the staging buffers
+	for (Staging& staging : m_staging) {
+		m_timeline.RetireBuffer(staging.buffer, staging.memory);
+	}
+	m_timeline.RetireBuffer(m_indexBuffer, m_indexMemory);
+	m_timeline.RetireBuffer(m_vertexBuffer, m_vertexMemory);
+}
+
+bool StreamingMesh::IsStreamed(const std::string& packagePath)
+{
+	std::ifstream file(packagePath, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	try {
+		PackageHeader header;
+		std::vector<PackageSectionEntry> sections;
+		AssetPackage::ReadTable(file, packagePath, header, sections);
+		return std::any_of(sections.begin(), sections.end(), [](const PackageSectionEntry& section) { return section.type == PackageSection::ChunkTable; });
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+void StreamingMesh::ReadChunkTable()
+{
+	std::ifstream file(m_path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + m_path);
+	}
+
+	PackageHeader header;
+	std::vector<PackageSectionEntry> sections;
+	AssetPackage::ReadTable(file, m_path, header, sections);
+
+	const PackageSectionEntry* table = nullptr;
+	const PackageSectionEntry* vertices = nullptr;
+	const PackageSectionEntry* indices = nullptr;
+	for (const PackageSectionEntry& section : sections) {
+		if (section.type == PackageSection::ChunkTable) {
+			table = &section;
+		}
+		else if (section.type == PackageSection::ChunkVertices) {
+			vertices = &section;
+		}
+		else if (section.type == PackageSection::ChunkIndices) {
+			indices = &section;
+		}
+		else if (section.type == PackageSection::TextureLevel) {
+			m_texture.levels.push_back(section);
+		}
+	}
+	// The cooker writes the levels in mip order, sorted anyway since count is all that says which level is which
+	std::sort(m_texture.levels.begin(), m_texture.levels.end(), [](const PackageSectionEntry& a, const PackageSectionEntry& b) { return a.count < b.count; });
+	m_texture.path = m_path;
+	m_texture.contentHash = header.contentHash;
+	if (!table || !vertices || !indices) {
+		throw std::runtime_error("asset package holds no streamed mesh, cook it with -c: " + m_path);
+	}
+	if (table->size != static_cast<uint64_t>(table->count) * sizeof(PackageChunk) || table->count == 0) {
+		throw std::runtime_error("asset package chunk table is corrupt: " + m_path);
+	}
+
+	m_chunks.resize(table->count);
+	file.seekg(static_cast<std::streamoff>(table->offset));
+	if (!file.read(reinterpret_cast<char*>(m_chunks.data()), static_cast<std::streamsize>(table->size))) {
+		throw std::runtime_error("asset package is truncated: " + m_path);
+	}
+	m_vertexSectionOffset = vertices->offset;
+	m_indexSectionOffset = indices->offset;
+
+	for (const PackageChunk& chunk : m_chunks) {
+		// Summed in 64 bits, a corrupt offset must not wrap around and pass
+		if (std::max(uint64_t(chunk.vertexOffset) + chunk.vertexCount, uint64_t(chunk.lodVertexOffset) + chunk.lodVertexCount) > vertices->count
+			|| std::max(uint64_t(chunk.indexOffset) + chunk.indexCount, uint64_t(chunk.lodIndexOffset) + chunk.lodIndexCount) > indices->count) {
+			throw std::runtime_error("asset package chunk table is corrupt: " + m_path);
+		}
+		m_slotVertices = std::max(m_slotVertices, std::max(chunk.vertexCount, chunk.lodVertexCount));
+		m_slotIndices = std::max(m_slotIndices, std::max(chunk.indexCount, chunk.lodIndexCount));
+	}
+	// Slots are sized by the largest chunk, one without geometry would make them empty
+	if (m_slotVertices == 0 || m_slotIndices == 0) {
+		throw std::runtime_error("asset package streamed mesh has no geometry: " + m_path);
+	}
+}
+
+void StreamingMesh::Update(const glm::mat4& view, const glm::mat4& projection, const glm::mat4& model)
+{
+	CpuZone zone("stream chunks");
+	m_update++;
+	UploadFinished();
+
+	glm::mat4 modelView = view * model;
+	glm::vec3 eye = glm::vec3(glm::inverse(modelView)[3]);
+	glm::mat4 clip = projection * modelView;
+
+	// Frustum planes in model space from the rows of the clip matrix, depth runs from 0 so near is the third row alone
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+	}
+	const glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+
+	struct Candidate {
+		uint32_t chunk;
+		float distance;
+		bool coarse;
+		bool inside;
+	};
+	// Every chunk is tested on its own, so the tests are spread over the job system and compacted afterwards
+	std::vector<Candidate> tested(m_chunks.size());
+	JobSystem::Instance().ParallelFor(m_chunks.size(), CullGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const PackageChunk& chunk = m_chunks[i];
+			glm::vec3 low(chunk.boundsMin[0], chunk.boundsMin[1], chunk.boundsMin[2]);
+			glm::vec3 high(chunk.boundsMax[0], chunk.boundsMax[1], chunk.boundsMax[2]);
+			glm::vec3 center = (low + high) * 0.5f;
+			glm::vec3 halfExtent = (high - low) * 0.5f;
+
+			Candidate& candidate = tested[i];
+			candidate.chunk = static_cast<uint32_t>(i);
+			candidate.inside = true;
+			for (const glm::vec4& plane : planes) {
+				glm::vec3 normal(plane);
+				if (glm::dot(normal, center) + glm::dot(glm::abs(normal), halfExtent) + plane.w < 0.0f) {
+					candidate.inside = false;
+					break;
+				}
+			}
+
+			candidate.distance = glm::length(glm::max(glm::abs(eye - center) - halfExtent, glm::vec3(0.0f)));
+			candidate.coarse = candidate.distance > DetailDistance * glm::length(halfExtent);
+		}
+	});
+
+	std::vector<Candidate> visible;
+	for (const Candidate& candidate : tested) {
+		if (candidate.inside) {
+			visible.push_back(candidate);
+		}
+	}
+	std::sort(visible.begin(), visible.end(), [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+
+	// Everything drawn is marked before requesting, so requests never evict a slot this frame draws
+	m_draws.clear();
+	m_drawnSlots.clear();
+	m_stats.visibleChunks = static_cast<uint32_t>(visible.size());
+	m_stats.coarseChunks = 0;
+	m_stats.missingChunks = 0;
+	std::vector<uint32_t> missing;
+	for (const Candidate& candidate : visible) {
+		uint32_t wanted = candidate.chunk * 2 + (candidate.coarse ? 1 : 0);
+		auto found = m_slotOf.find(wanted);
+		if (found == m_slotOf.end() || m_slots[found->second].state != SlotState::Resident) {
+			missing.push_back(wanted);
+			// The other version stands in until the wanted one arrives
+			found = m_slotOf.find(wanted ^ 1);
+			if (found == m_slotOf.end() || m_slots[found->second].state != SlotState::Resident) {
+				m_stats.missingChunks++;
+				continue;
+			}
+		}
+
+		uint32_t slotIndex = found->second;
+		Slot& slot = m_slots[slotIndex];
+		slot.lastDrawn = m_update;
+		m_drawnSlots.push_back(slotIndex);
+		if (slot.key & 1) {
+			m_stats.coarseChunks++;
+		}
+
+		VkDrawIndexedIndirectCommand draw{};
+		draw.indexCount = slot.indexCount;
+		draw.instanceCount = 1;
+		draw.firstIndex = slotIndex * m_slotIndices;
+		draw.vertexOffset = static_cast<int32_t>(slotIndex * m_slotVertices);
+		draw.firstInstance = 0;
+		m_draws.push_back(draw);
+	}
+	m_stats.drawnChunks = static_cast<uint32_t>(m_draws.size());
+
+	for (uint32_t key : missing) {
+		if (m_slotOf.count(key)) {
+			continue;
+		}
+		if (!Request(key)) {
+			break;
+		}
+	}
+}
+
+void StreamingMesh::Submitted(uint64_t value)
+{
+	for (uint32_t slot : m_drawnSlots) {
+		m_slots[slot].lastUsed = value;
+	}
+}
+
+void StreamingMesh::Report(std::ostream& out) const
+{
+	std::ios format(nullptr);
+	format.copyfmt(out);
+	out << "streaming: " << m_stats.visibleChunks << " of " << m_stats.chunkCount << " chunks visible, " << m_stats.drawnChunks << " drawn ("
+		<< m_stats.coarseChunks << " coarse), " << m_stats.missingChunks << " missing; " << m_stats.slotCount << " slots, " << m_stats.loads << " loads, "
+		<< m_stats.evictions << " evictions, " << std::fixed << std::setprecision(1) << m_stats.bytesStreamed / (1024.0 * 1024.0) << " MB read" << std::endl;
+	out.copyfmt(format);
+}
+
+void StreamingMesh::ReaderLoop()
+{
+	CpuProfiler::SetThreadName("chunk reader");
+	std::ifstream file(m_path, std::ios::binary);
+	VkDeviceSize indexStart = static_cast<VkDeviceSize>(m_slotVertices) * sizeof(Vertex);
+
+	for (;;) {
+		ReadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stopping || !m_requests.empty(); });
+			if (m_stopping) {
+				return;
+			}
+			request = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		bool read;
+		{
+			CpuZone zone("read chunk");
+			uint8_t* target = m_staging[request.staging].mapped;
+			read = file.seekg(static_cast<std::streamoff>(request.vertexOffset))
+				&& file.read(reinterpret_cast<char*>(target), static_cast<std::streamsize>(request.vertexSize))
+				&& file.seekg(static_cast<std::streamoff>(request.indexOffset))
+				&& file.read(reinterpret_cast<char*>(target + indexStart), static_cast<std::streamsize>(request.indexSize));
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!read) {
+			m_readError = "failed to read mesh chunk from " + m_path;
+		}
+		m_finished.push_back(request);
+	}
+}
+
+void StreamingMesh::UploadFinished()
+{
+	std::vector<ReadRequest> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_readError.empty()) {
+			throw std::runtime_error(m_readError);
+		}
+		finished.swap(m_finished);
+	}
+	if (finished.empty()) {
+		return;
+	}
+
+	// Every read that finished since the last frame goes up in one submit
+	VkDeviceSize slotVertexBytes = static_cast<VkDeviceSize>(m_slotVertices) * sizeof(Vertex);
+	VkDeviceSize slotIndexBytes = static_cast<VkDeviceSize>(m_slotIndices) * sizeof(uint16_t);
+	VkCommandBuffer commandBuffer = CommandBuffers::BeginSingleTimeCommands(m_device, m_commandPool, m_timeline, "chunk upload");
+	for (const ReadRequest& request : finished) {
+		VkBufferCopy vertexCopy{};
+		vertexCopy.srcOffset = 0;
+		vertexCopy.dstOffset = request.slot * slotVertexBytes;
+		vertexCopy.size = request.vertexSize;
+		vkCmdCopyBuffer(commandBuffer, m_staging[request.staging].buffer, m_vertexBuffer, 1, &vertexCopy);
+
+		VkBufferCopy indexCopy{};
+		indexCopy.srcOffset = slotVertexBytes;
+		indexCopy.dstOffset = request.slot * slotIndexBytes;
+		indexCopy.size = request.indexSize;
+		vkCmdCopyBuffer(commandBuffer, m_staging[request.staging].buffer, m_indexBuffer, 1, &indexCopy);
+	}
+	// The next frame's submit waits for the upload, so the slots can be drawn right away
+	uint64_t uploaded = CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool, m_timeline);
+
+	for (const ReadRequest& request : finished) {
+		Staging& staging = m_staging[request.staging];
+		staging.busy = false;
+		staging.uploaded = uploaded;
+
+		Slot& slot = m_slots[request.slot];
+		slot.state = SlotState::Resident;
+		// Not reusable before the copy into it is done either
+		slot.lastUsed = uploaded;
+		m_stats.loads++;
+		m_stats.bytesStreamed += request.vertexSize + request.indexSize;
+	}
+}
+
+bool StreamingMesh::Request(uint32_t key)
+{
+	uint32_t stagingIndex = FindStaging();
+	if (stagingIndex == UINT32_MAX) {
+		return false;
+	}
+	uint32_t slotIndex = FindSlot();
+	if (slotIndex == UINT32_MAX) {
+		return false;
+	}
+
+	Slot& slot = m_slots[slotIndex];
+	if (slot.state == SlotState::Resident) {
+		m_slotOf.erase(slot.key);
+		m_stats.evictions++;
+	}
+
+	const PackageChunk& chunk = m_chunks[key / 2];
+	bool coarse = (key & 1) != 0;
+	uint32_t vertexOffset = coarse ? chunk.lodVertexOffset : chunk.vertexOffset;
+	uint32_t vertexCount = coarse ? chunk.lodVertexCount : chunk.vertexCount;
+	uint32_t indexOffset = coarse ? chunk.lodIndexOffset : chunk.indexOffset;
+	uint32_t indexCount = coarse ? chunk.lodIndexCount : chunk.indexCount;
+
+	slot.state = SlotState::Loading;
+	slot.key = key;
+	slot.indexCount = indexCount;
+	m_slotOf[key] = slotIndex;
+	m_staging[stagingIndex].busy = true;
+
+	ReadRequest request;
+	request.slot = slotIndex;
+	request.staging = stagingIndex;
+	request.vertexOffset = m_vertexSectionOffset + static_cast<uint64_t>(vertexOffset) * sizeof(Vertex);
+	request.vertexSize = static_cast<uint64_t>(vertexCount) * sizeof(Vertex);
+	request.indexOffset = m_indexSectionOffset + static_cast<uint64_t>(indexOffset) * sizeof(uint16_t);
+	request.indexSize = static_cast<uint64_t>(indexCount) * sizeof(uint16_t);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(request);
+	}
+	m_wake.notify_one();
+	return true;
+}
+
+uint32_t StreamingMesh::FindSlot()
+{
+	uint64_t completed = m_timeline.CompletedValue();
+	uint32_t oldest = UINT32_MAX;
+	for (uint32_t i = 0; i < m_slots.size(); i++) {
+		const Slot& slot = m_slots[i];
+		if (slot.state == SlotState::Free) {
+			return i;
+		}
+		if (slot.state != SlotState::Resident || slot.lastDrawn == m_update || slot.lastUsed > completed) {
+			continue;
+		}
+		if (oldest == UINT32_MAX || slot.lastDrawn < m_slots[oldest].lastDrawn) {
+			oldest = i;
+		}
+	}
+	return oldest;
+}
+
+uint32_t StreamingMesh::FindStaging()
+{
+	uint64_t completed = m_timeline.CompletedValue();
+	for (uint32_t i = 0; i < m_staging.size(); i++) {
+		if (!m_staging[i].busy && m_staging[i].uploaded <= completed) {
+			return i;
+		}
+	}
+	return UINT32_MAX;
+}
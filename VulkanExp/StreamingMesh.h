@@ -0,0 +1,159 @@
+#ifndef STREAMINGMESH_H
+#define STREAMINGMESH_H
+
+#include <vulkan/vulkan.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AssetPackage.h"
+
+class Device;
+class CommandPool;
+class GpuTimeline;
+
+struct StreamingStats {
+	uint32_t chunkCount = 0;
+	uint32_t slotCount = 0;
+	// Of the last Update
+	uint32_t visibleChunks = 0;
+	uint32_t drawnChunks = 0;
+	uint32_t coarseChunks = 0;
+	uint32_t missingChunks = 0;
+	// Over the whole run
+	uint64_t loads = 0;
+	uint64_t evictions = 0;
+	uint64_t bytesStreamed = 0;
+};
+
+// Draws a chunked package (AssetCooker -c) that does not have to fit in memory. Device memory is a fixed pool of
+// equally sized slots, each holding the full or the coarse version of one chunk; every Update culls the chunk bounds
+// against the view, picks the version by distance and requests whatever is missing, nearest first. A reader thread
+// reads the chunks straight into a small set of persistently mapped staging buffers, Update copies finished reads
+// into their slots and slots nobody drew recently are reused once the GPU is done with them. Chunks that are not
+// resident yet are drawn coarse while the coarse version is, and skipped otherwise.
+class StreamingMesh {
+	public:
+		// Reads in flight, each holds one slot's worth of host visible staging memory
+		static const uint32_t StagingCount = 8;
+		// Chunks closer than this many of their radii get full detail
+		static constexpr float DetailDistance = 4.0f;
+		// Chunks culled per job
+		static const size_t CullGrain = 1024;
+
+		// poolSize is the device memory for resident chunks, it holds at least one slot
+		StreamingMesh(const Device& device, CommandPool& commandPool, GpuTimeline& timeline, const std::string& packagePath, VkDeviceSize poolSize);
+		// Pool and staging buffers are retired on the timeline
+		~StreamingMesh();
+
+		StreamingMesh(const StreamingMesh&) = delete;
+		StreamingMesh& operator=(const StreamingMesh&) = delete;
+
+		// True if the package holds a streamed mesh, without reading more than its section table
+		static bool IsStreamed(const std::string& packagePath);
+
+		// Uploads finished reads, picks the chunks to draw for this view and requests the missing ones
+		void Update(const glm::mat4& view, const glm::mat4& projection, const glm::mat4& model);
+		// Slots drawn since the last Update stay in place until the GPU passes value
+		void Submitted(uint64_t value);
+
+		inline VkBuffer vertexBuffer() const { return m_vertexBuffer; }
+		inline VkBuffer indexBuffer() const { return m_indexBuffer; }
+		inline VkIndexType indexType() const { return VK_INDEX_TYPE_UINT16; }
+		// One draw per chunk, firstIndex and vertexOffset point into the chunk's slot
+		inline const std::vector<VkDrawIndexedIndirectCommand>& draws() const { return m_draws; }
+		inline const StreamingStats& stats() const { return m_stats; }
+		// Texture levels of the package, found with the chunk table so the package never has to be mapped
+		inline const PackageTexture& texture() const { return m_texture; }
+		void Report(std::ostream& out) const;
+
+	private:
+		enum class SlotState {
+			Free,
+			Loading,
+			Resident
+		};
+
+		struct Slot {
+			SlotState state = SlotState::Free;
+			// Chunk index * 2 + 1 for the coarse version
+			uint32_t key = 0;
+			uint32_t indexCount = 0;
+			// Update that last drew it, for least recently used eviction
+			uint64_t lastDrawn = 0;
+			// Timeline value of the last frame that drew it
+			uint64_t lastUsed = 0;
+		};
+
+		struct Staging {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			uint8_t* mapped = nullptr;
+			// Copies out of it are done once the GPU passes this value
+			uint64_t uploaded = 0;
+			bool busy = false;
+		};
+
+		struct ReadRequest {
+			uint32_t slot;
+			uint32_t staging;
+			uint64_t vertexOffset;
+			uint64_t vertexSize;
+			uint64_t indexOffset;
+			uint64_t indexSize;
+		};
+
+		const Device& m_device;
+		CommandPool& m_commandPool;
+		GpuTimeline& m_timeline;
+		std::string m_path;
+
+		std::vector<PackageChunk> m_chunks;
+		PackageTexture m_texture;
+		uint64_t m_vertexSectionOffset = 0;
+		uint64_t m_indexSectionOffset = 0;
+		uint32_t m_slotVertices = 0;
+		uint32_t m_slotIndices = 0;
+
+		VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_vertexMemory = VK_NULL_HANDLE;
+		VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_indexMemory = VK_NULL_HANDLE;
+		std::vector<Slot> m_slots;
+		// Slot of every resident or loading chunk version
+		std::unordered_map<uint32_t, uint32_t> m_slotOf;
+		std::vector<Staging> m_staging;
+
+		std::vector<VkDrawIndexedIndirectCommand> m_draws;
+		std::vector<uint32_t> m_drawnSlots;
+		uint64_t m_update = 0;
+		StreamingStats m_stats;
+
+		// Shared with the reader thread
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::deque<ReadRequest> m_requests;
+		std::vector<ReadRequest> m_finished;
+		std::string m_readError;
+		bool m_stopping = false;
+		std::thread m_reader;
+
+		void ReadChunkTable();
+		void ReaderLoop();
+		void UploadFinished();
+		// Returns false once no staging buffer or slot is left for this Update
+		bool Request(uint32_t key);
+		// Returns UINT32_MAX if every slot is in use
+		uint32_t FindSlot();
+		uint32_t FindStaging();
+};
+
+#endif
@@ -1,31 +1,47 @@
 #include "SwapChain.h"
 
 #include "Device.h"
+#include "GpuTimeline.h"
 #include "Window.h"
 #include <iostream>
 #include <algorithm>
 
-SwapChain::SwapChain(const Device& device, const Window& window)
+SwapChain::SwapChain(const Device& device, const Window& window, VkPresentModeKHR preferredPresentMode)
 	: m_swapChain(VK_NULL_HANDLE),
 	m_extent(),
 	m_imageFormat(),
+	m_preferredPresentMode(preferredPresentMode),
+	m_presentMode(VK_PRESENT_MODE_FIFO_KHR),
 	m_device(device),
 	m_window(window) {
 	createSwapChain();
 	createImageViews();
 }
 
-void SwapChain::recreate() {
-	destroyImageViews();
+void SwapChain::recreate(GpuTimeline& timeline) {
+	VkSwapchainKHR oldSwapChain = m_swapChain;
+	std::vector<VkImageView> oldImageViews = m_imageViews;
+
+	// createSwapChain passes the current handle as oldSwapchain, so images the old one still presents stay valid
 	createSwapChain();
 	createImageViews();
+
+	// Presents of the old swap chain are queued before the first frame on the new one,
+	// so once that frame is done on the GPU nothing uses the old images any more
+	VkDevice device = m_device.logical();
+	timeline.Retire(timeline.lastSubmitted() + 1, [device, oldSwapChain, oldImageViews]() {
+		for (VkImageView view : oldImageViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+	});
 }
 
 void SwapChain::createSwapChain() {
 
 	m_supportDetails = QuerySwapChainSupport(m_device.physical(), m_window.surface());
 	VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(m_supportDetails.formats);
-	VkPresentModeKHR presentMode = ChooseSwapPresentMode(m_supportDetails.presentModes);
+	m_presentMode = ChooseSwapPresentMode(m_supportDetails.presentModes, m_preferredPresentMode);
 	m_extent = ChooseSwapExtent(m_supportDetails.capabilities, m_window);
 
 
@@ -64,8 +80,9 @@ void SwapChain::createSwapChain() {
 
 	createInfo.preTransform = m_supportDetails.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	createInfo.presentMode = presentMode;
+	createInfo.presentMode = m_presentMode;
 	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = m_swapChain;
 
 	if (vkCreateSwapchainKHR(m_device.logical(), &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create swap chain! :((((");
@@ -94,12 +111,12 @@ VkSurfaceFormatKHR SwapChain::ChooseSwapSurfaceFormat(
 }
 
 VkPresentModeKHR SwapChain::ChooseSwapPresentMode(
-	const std::vector<VkPresentModeKHR>& availablePresentModes) {
-	// Try to find support for Mailbox
+	const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferredPresentMode) {
 	// MAILBOX (triple buffering) uses a queue to present images,
-	// and if the queue is full already queued images are overwritten with newer images
+	// and if the queue is full already queued images are overwritten with newer images.
+	// IMMEDIATE doesn't wait for vblank at all and FIFO_RELAXED only when the app keeps up
 	for (const auto& availablePresentMode : availablePresentModes) {
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+		if (availablePresentMode == preferredPresentMode) {
 			return availablePresentMode;
 		}
 	}
@@ -139,6 +156,7 @@ void SwapChain::destroyImageViews() {
 void SwapChain::destroySwapChain()
 {
 	vkDestroySwapchainKHR(m_device.logical(), m_swapChain, nullptr);
+	m_swapChain = VK_NULL_HANDLE;
 }
 
 SwapChain::~SwapChain() {
@@ -5,8 +5,11 @@
 
 #include <vector>
 
+#include "RenderTarget.h"
+
 class Device;
 class Window;
+class GpuTimeline;
 
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
@@ -14,21 +17,27 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
-class SwapChain {
+class SwapChain : public RenderTarget {
 	public:
-		explicit SwapChain(const Device& device, const Window& window);
+		// preferredPresentMode falls back to FIFO, the only mode every surface supports
+		explicit SwapChain(const Device& device, const Window& window, VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR);
 		~SwapChain();
 
-		auto recreate() -> void;
+		// Creates the new swap chain from the old one without waiting for the GPU, the old swap chain and its
+		// image views are retired on the timeline
+		void recreate(GpuTimeline& timeline);
 
 		inline const VkSwapchainKHR& handle() const { return m_swapChain; }
-		inline const VkFormat& imageFormat() const { return m_imageFormat; }
-		inline const VkExtent2D& extent() const { return m_extent; }
-		inline size_t numImages() const { return m_images.size(); }
+		inline const VkFormat& imageFormat() const override { return m_imageFormat; }
+		inline const VkExtent2D& extent() const override { return m_extent; }
+		// Mode the swap chain was actually created with
+		inline VkPresentModeKHR presentMode() const { return m_presentMode; }
+		inline size_t numImages() const override { return m_images.size(); }
 		inline size_t numImageViews() const { return m_imageViews.size(); }
 
 		inline const SwapChainSupportDetails& supportDetails() const { return m_supportDetails; }
-		inline VkImageView imageView(uint32_t index) const { return m_imageViews[index]; }
+		inline VkImageView imageView(uint32_t index) const override { return m_imageViews[index]; }
+		inline VkImageLayout finalLayout() const override { return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
 
 		static SwapChainSupportDetails QuerySwapChainSupport(const VkPhysicalDevice& device, const VkSurfaceKHR& surface);
 		static VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, const Window& window);
@@ -53,9 +62,11 @@ class SwapChain {
 
 		VkFormat m_imageFormat;
 		VkExtent2D m_extent;
+		VkPresentModeKHR m_preferredPresentMode;
+		VkPresentModeKHR m_presentMode;
 
 		static VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-		static VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+		static VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferredPresentMode);
 };
 
 #endif
\ No newline at end of file
@@ -1,24 +1,92 @@
 #include "Texture.h"
 
-#define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #include <algorithm>
+#include <fstream>
 #include <string>
 
 #include "CommandBuffers.h"
 #include "CommandPool.h"
+#include "CpuProfiler.h"
 #include "Device.h"
+#include "GpuTimeline.h"
 #include "Model.h"
+#include "SamplerCache.h"
 
-const std::string TEXTURE_PATH = "../textures/viking_room.png";
+Texture::Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const std::string& imagePath, MipGeneration mipGeneration, MipFilter mipFilter) : m_device(device), m_commandPool(commandPool), m_timeline(timeline)
+{
+	TextureData compressed;
+	if (TextureData::LoadCompressed(imagePath, compressed) && IsFormatSupported(compressed.format)) {
+		// Block compressed textures ship with their mip chain, so there is nothing to decode or blit
+		UploadLevels(compressed);
+	}
+	else {
+		LoadUncompressed(imagePath, mipGeneration, mipFilter);
+	}
+
+	//Create texture img view
+	m_textureImageView = CreateImageView(m_textureImage, m_format, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+
+	// Owned by the cache and shared with every other texture
+	m_textureSampler = samplerCache.GetDefault();
+}
+
+Texture::Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const AssetPackage& package) : m_device(device), m_commandPool(commandPool), m_timeline(timeline)
+{
+	std::vector<PackageSectionEntry> sections;
+	for (const PackageSectionEntry* section = package.FindSection(PackageSection::TextureLevel, 0); section; section = package.FindSection(PackageSection::TextureLevel, static_cast<uint32_t>(sections.size()))) {
+		sections.push_back(*section);
+	}
+
+	// Read from the file into staging, the package's mapping is never touched
+	UploadPackageLevels(sections, [&package](const PackageSectionEntry& chain, void* destination) { package.ReadSection(chain, destination); });
+
+	m_textureImageView = CreateImageView(m_textureImage, m_format, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+
+	// Owned by the cache and shared with every other texture
+	m_textureSampler = samplerCache.GetDefault();
+}
 
-Texture::Texture(const Device& device, CommandPool& commandPool) : m_device(device), m_commandPool(commandPool)
+Texture::Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const PackageTexture& texture) : m_device(device), m_commandPool(commandPool), m_timeline(timeline)
 {
+	UploadPackageLevels(texture.levels, [&texture](const PackageSectionEntry& chain, void* destination) {
+		std::ifstream file(texture.path, std::ios::binary);
+		file.seekg(static_cast<std::streamoff>(chain.offset));
+		if (!file.read(static_cast<char*>(destination), static_cast<std::streamsize>(chain.size))) {
+			throw std::runtime_error("asset package is truncated: " + texture.path);
+		}
+	});
+
+	m_textureImageView = CreateImageView(m_textureImage, m_format, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+
+	// Owned by the cache and shared with every other texture
+	m_textureSampler = samplerCache.GetDefault();
+}
+
+Texture::~Texture()
+{
+	m_timeline.RetireImage(m_textureImage, m_textureImageView, m_textureImageMemory);
+}
+
+void Texture::LoadUncompressed(const std::string& imagePath, MipGeneration mipGeneration, MipFilter mipFilter) {
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_device.physical(), VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+	bool canBlit = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+	if (mipGeneration == MipGeneration::Cpu || !canBlit) {
+		TextureData textureData;
+		MipGenerator::DecodeImage(imagePath, textureData);
+		MipGenerator::GenerateMipChain(textureData, mipFilter);
+		UploadLevels(textureData);
+		return;
+	}
+
 	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	stbi_uc* pixels = stbi_load(imagePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 	m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	m_format = VK_FORMAT_R8G8B8A8_SRGB;
 
 	if (!pixels) {
 		throw std::runtime_error("failed to load texture image!");
@@ -26,7 +94,7 @@ Texture::Texture(const Device& device, CommandPool& commandPool) : m_device(devi
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
-	Model::CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device);
+	Model::CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device, MemoryCategory::Staging);
 
 	void* data;
 	vkMapMemory(m_device.logical(), stagingBufferMemory, 0, imageSize, 0, &data);
@@ -35,54 +103,106 @@ Texture::Texture(const Device& device, CommandPool& commandPool) : m_device(devi
 
 	stbi_image_free(pixels);
 
-	CreateImage(texWidth, texHeight, m_mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage, m_textureImageMemory);
+	CreateImage(texWidth, texHeight, m_mipLevels, m_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage, m_textureImageMemory);
 
-	TransitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
+	TransitionImageLayout(m_textureImage, m_format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
 	CopyBufferToImage(stagingBuffer, m_textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 	//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
 
 	vkDestroyBuffer(m_device.logical(), stagingBuffer, nullptr);
-	vkFreeMemory(m_device.logical(), stagingBufferMemory, nullptr);
+	m_device.memory().Free(stagingBufferMemory);
 
-	GenerateMipmaps(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_mipLevels);
+	GenerateMipmaps(m_textureImage, m_format, texWidth, texHeight, m_mipLevels);
+}
 
-	//Create texture img view
-	m_textureImageView = CreateImageView(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
-
-	//Create Texture Sampler
-	VkPhysicalDeviceProperties properties{};
-	vkGetPhysicalDeviceProperties(m_device.physical(), &properties);
-
-	VkSamplerCreateInfo samplerInfo{};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_TRUE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(m_mipLevels);
-	samplerInfo.mipLodBias = 0.0f;
-
-	if (vkCreateSampler(m_device.logical(), &samplerInfo, nullptr, &m_textureSampler) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create texture sampler!");
+void Texture::UploadPackageLevels(const std::vector<PackageSectionEntry>& sections, const std::function<void(const PackageSectionEntry&, void*)>& read) {
+	if (sections.empty()) {
+		throw std::runtime_error("asset package has no texture!");
+	}
+	const PackageSectionEntry& first = sections[0];
+
+	// The cooker writes levels back to back, so the chain is one contiguous range of the file
+	std::vector<MipLevel> levels;
+	size_t end = 0;
+	for (const PackageSectionEntry& section : sections) {
+		MipLevel level;
+		level.width = section.width;
+		level.height = section.height;
+		level.offset = static_cast<size_t>(section.offset - first.offset);
+		level.size = static_cast<size_t>(section.size);
+		levels.push_back(level);
+		end = level.offset + level.size;
 	}
+
+	VkFormat format = static_cast<VkFormat>(first.format);
+	if (!IsFormatSupported(format)) {
+		throw std::runtime_error("texture format of the asset package is not supported by this device!");
+	}
+
+	PackageSectionEntry chain = first;
+	chain.size = end;
+	UploadLevels(format, first.width, first.height, levels, end, [&read, &chain](void* destination) { read(chain, destination); });
 }
 
-Texture::~Texture()
-{
-	vkDestroySampler(m_device.logical(), m_textureSampler, nullptr);
-	vkDestroyImageView(m_device.logical(), m_textureImageView, nullptr);
+void Texture::UploadLevels(const TextureData& textureData) {
+	UploadLevels(textureData.format, textureData.width, textureData.height, textureData.levels, textureData.pixels.size(),
+		[&textureData](void* destination) { memcpy(destination, textureData.pixels.data(), textureData.pixels.size()); });
+}
+
+void Texture::UploadLevels(VkFormat format, uint32_t width, uint32_t height, const std::vector<MipLevel>& levels, size_t pixelsSize, const std::function<void(void*)>& write) {
+	CpuZone zone("upload texture");
+	m_format = format;
+	m_mipLevels = static_cast<uint32_t>(levels.size());
+	VkDeviceSize imageSize = pixelsSize;
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	Model::CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, m_device, MemoryCategory::Staging);
 
-	vkDestroyImage(m_device.logical(), m_textureImage, nullptr);
-	vkFreeMemory(m_device.logical(), m_textureImageMemory, nullptr);
+	void* data;
+	vkMapMemory(m_device.logical(), stagingBufferMemory, 0, imageSize, 0, &data);
+	write(data);
+	vkUnmapMemory(m_device.logical(), stagingBufferMemory);
+
+	CreateImage(width, height, m_mipLevels, m_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage, m_textureImageMemory);
+
+	std::vector<VkBufferImageCopy> regions(m_mipLevels);
+	for (uint32_t i = 0; i < m_mipLevels; i++) {
+		const MipLevel& level = levels[i];
+		regions[i] = {};
+		regions[i].bufferOffset = level.offset;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.baseArrayLayer = 0;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageOffset = { 0, 0, 0 };
+		regions[i].imageExtent = { level.width, level.height, 1 };
+	}
+
+	// All levels go up in a single submit
+	VkCommandBuffer commandBuffer = CommandBuffers::BeginSingleTimeCommands(m_device, m_commandPool, m_timeline, "texture upload");
+	RecordLayoutTransition(commandBuffer, m_textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, m_textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	RecordLayoutTransition(commandBuffer, m_textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_mipLevels);
+	uint64_t uploaded = CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool, m_timeline);
+
+	const Device* device = &m_device;
+	m_timeline.Retire(uploaded, [device, stagingBuffer, stagingBufferMemory]() {
+		vkDestroyBuffer(device->logical(), stagingBuffer, nullptr);
+		device->memory().Free(stagingBufferMemory);
+	});
+}
+
+bool Texture::IsFormatSupported(VkFormat format) const {
+	if (TextureData::BlockSize(format) != 0 && !m_device.enabledFeatures().textureCompressionBC) {
+		return false;
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_device.physical(), format, &formatProperties);
+
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
 }
 
 void Texture::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
@@ -108,21 +228,19 @@ void Texture::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, V
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(m_device.logical(), image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = Model::FindMemoryType(memRequirements.memoryTypeBits, properties, m_device);
-
-	if (vkAllocateMemory(m_device.logical(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	imageMemory = m_device.memory().Allocate(memRequirements, properties, MemoryCategory::Texture);
+	m_memorySize = memRequirements.size;
 
 	vkBindImageMemory(m_device.logical(), image, imageMemory, 0);
 }
 
 void Texture::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 	VkCommandBuffer commandBuffer = CommandBuffers::BeginSingleTimeCommands(m_device, m_commandPool);
+	RecordLayoutTransition(commandBuffer, image, oldLayout, newLayout, mipLevels);
+	CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool);
+}
 
+void Texture::RecordLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -165,8 +283,6 @@ void Texture::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayou
 		0, nullptr,
 		1, &barrier
 	);
-
-	CommandBuffers::EndSingleTimeCommands(commandBuffer, m_device, m_commandPool);
 }
 
 void Texture::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
@@ -2,31 +2,66 @@
 #define TEXTURE_H
 
 #include <vulkan/vulkan.h>
+#include <functional>
+#include <string>
 
 #include "CommandPool.h"
 #include "Device.h"
+#include "TextureData.h"
+#include "AssetPackage.h"
+#include "MipGenerator.h"
+#include "SamplerCache.h"
+
+class GpuTimeline;
+
+enum class MipGeneration {
+	// Whole chain filtered on the CPU and uploaded with one copy, works for every format
+	Cpu,
+	// One vkCmdBlitImage per level, needs linear filtering support for the format
+	GpuBlit
+};
 
 class Texture {
 	public:
-		Texture(const Device& device, CommandPool& commandPool);
+		// Prefers a pre-compressed .ktx2/.dds file next to imagePath and falls back to decoding imagePath itself
+		Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const std::string& imagePath, MipGeneration mipGeneration = MipGeneration::Cpu, MipFilter mipFilter = MipFilter::Box);
+		// Uploads the texture levels of a cooked package straight from the mapped file
+		Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const AssetPackage& package);
+		// Same for a package that is not mapped, the levels are read from texture.path
+		Texture(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, const PackageTexture& texture);
+		// The image is retired on the timeline, frames still sampling it keep it alive
 		~Texture();
 
 		inline const VkImageView imageView() { return m_textureImageView; }
 		inline const VkSampler sampler() { return m_textureSampler; }
+		// Device memory backing the image, all mip levels included
+		inline VkDeviceSize memorySize() const { return m_memorySize; }
 
 	private:
 
 		VkImage m_textureImage;
+		VkFormat m_format;
 		uint32_t m_mipLevels;
 		VkDeviceMemory m_textureImageMemory;
+		VkDeviceSize m_memorySize = 0;
 		VkImageView m_textureImageView;
 		VkSampler m_textureSampler;
 
-		CommandPool m_commandPool;
-		Device m_device;
+		CommandPool& m_commandPool;
+		const Device& m_device;
+		GpuTimeline& m_timeline;
+
+		void LoadUncompressed(const std::string& imagePath, MipGeneration mipGeneration, MipFilter mipFilter);
+		// read fills its destination with the chain section, one range covering every level
+		void UploadPackageLevels(const std::vector<PackageSectionEntry>& sections, const std::function<void(const PackageSectionEntry&, void*)>& read);
+		void UploadLevels(const TextureData& textureData);
+		// write fills the pixelsSize bytes of staging memory it is given with every level
+		void UploadLevels(VkFormat format, uint32_t width, uint32_t height, const std::vector<MipLevel>& levels, size_t pixelsSize, const std::function<void(void*)>& write);
+		bool IsFormatSupported(VkFormat format) const;
 
 		void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
 		void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+		static void RecordLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 		void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 		void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 		VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
@@ -0,0 +1,188 @@
+#include "TextureCache.h"
+
+#include <stdexcept>
+
+#include <climits>
+#include <cstdlib>
+#include <iterator>
+
+#include "ContentHash.h"
+#include "MemoryTracker.h"
+#include "TextureData.h"
+
+namespace {
+	// Keeps package keys apart from file content hashes
+	const uint64_t PackageSeed = 0x9E3779B97F4A7C15ULL;
+}
+
+TextureCache::TextureCache(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, VkDeviceSize budget) : m_device(device), m_commandPool(commandPool), m_samplerCache(samplerCache), m_timeline(timeline), m_budget(budget)
+{
+	m_reclaimer = device.memory().AddReclaimer([this]() { return EvictLeastRecent(); });
+}
+
+TextureCache::~TextureCache()
+{
+	m_device.memory().RemoveReclaimer(m_reclaimer);
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const std::string& imagePath)
+{
+	std::string path = CanonicalPath(imagePath);
+
+	uint64_t key;
+	auto known = m_pathHashes.find(path);
+	if (known != m_pathHashes.end()) {
+		key = known->second;
+	}
+	else {
+		// Texture prefers a compressed sibling, so that is the file whose content identifies the texture
+		std::string compressedPath = TextureData::FindCompressed(path);
+		key = ContentHash::HashFile(compressedPath.empty() ? path : compressedPath);
+		m_pathHashes.emplace(path, key);
+	}
+
+	// Also hits when the same content was loaded through another path
+	std::shared_ptr<Texture> texture = Find(key);
+	if (texture) {
+		return texture;
+	}
+
+	m_misses++;
+	return Insert(key, std::make_shared<Texture>(m_device, m_commandPool, m_samplerCache, m_timeline, path));
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const AssetPackage& package)
+{
+	uint64_t packageHash = package.contentHash();
+	uint64_t key = ContentHash::Hash(&packageHash, sizeof(packageHash), PackageSeed);
+
+	std::shared_ptr<Texture> texture = Find(key);
+	if (texture) {
+		return texture;
+	}
+
+	m_misses++;
+	return Insert(key, std::make_shared<Texture>(m_device, m_commandPool, m_samplerCache, m_timeline, package));
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const PackageTexture& packageTexture)
+{
+	uint64_t key = ContentHash::Hash(&packageTexture.contentHash, sizeof(packageTexture.contentHash), PackageSeed);
+
+	std::shared_ptr<Texture> texture = Find(key);
+	if (texture) {
+		return texture;
+	}
+
+	m_misses++;
+	return Insert(key, std::make_shared<Texture>(m_device, m_commandPool, m_samplerCache, m_timeline, packageTexture));
+}
+
+void TextureCache::Trim()
+{
+	auto it = m_lru.end();
+	while (m_residentBytes > m_budget && it != m_lru.begin()) {
+		--it;
+		auto entry = m_entries.find(*it);
+		if (entry->second.texture.use_count() > 1) {
+			continue;
+		}
+		// Evict erases this node, the next iteration steps back from its successor instead
+		it = std::next(it);
+		Evict(entry);
+	}
+}
+
+bool TextureCache::EvictLeastRecent()
+{
+	for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+		auto entry = m_entries.find(*it);
+		if (entry->second.texture.use_count() == 1) {
+			Evict(entry);
+			return true;
+		}
+	}
+	return false;
+}
+
+void TextureCache::Clear()
+{
+	for (auto entry = m_entries.begin(); entry != m_entries.end();) {
+		if (entry->second.texture.use_count() > 1) {
+			++entry;
+			continue;
+		}
+		auto next = std::next(entry);
+		Evict(entry);
+		entry = next;
+	}
+}
+
+void TextureCache::setBudget(VkDeviceSize budget)
+{
+	m_budget = budget;
+	Trim();
+}
+
+TextureCacheStats TextureCache::stats() const
+{
+	TextureCacheStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.residentCount = m_entries.size();
+	stats.residentBytes = m_residentBytes;
+	return stats;
+}
+
+std::shared_ptr<Texture> TextureCache::Find(uint64_t key)
+{
+	auto entry = m_entries.find(key);
+	if (entry == m_entries.end()) {
+		return nullptr;
+	}
+
+	m_hits++;
+	m_lru.splice(m_lru.begin(), m_lru, entry->second.lru);
+	return entry->second.texture;
+}
+
+std::shared_ptr<Texture> TextureCache::Insert(uint64_t key, std::shared_ptr<Texture> texture)
+{
+	m_lru.push_front(key);
+
+	Entry entry;
+	entry.texture = texture;
+	entry.lru = m_lru.begin();
+	m_entries.emplace(key, entry);
+	m_residentBytes += texture->memorySize();
+
+	// The new texture is referenced by the caller, so it is never the one evicted here
+	Trim();
+	return texture;
+}
+
+void TextureCache::Evict(std::unordered_map<uint64_t, Entry>::iterator entry)
+{
+	m_lru.erase(entry->second.lru);
+	m_residentBytes -= entry->second.texture->memorySize();
+	m_entries.erase(entry);
+	m_evictions++;
+}
+
+std::string TextureCache::CanonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char resolved[_MAX_PATH];
+	if (_fullpath(resolved, path.c_str(), _MAX_PATH)) {
+		return resolved;
+	}
+#else
+	char resolved[PATH_MAX];
+	if (realpath(path.c_str(), resolved)) {
+		return resolved;
+	}
+#endif
+	// Missing files keep their path and fail when they are hashed
+	return path;
+}
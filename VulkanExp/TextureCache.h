@@ -0,0 +1,86 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "AssetPackage.h"
+#include "CommandPool.h"
+#include "Device.h"
+#include "SamplerCache.h"
+#include "Texture.h"
+
+struct TextureCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	size_t residentCount = 0;
+	VkDeviceSize residentBytes = 0;
+};
+
+// Shares one Texture between every user of the same file. Entries are keyed by the content hash of the file,
+// so the same image reached through different paths is uploaded once. Textures nobody holds any more stay
+// resident until the cache goes over its budget, then the least recently used ones are destroyed first.
+class TextureCache {
+	public:
+		// Also evicts unreferenced textures when a device memory allocation does not fit the device's budget
+		TextureCache(const Device& device, CommandPool& commandPool, SamplerCache& samplerCache, GpuTimeline& timeline, VkDeviceSize budget);
+		~TextureCache();
+
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		std::shared_ptr<Texture> Acquire(const std::string& imagePath);
+		// Texture stored in a cooked package, keyed by the package's content hash
+		std::shared_ptr<Texture> Acquire(const AssetPackage& package);
+		// Same key as the mapped package, so both ways of opening one package share the texture
+		std::shared_ptr<Texture> Acquire(const PackageTexture& texture);
+
+		// Destroys unreferenced textures, least recently used first, until the cache fits its budget.
+		// Callers must only drop their reference once the GPU no longer samples the texture.
+		void Trim();
+		// Destroys every unreferenced texture regardless of the budget
+		void Clear();
+
+		inline VkDeviceSize budget() const { return m_budget; }
+		void setBudget(VkDeviceSize budget);
+		TextureCacheStats stats() const;
+
+	private:
+		struct Entry {
+			std::shared_ptr<Texture> texture;
+			std::list<uint64_t>::iterator lru;
+		};
+
+		const Device& m_device;
+		CommandPool& m_commandPool;
+		SamplerCache& m_samplerCache;
+		GpuTimeline& m_timeline;
+		VkDeviceSize m_budget;
+		VkDeviceSize m_residentBytes = 0;
+
+		// Hash of every file seen so far, so repeated paths are not read again
+		std::unordered_map<std::string, uint64_t> m_pathHashes;
+		std::unordered_map<uint64_t, Entry> m_entries;
+		// Most recently used at the front
+		std::list<uint64_t> m_lru;
+
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		uint64_t m_evictions = 0;
+		uint32_t m_reclaimer;
+
+		std::shared_ptr<Texture> Find(uint64_t key);
+		std::shared_ptr<Texture> Insert(uint64_t key, std::shared_ptr<Texture> texture);
+		void Evict(std::unordered_map<uint64_t, Entry>::iterator entry);
+		// Destroys the least recently used unreferenced texture, returns false if every texture is in use
+		bool EvictLeastRecent();
+
+		static std::string CanonicalPath(const std::string& path);
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "TextureData.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "CpuProfiler.h"
+
+namespace {
+	// Offsets inside the staging buffer must be a multiple of the block size
+	const size_t LevelAlignment = 16;
+
+	std::vector<uint8_t> ReadBinaryFile(const std::string& path) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open texture file " + path);
+		}
+
+		size_t fileSize = (size_t)file.tellg();
+		std::vector<uint8_t> buffer(fileSize);
+
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+
+		return buffer;
+	}
+
+	// A full chain ends at 1x1, floor(log2(max(width, height))) + 1 levels. Counts from a file are checked against it
+	// before width >> level is ever evaluated
+	void CheckLevelCount(uint32_t width, uint32_t height, uint32_t levelCount, const std::string& path) {
+		if (width == 0 || height == 0) {
+			throw std::runtime_error("texture has no size: " + path);
+		}
+		uint32_t maxLevels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+			maxLevels++;
+		}
+		if (levelCount > maxLevels) {
+			throw std::runtime_error("texture has more mip levels than its size allows: " + path);
+		}
+	}
+
+	bool FileExists(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		return file.good();
+	}
+
+	template<typename T>
+	T Read(const std::vector<uint8_t>& file, size_t offset) {
+		if (offset + sizeof(T) > file.size()) {
+			throw std::runtime_error("texture file is truncated!");
+		}
+		T value;
+		memcpy(&value, file.data() + offset, sizeof(T));
+		return value;
+	}
+
+	// Copies the levels into TextureData::pixels, padding each to LevelAlignment
+	void AddLevel(TextureData& data, const std::vector<uint8_t>& file, size_t fileOffset, uint32_t width, uint32_t height) {
+		size_t size = TextureData::LevelSize(data.format, width, height);
+		if (fileOffset > file.size() || size > file.size() - fileOffset) {
+			throw std::runtime_error("texture file is truncated!");
+		}
+
+		MipLevel level;
+		level.width = width;
+		level.height = height;
+		level.offset = (data.pixels.size() + LevelAlignment - 1) / LevelAlignment * LevelAlignment;
+		level.size = size;
+
+		data.pixels.resize(level.offset + size);
+		memcpy(data.pixels.data() + level.offset, file.data() + fileOffset, size);
+		data.levels.push_back(level);
+	}
+
+	bool IsSupportedBlockFormat(VkFormat format) {
+		return TextureData::BlockSize(format) != 0;
+	}
+
+	VkFormat FormatFromDXGI(uint32_t dxgiFormat) {
+		switch (dxgiFormat) {
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	uint32_t FourCC(char a, char b, char c, char d) {
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+}
+
+bool TextureData::LoadCompressed(const std::string& imagePath, TextureData& data)
+{
+	std::string path = FindCompressed(imagePath);
+	if (path.empty()) {
+		return false;
+	}
+
+	if (path.compare(path.size() - 5, 5, ".ktx2") == 0) {
+		LoadKTX2(path, data);
+	}
+	else {
+		LoadDDS(path, data);
+	}
+	return true;
+}
+
+std::string TextureData::FindCompressed(const std::string& imagePath)
+{
+	size_t dot = imagePath.find_last_of('.');
+	size_t slash = imagePath.find_last_of("/\\");
+	std::string basePath = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? imagePath.substr(0, dot) : imagePath;
+
+	if (FileExists(basePath + ".ktx2")) {
+		return basePath + ".ktx2";
+	}
+	if (FileExists(basePath + ".dds")) {
+		return basePath + ".dds";
+	}
+	return std::string();
+}
+
+void TextureData::LoadKTX2(const std::string& path, TextureData& data)
+{
+	CpuZone zone("load ktx2");
+	static const uint8_t Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	std::vector<uint8_t> file = ReadBinaryFile(path);
+	if (file.size() < 80 || memcmp(file.data(), Identifier, sizeof(Identifier)) != 0) {
+		throw std::runtime_error("not a KTX2 file: " + path);
+	}
+
+	VkFormat format = static_cast<VkFormat>(Read<uint32_t>(file, 12));
+	uint32_t width = Read<uint32_t>(file, 20);
+	uint32_t height = Read<uint32_t>(file, 24);
+	uint32_t depth = Read<uint32_t>(file, 28);
+	uint32_t layerCount = Read<uint32_t>(file, 32);
+	uint32_t faceCount = Read<uint32_t>(file, 36);
+	uint32_t levelCount = Read<uint32_t>(file, 40);
+	uint32_t supercompression = Read<uint32_t>(file, 44);
+
+	if (!IsSupportedBlockFormat(format)) {
+		throw std::runtime_error("unsupported KTX2 texture format in " + path);
+	}
+	if (depth > 1 || layerCount > 1 || faceCount != 1) {
+		throw std::runtime_error("only single 2D KTX2 textures are supported: " + path);
+	}
+	if (supercompression != 0) {
+		throw std::runtime_error("supercompressed KTX2 textures are not supported: " + path);
+	}
+	if (levelCount == 0) {
+		throw std::runtime_error("KTX2 texture has no precomputed mip chain: " + path);
+	}
+	CheckLevelCount(width, height, levelCount, path);
+
+	data = TextureData();
+	data.format = format;
+	data.width = width;
+	data.height = height;
+
+	// Level index follows the 48 byte header and the 32 byte section index, level 0 is the largest
+	const size_t levelIndexOffset = 80;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		uint64_t byteOffset = Read<uint64_t>(file, levelIndexOffset + i * 24);
+		uint32_t levelWidth = std::max(1u, width >> i);
+		uint32_t levelHeight = std::max(1u, height >> i);
+		AddLevel(data, file, static_cast<size_t>(byteOffset), levelWidth, levelHeight);
+	}
+}
+
+void TextureData::LoadDDS(const std::string& path, TextureData& data)
+{
+	CpuZone zone("load dds");
+	std::vector<uint8_t> file = ReadBinaryFile(path);
+	if (file.size() < 128 || Read<uint32_t>(file, 0) != FourCC('D', 'D', 'S', ' ')) {
+		throw std::runtime_error("not a DDS file: " + path);
+	}
+
+	// DDS_HEADER starts after the magic number, DDS_PIXELFORMAT is at offset 76 inside it
+	uint32_t height = Read<uint32_t>(file, 12);
+	uint32_t width = Read<uint32_t>(file, 16);
+	// dwMipMapCount is only meaningful with DDSD_MIPMAPCOUNT set in dwFlags, writers may leave a stale value otherwise
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	uint32_t headerFlags = Read<uint32_t>(file, 8);
+	uint32_t levelCount = (headerFlags & DDSD_MIPMAPCOUNT) ? std::max(1u, Read<uint32_t>(file, 28)) : 1;
+	uint32_t pixelFormatFlags = Read<uint32_t>(file, 80);
+	uint32_t fourCC = Read<uint32_t>(file, 84);
+
+	const uint32_t DDPF_FOURCC = 0x4;
+	if (!(pixelFormatFlags & DDPF_FOURCC)) {
+		throw std::runtime_error("uncompressed DDS textures are not supported: " + path);
+	}
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	size_t dataOffset = 128;
+
+	// Legacy DDS files carry no color space, color formats are treated as sRGB like the PNG path
+	if (fourCC == FourCC('D', 'X', 'T', '1')) {
+		format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	}
+	else if (fourCC == FourCC('D', 'X', 'T', '5')) {
+		format = VK_FORMAT_BC3_SRGB_BLOCK;
+	}
+	else if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U')) {
+		format = VK_FORMAT_BC5_UNORM_BLOCK;
+	}
+	else if (fourCC == FourCC('D', 'X', '1', '0')) {
+		format = FormatFromDXGI(Read<uint32_t>(file, 128));
+		uint32_t arraySize = Read<uint32_t>(file, 140);
+		if (arraySize > 1) {
+			throw std::runtime_error("DDS texture arrays are not supported: " + path);
+		}
+		dataOffset += 20;
+	}
+
+	if (format == VK_FORMAT_UNDEFINED) {
+		throw std::runtime_error("unsupported DDS texture format in " + path);
+	}
+
+	CheckLevelCount(width, height, levelCount, path);
+
+	data = TextureData();
+	data.format = format;
+	data.width = width;
+	data.height = height;
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		uint32_t levelWidth = std::max(1u, width >> i);
+		uint32_t levelHeight = std::max(1u, height >> i);
+		AddLevel(data, file, dataOffset, levelWidth, levelHeight);
+		dataOffset += LevelSize(format, levelWidth, levelHeight);
+	}
+}
+
+uint32_t TextureData::BlockSize(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t TextureData::LevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	uint32_t blockSize = BlockSize(format);
+	if (blockSize == 0) {
+		// Uncompressed levels are always RGBA8
+		return static_cast<size_t>(width) * height * 4;
+	}
+	size_t blocksWide = std::max(1u, (width + 3) / 4);
+	size_t blocksHigh = std::max(1u, (height + 3) / 4);
+	return blocksWide * blocksHigh * blockSize;
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTUREDATA_H
+#define TEXTUREDATA_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MipLevel {
+	uint32_t width;
+	uint32_t height;
+	// Byte range of the level inside TextureData::pixels
+	size_t offset;
+	size_t size;
+};
+
+// Host side image with its complete mip chain, ready to be copied into a staging buffer as is
+struct TextureData {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<MipLevel> levels;
+	std::vector<uint8_t> pixels;
+
+	// Looks for a .ktx2 or .dds file next to imagePath with the same name, returns false if there is none
+	static bool LoadCompressed(const std::string& imagePath, TextureData& data);
+	// Path of the .ktx2 or .dds file LoadCompressed would pick, empty if there is none
+	static std::string FindCompressed(const std::string& imagePath);
+
+	static void LoadKTX2(const std::string& path, TextureData& data);
+	static void LoadDDS(const std::string& path, TextureData& data);
+
+	// Bytes per 4x4 block for block compressed formats, 0 for everything else
+	static uint32_t BlockSize(VkFormat format);
+	static size_t LevelSize(VkFormat format, uint32_t width, uint32_t height);
+};
+
+#endif
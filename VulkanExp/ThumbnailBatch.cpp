@@ -0,0 +1,314 @@
+#include "ThumbnailBatch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+#include "CpuProfiler.h"
+#include "OffscreenTarget.h"
+
+namespace {
+	double SecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string Lower(std::string text) {
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	}
+
+	std::string LowerExtension(const std::filesystem::path& path) {
+		return Lower(path.extension().string());
+	}
+
+	bool IsModelFile(const std::filesystem::path& path) {
+		std::string extension = LowerExtension(path);
+		return extension == ".obj" || extension == ".vkpkg";
+	}
+}
+
+ThumbnailBatch::ThumbnailBatch(HeadlessRenderer& renderer, const std::string& outputDirectory, const std::string& texturePath)
+	: m_renderer(renderer), m_outputDirectory(outputDirectory), m_texturePath(texturePath), m_slotOutputs(renderer.slotCount()) {
+	m_maxEncoders = std::max(1u, std::thread::hardware_concurrency());
+	if (!m_outputDirectory.empty()) {
+		std::filesystem::create_directories(m_outputDirectory);
+	}
+}
+
+ThumbnailBatch::~ThumbnailBatch()
+{
+	for (std::future<Encoded>& encoder : m_encoders) {
+		encoder.wait();
+	}
+}
+
+std::vector<std::string> ThumbnailBatch::CollectInputs(const std::vector<std::string>& arguments)
+{
+	std::vector<std::string> inputs;
+	for (const std::string& argument : arguments) {
+		std::filesystem::path path(argument);
+		if (std::filesystem::is_directory(path)) {
+			// Sorted, so the order and the output names do not depend on the file system
+			std::vector<std::string> found;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+				if (entry.is_regular_file() && IsModelFile(entry.path())) {
+					found.push_back(entry.path().string());
+				}
+			}
+			std::sort(found.begin(), found.end());
+			inputs.insert(inputs.end(), found.begin(), found.end());
+		}
+		else if (path.extension() == ".txt") {
+			std::ifstream list(argument);
+			if (!list.is_open()) {
+				throw std::runtime_error("failed to open " + argument + "!");
+			}
+			std::string line;
+			while (std::getline(list, line)) {
+				line.erase(line.find_last_not_of(" \t\r") + 1);
+				if (!line.empty() && line[0] != '#') {
+					inputs.push_back(line);
+				}
+			}
+		}
+		else {
+			inputs.push_back(argument);
+		}
+	}
+	return inputs;
+}
+
+std::vector<std::string> ThumbnailBatch::OutputPaths(const std::vector<std::string>& modelPaths) const
+{
+	// Compared in lower case, so names that only differ in case don't overwrite each other on Windows either
+	std::unordered_set<std::string> used;
+	std::vector<std::string> outputs;
+	outputs.reserve(modelPaths.size());
+	for (const std::string& modelPath : modelPaths) {
+		std::string stem = std::filesystem::path(modelPath).stem().string();
+		std::string name = stem;
+		for (uint32_t index = 2; !used.insert(Lower(name)).second; ++index) {
+			name = stem + "_" + std::to_string(index);
+		}
+		std::filesystem::path output(m_outputDirectory);
+		output /= name + ".png";
+		outputs.push_back(output.string());
+	}
+	return outputs;
+}
+
+std::shared_ptr<ThumbnailBatch::PendingRead> ThumbnailBatch::StartRead(const std::string& path)
+{
+	auto pending = std::make_shared<PendingRead>();
+	pending->file.path = path;
+	if (LowerExtension(path) == ".vkpkg") {
+		// Packages are mapped and read section by section straight into upload memory, there is nothing to read ahead
+		return pending;
+	}
+
+	JobSystem& jobs = JobSystem::Instance();
+	jobs.Add(pending->read);
+	m_reader.Read(path, [pending, &jobs](FileRead&& result) {
+		pending->file = std::move(result);
+		jobs.Done(pending->read);
+	});
+	return pending;
+}
+
+std::future<ThumbnailBatch::Parsed> ThumbnailBatch::StartParse(const std::string& path, std::shared_ptr<PendingRead> read)
+{
+	// Created here rather than in the job, the renderer itself is only used from this thread
+	std::shared_ptr<Model> model = m_renderer.CreateModel();
+	auto promise = std::make_shared<std::promise<Parsed>>();
+	std::future<Parsed> parsed = promise->get_future();
+
+	// Held back until the file is in memory, so no worker sits waiting on the drive
+	JobSystem::Instance().Run([model, path, read, promise]() {
+		Parsed result;
+		auto start = std::chrono::steady_clock::now();
+		try {
+			const FileRead& file = read->file;
+			if (!file.error.empty()) {
+				throw std::runtime_error(file.error);
+			}
+			if (file.contents.data()) {
+				model->LoadModel(path, file.contents.data(), file.contents.size());
+			}
+			else {
+				HeadlessRenderer::LoadModelFile(*model, path);
+			}
+			result.model = model;
+		}
+		catch (const std::exception& e) {
+			result.error = e.what();
+		}
+		result.seconds = SecondsSince(start);
+		promise->set_value(std::move(result));
+	}, nullptr, &read->read);
+	return parsed;
+}
+
+void ThumbnailBatch::FinishEncode()
+{
+	auto start = std::chrono::steady_clock::now();
+	Encoded encoded = m_encoders.front().get();
+	m_encoders.pop_front();
+	m_stats.encodeStall += SecondsSince(start);
+	m_stats.encode += encoded.seconds;
+
+	if (!encoded.error.empty()) {
+		std::cerr << encoded.error << std::endl;
+		++m_stats.failed;
+	}
+	else {
+		++m_stats.rendered;
+	}
+}
+
+void ThumbnailBatch::Readback(uint32_t slot)
+{
+	if (m_slotOutputs[slot].empty()) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	m_renderer.WaitSlot(slot);
+	m_stats.gpuWait += SecondsSince(start);
+
+	// The readback buffer is reused by the slot's next frame, so the encoder gets its own copy
+	start = std::chrono::steady_clock::now();
+	const VkExtent2D& size = m_renderer.extent();
+	const uint8_t* data = m_renderer.ReadbackData(slot);
+	std::vector<uint8_t> pixels(data, data + size_t(size.width) * size.height * 4);
+	m_stats.readback += SecondsSince(start);
+
+	if (m_encoders.size() >= m_maxEncoders) {
+		FinishEncode();
+	}
+
+	std::string path = std::move(m_slotOutputs[slot]);
+	m_slotOutputs[slot].clear();
+	uint32_t width = size.width;
+	uint32_t height = size.height;
+	auto promise = std::make_shared<std::promise<Encoded>>();
+	m_encoders.push_back(promise->get_future());
+	JobSystem::Instance().Run([pixels = std::move(pixels), path, width, height, promise]() {
+		Encoded encoded;
+		auto start = std::chrono::steady_clock::now();
+		try {
+			OffscreenTarget::WriteImage(path, width, height, pixels.data());
+		}
+		catch (const std::exception& e) {
+			encoded.error = e.what();
+		}
+		encoded.seconds = SecondsSince(start);
+		promise->set_value(std::move(encoded));
+	});
+}
+
+void ThumbnailBatch::Run(const std::vector<std::string>& modelPaths)
+{
+	auto runStart = std::chrono::steady_clock::now();
+	uint32_t slotCount = m_renderer.slotCount();
+	std::vector<std::string> outputs = OutputPaths(modelPaths);
+
+	// Reads run ReadAhead models ahead and only cost the file's size in memory until it is parsed
+	std::deque<std::shared_ptr<PendingRead>> reads;
+	size_t nextRead = 0;
+	auto startParse = [&](const std::string& path) {
+		while (nextRead < modelPaths.size() && reads.size() < ReadAhead) {
+			reads.push_back(StartRead(modelPaths[nextRead++]));
+		}
+		std::shared_ptr<PendingRead> read = std::move(reads.front());
+		reads.pop_front();
+		return StartParse(path, std::move(read));
+	};
+
+	// Parsing runs as far ahead as there are slots, enough to keep the uploads fed without holding every model
+	std::deque<std::future<Parsed>> parsing;
+	size_t nextParse = 0;
+	for (; nextParse < modelPaths.size() && nextParse < slotCount; ++nextParse) {
+		parsing.push_back(startParse(modelPaths[nextParse]));
+	}
+
+	uint32_t slot = 0;
+	for (size_t i = 0; i < modelPaths.size(); ++i) {
+		auto start = std::chrono::steady_clock::now();
+		Parsed parsed = parsing.front().get();
+		parsing.pop_front();
+		m_stats.parseStall += SecondsSince(start);
+		m_stats.parse += parsed.seconds;
+
+		if (nextParse < modelPaths.size()) {
+			parsing.push_back(startParse(modelPaths[nextParse++]));
+		}
+
+		if (!parsed.model) {
+			std::cerr << modelPaths[i] << ": " << parsed.error << std::endl;
+			++m_stats.failed;
+			continue;
+		}
+
+		CpuProfiler::Collect();
+
+		// The slot's previous model finished rendering slotCount - 1 submissions ago, usually without a wait
+		Readback(slot);
+
+		try {
+			start = std::chrono::steady_clock::now();
+			m_renderer.SetScene(slot, parsed.model, m_texturePath);
+			m_stats.upload += SecondsSince(start);
+		}
+		catch (const std::exception& e) {
+			std::cerr << modelPaths[i] << ": " << e.what() << std::endl;
+			++m_stats.failed;
+			continue;
+		}
+
+		start = std::chrono::steady_clock::now();
+		m_renderer.RenderSlot(slot, 0.0f);
+		m_stats.submit += SecondsSince(start);
+
+		m_slotOutputs[slot] = outputs[i];
+		slot = (slot + 1) % slotCount;
+	}
+
+	for (uint32_t i = 0; i < slotCount; ++i) {
+		Readback((slot + i) % slotCount);
+	}
+	while (!m_encoders.empty()) {
+		FinishEncode();
+	}
+
+	m_stats.wall = SecondsSince(runStart);
+}
+
+void ThumbnailBatch::Report(std::ostream& out) const
+{
+	uint32_t count = std::max(1u, m_stats.rendered + m_stats.failed);
+	auto stage = [&out, count](const char* name, double seconds) {
+		out << "  " << name << seconds * 1000.0 << " ms total, " << seconds * 1000.0 / count << " ms per model" << std::endl;
+	};
+
+	out << m_stats.rendered << " thumbnails";
+	if (m_stats.failed > 0) {
+		out << ", " << m_stats.failed << " failed";
+	}
+	out << " in " << m_stats.wall << " s (" << m_stats.rendered / std::max(m_stats.wall, 1e-9) << " models/s)" << std::endl;
+	out << "  read " << m_reader.filesRead() << " files, " << m_reader.bytesRead() / (1024.0 * 1024.0) << " MB through "
+		<< m_reader.backend() << " (" << m_reader.bytesRead() / (1024.0 * 1024.0) / std::max(m_stats.wall, 1e-9) << " MB/s)" << std::endl;
+	stage("parse          ", m_stats.parse);
+	stage("parse stall    ", m_stats.parseStall);
+	stage("upload         ", m_stats.upload);
+	stage("record/submit  ", m_stats.submit);
+	stage("gpu wait       ", m_stats.gpuWait);
+	stage("readback copy  ", m_stats.readback);
+	stage("encode         ", m_stats.encode);
+	stage("encode stall   ", m_stats.encodeStall);
+}
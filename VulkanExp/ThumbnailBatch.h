@@ -0,0 +1,98 @@
+#ifndef THUMBNAILBATCH_H
+#define THUMBNAILBATCH_H
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AsyncFileReader.h"
+#include "HeadlessRenderer.h"
+#include "JobSystem.h"
+
+// Seconds spent per stage, summed over every model. Parse and encode run on worker threads, so their totals can
+// exceed the wall time; the stall entries are how long the render thread waited for them.
+struct ThumbnailStats {
+	uint32_t rendered = 0;
+	uint32_t failed = 0;
+	double parse = 0.0;
+	double parseStall = 0.0;
+	double upload = 0.0;
+	double submit = 0.0;
+	double gpuWait = 0.0;
+	double readback = 0.0;
+	double encode = 0.0;
+	double encodeStall = 0.0;
+	double wall = 0.0;
+};
+
+// Renders one image per model through a single device. Every image slot of the renderer holds a different model,
+// so while model k renders, model k+1 uploads into the next slot and the models after it parse as jobs; finished
+// frames are copied out of the readback buffer and encoded to PNG by jobs as well. OBJ files are read by an
+// AsyncFileReader up to ReadAhead models in advance, so the drive always has a queue of reads, and a parse job
+// only starts once its file is in memory.
+class ThumbnailBatch {
+	public:
+		// OBJ files read ahead of parsing
+		static const size_t ReadAhead = 32;
+
+		// Thumbnails go to outputDirectory/<model name>.png, OBJ files are textured with texturePath. Models whose names
+		// collide, a.obj next to a.vkpkg or in another directory, get <model name>_2.png and so on in input order
+		ThumbnailBatch(HeadlessRenderer& renderer, const std::string& outputDirectory, const std::string& texturePath);
+		// Waits for the encoders still running
+		~ThumbnailBatch();
+
+		ThumbnailBatch(const ThumbnailBatch&) = delete;
+		ThumbnailBatch& operator=(const ThumbnailBatch&) = delete;
+
+		// Expands directories into the .obj and .vkpkg files below them and .txt files into the paths they list,
+		// one per line, keeps everything else as is
+		static std::vector<std::string> CollectInputs(const std::vector<std::string>& arguments);
+
+		// Models that fail to load are reported and skipped
+		void Run(const std::vector<std::string>& modelPaths);
+		void Report(std::ostream& out) const;
+
+		inline const ThumbnailStats& stats() const { return m_stats; }
+
+	private:
+		struct Parsed {
+			std::shared_ptr<Model> model;
+			std::string error;
+			double seconds = 0.0;
+		};
+
+		// A file on its way from the reader to its parse job, the counter is done once it is in memory
+		struct PendingRead {
+			JobCounter read;
+			FileRead file;
+		};
+
+		struct Encoded {
+			std::string error;
+			double seconds = 0.0;
+		};
+
+		HeadlessRenderer& m_renderer;
+		std::string m_outputDirectory;
+		std::string m_texturePath;
+		ThumbnailStats m_stats;
+
+		// Output path of the model each slot rendered last, empty while the slot has nothing to read back
+		std::vector<std::string> m_slotOutputs;
+		std::deque<std::future<Encoded>> m_encoders;
+		size_t m_maxEncoders;
+		AsyncFileReader m_reader;
+
+		std::shared_ptr<PendingRead> StartRead(const std::string& path);
+		std::future<Parsed> StartParse(const std::string& path, std::shared_ptr<PendingRead> read);
+		void Readback(uint32_t slot);
+		void FinishEncode();
+		// One unique path per model, decided before the first one is rendered
+		std::vector<std::string> OutputPaths(const std::vector<std::string>& modelPaths) const;
+};
+
+#endif
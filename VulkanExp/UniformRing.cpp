@@ -0,0 +1,50 @@
+#include "UniformRing.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Model.h"
+
+UniformRing::UniformRing(const Device& device, uint32_t framesInFlight, VkDeviceSize bytesPerFrame) : m_device(device)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(device.physical(), &properties);
+	m_alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+	// Frame regions start aligned too, so every offset handed out is a valid dynamic offset
+	m_bytesPerFrame = (bytesPerFrame + m_alignment - 1) / m_alignment * m_alignment;
+
+	VkDeviceSize bufferSize = m_bytesPerFrame * framesInFlight;
+	Model::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_memory, device, MemoryCategory::Uniform);
+
+	void* mapped;
+	if (vkMapMemory(device.logical(), m_memory, 0, bufferSize, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map uniform ring!");
+	}
+	m_mapped = static_cast<uint8_t*>(mapped);
+}
+
+UniformRing::~UniformRing()
+{
+	vkUnmapMemory(m_device.logical(), m_memory);
+	vkDestroyBuffer(m_device.logical(), m_buffer, nullptr);
+	m_device.memory().Free(m_memory);
+}
+
+void UniformRing::BeginFrame(uint32_t frame)
+{
+	m_frameStart = m_bytesPerFrame * frame;
+	m_head = m_frameStart;
+}
+
+uint32_t UniformRing::Push(const void* data, VkDeviceSize size)
+{
+	VkDeviceSize offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+	if (offset + size > m_frameStart + m_bytesPerFrame) {
+		throw std::runtime_error("uniform ring is out of space for this frame!");
+	}
+
+	memcpy(m_mapped + offset, data, static_cast<size_t>(size));
+	m_head = offset + size;
+	return static_cast<uint32_t>(offset);
+}
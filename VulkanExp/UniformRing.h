@@ -0,0 +1,48 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "Device.h"
+
+// One persistently mapped uniform buffer shared by every draw. Each frame in flight owns a fixed region of it;
+// per-draw blocks are bumped out of the current frame's region and bound through a dynamic offset, so any
+// number of objects share one VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor. A region is rewound by
+// BeginFrame, which must only be called once the GPU has finished that frame's previous submission.
+class UniformRing {
+	public:
+		UniformRing(const Device& device, uint32_t framesInFlight, VkDeviceSize bytesPerFrame);
+		~UniformRing();
+
+		UniformRing(const UniformRing&) = delete;
+		UniformRing& operator=(const UniformRing&) = delete;
+
+		void BeginFrame(uint32_t frame);
+
+		// Copies size bytes into the current frame's region and returns the dynamic offset of the block
+		uint32_t Push(const void* data, VkDeviceSize size);
+		template<typename T>
+		inline uint32_t Push(const T& block) { return Push(&block, sizeof(T)); }
+
+		inline VkBuffer buffer() const { return m_buffer; }
+		inline VkDeviceSize alignment() const { return m_alignment; }
+		inline VkDeviceSize bytesPerFrame() const { return m_bytesPerFrame; }
+		// Bytes handed out in the current frame, alignment padding included
+		inline VkDeviceSize used() const { return m_head - m_frameStart; }
+
+	private:
+		const Device& m_device;
+
+		VkBuffer m_buffer;
+		VkDeviceMemory m_memory;
+		uint8_t* m_mapped;
+
+		VkDeviceSize m_alignment;
+		VkDeviceSize m_bytesPerFrame;
+		VkDeviceSize m_frameStart = 0;
+		VkDeviceSize m_head = 0;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "Window.h"
 #include "Instance.h"
 
+#include <chrono>
 #include <iostream>
 
 Window::Window(const uint32_t widthP, const uint32_t heightP, const Instance& instance)
@@ -25,14 +26,36 @@ Window::~Window()
 	glfwTerminate();
 }
 
-void Window::mainLoop()
+void Window::mainLoop(double updateInterval)
 {
+	typedef std::chrono::steady_clock Clock;
+	const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(updateInterval));
+
+	auto next = Clock::now();
 	while (!glfwWindowShouldClose(glfwWindow)) {
+		auto now = Clock::now();
+		if (now < next) {
+			// Returns as soon as an event arrives, so input is handled right away whatever the renderer is doing
+			glfwWaitEventsTimeout(std::chrono::duration<double>(next - now).count());
+			continue;
+		}
+
 		glfwPollEvents();
-		m_drawFrameHandle(m_framebufferResized);
+		m_updateHandle();
+		// An update that ran late moves the schedule instead of being followed by a burst of catch up updates
+		next += interval;
+		if (next < now) {
+			next = now + interval;
+		}
 	}
 }
 
+void Window::requestClose()
+{
+	glfwSetWindowShouldClose(glfwWindow, GLFW_TRUE);
+	glfwPostEmptyEvent();
+}
+
 void Window::FramebufferResizeCallback(GLFWwindow* window, int width, int height) {
 	auto w = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
 	w->m_framebufferResized = true;
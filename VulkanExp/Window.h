@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include <atomic>
 #include <functional>
 
 class Instance;
@@ -16,8 +17,14 @@ class Window {
 		Window(const uint32_t width, const uint32_t height, const Instance& instance);
 		Window() = delete;
 		~Window();
-		void mainLoop();
-		inline void setDrawFrameFunc(const std::function<void(bool&)>& func) { m_drawFrameHandle = func; }
+		// Handles window system events and calls the update function every updateInterval seconds until the window
+		// is closed. GLFW only allows this on the main thread; events are handled as they arrive in between updates
+		void mainLoop(double updateInterval);
+		inline void setUpdateFunc(const std::function<void()>& func) { m_updateHandle = func; }
+		// From any thread, makes mainLoop return
+		void requestClose();
+		// True once after every resize, from any thread
+		inline bool takeResized() { return m_framebufferResized.exchange(false); }
 		static void GetRequiredExtensions(std::vector<const char*>& ret);
 		inline const VkSurfaceKHR& surface() const { return m_surface; }
 
@@ -33,14 +40,15 @@ class Window {
 
 	private:
 		GLFWwindow* glfwWindow;
-		std::function<void(bool&)> m_drawFrameHandle;
+		std::function<void()> m_updateHandle;
 
 		const Instance& m_instance;
 
 		uint32_t width;
 		uint32_t height;
 		VkSurfaceKHR m_surface;
-		bool m_framebufferResized;
+		// Set by the resize callback on the main thread, taken by whichever thread renders
+		std::atomic<bool> m_framebufferResized;
 		static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 
 };
@@ -12,8 +12,12 @@
 #include <limits> 
 #include <algorithm> 
 #include <fstream>
+#include <sstream>
 #include <array>
 #include <unordered_map>
+#include <memory>
+#include <thread>
+#include <exception>
 
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
@@ -33,14 +37,49 @@
 #include "./VulkanExp/DescriptorSets.h"
 #include "./VulkanExp/Model.h"
 #include "./VulkanExp/Texture.h"
+#include "./VulkanExp/SamplerCache.h"
+#include "./VulkanExp/BindlessTextures.h"
+#include "./VulkanExp/UniformRing.h"
+#include "./VulkanExp/GpuTimeline.h"
+#include "./VulkanExp/GpuProfiler.h"
+#include "./VulkanExp/CpuProfiler.h"
+#include "./VulkanExp/FramePacing.h"
+#include "./VulkanExp/HeadlessRenderer.h"
+#include "./VulkanExp/TextureCache.h"
 #include "./VulkanExp/DescriptorSets.h"
+#include "./VulkanExp/Benchmarks.h"
+#include "./VulkanExp/MemoryTracker.h"
+#include "./VulkanExp/StreamingMesh.h"
+#include "./VulkanExp/ThumbnailBatch.h"
+#include "./VulkanExp/AsyncFileReader.h"
+#include "./VulkanExp/JobSystem.h"
+#include "./VulkanExp/FrameQueue.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 const std::string MODEL_PATH = "../models/ariadne.obj";
+// Written by AssetCooker, preferred over the OBJ when present
+const std::string PACKAGE_PATH = "../models/ariadne.vkpkg";
+const std::string TEXTURE_PATH = "../textures/viking_room.png";
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+// Seconds between two frame rate and latency reports
+const double LATENCY_REPORT_INTERVAL = 2.0;
+
+// Seconds between two updates on the main thread, which publish a snapshot whether or not the last one was drawn
+const double UPDATE_INTERVAL = 1.0 / 240.0;
+
+// Room for per-draw uniform blocks in each frame's part of the uniform ring
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 1024 * 1024;
+
+// Sets per pool in each frame's descriptor allocator, a frame allocates one
+const uint32_t FRAME_DESCRIPTOR_SETS = 4;
+
+// Unreferenced textures are kept resident up to this much device memory
+const VkDeviceSize TEXTURE_CACHE_BUDGET = 256ull * 1024 * 1024;
+
+// Device memory for the resident chunks of a streamed mesh unless --stream-pool says otherwise
+const VkDeviceSize STREAM_POOL_SIZE = 256ull * 1024 * 1024;
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -58,6 +97,14 @@ const bool enableValidationLayers = true;
 
 class HelloTriangleApplication {
 public:
+	// Draw through the descriptor indexing path when the device supports it
+	bool useBindless = false;
+	// Frames in flight, present mode and the low latency wait
+	FramePacing framePacing;
+	// Chunked package to stream instead of loading the default model
+	std::string streamPath;
+	VkDeviceSize streamPoolSize = STREAM_POOL_SIZE;
+
 	void run() {
 		glfwInit();
 
@@ -85,16 +132,36 @@ private:
 	CommandPool* commandPool;
 	CommandBuffers* commandBuffers;
 	FencesAndSemaphores* fencesAndSemaphores;
+	GpuTimeline* gpuTimeline;
+	GpuProfiler* gpuProfiler;
+	LatencyTracker* latencyTracker;
 	Model* currentModel;
+	DescriptorLayoutCache* descriptorLayouts;
+	DescriptorAllocator* descriptorAllocator;
+	// One per frame in flight, reset once the frame's timeline value is reached
+	std::vector<DescriptorAllocator*> frameDescriptorAllocators;
 	DescriptorSets* descriptorSets;
-	Texture* currentTexture;
+	SamplerCache* samplerCache;
+	TextureCache* textureCache;
+	std::shared_ptr<Texture> currentTexture;
+	BindlessTextures* bindlessTextures = nullptr;
+	StreamingMesh* streamingMesh = nullptr;
 	//Texture randomTexture;
 
 	uint32_t currentFrame = 0;
 
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	std::vector<void*> uniformBuffersMapped;
+	// Snapshots from the update on the main thread to the render thread
+	FrameQueue frameQueue;
+	std::chrono::steady_clock::time_point startTime;
+	uint64_t updateCount = 0;
+	// First exception on the render thread, rethrown on the main thread once it has stopped
+	std::exception_ptr renderError;
+
+	UniformRing* uniformRing;
+
+	VkBuffer drawBuffer;
+	VkDeviceMemory drawBufferMemory;
+	uint32_t drawCount = 0;
 
 	VkImage depthImage;
 	VkDeviceMemory depthImageMemory;
@@ -112,29 +179,100 @@ private:
 		initWindow();
 		createSurface();
 		device = new Device(*instance, *window, Instance::DeviceExtensions);
-		swapChain = new SwapChain(*device, *window);
+		gpuTimeline = new GpuTimeline(*device);
+		// Before the first upload, so model and texture uploads are timed as well
+		gpuProfiler = new GpuProfiler(*device, *gpuTimeline, framePacing.framesInFlight);
+		swapChain = new SwapChain(*device, *window, framePacing.presentMode);
+		if (swapChain->presentMode() != framePacing.presentMode) {
+			std::cout << "present mode " << FramePacing::PresentModeName(framePacing.presentMode) << " not supported, using " << FramePacing::PresentModeName(swapChain->presentMode()) << std::endl;
+		}
 		renderPass = new RenderPass(*device, *swapChain);
-		createUniformBuffers();
+		uniformRing = new UniformRing(*device, framePacing.framesInFlight, UNIFORM_RING_FRAME_SIZE);
 		commandPool = new CommandPool(*device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-		currentTexture = new Texture(*device, *commandPool);
-		currentModel = new Model(*device, *commandPool);
-		currentModel->LoadModel(MODEL_PATH);
-		currentModel->CreateVertexBuffer();
-		currentModel->CreateIndexBuffer();
-		descriptorSets = new DescriptorSets(*device, MAX_FRAMES_IN_FLIGHT, uniformBuffers, *currentTexture);
-		graphicsPipeline = new GraphicsPipeline(*device, *swapChain, *renderPass, *descriptorSets);
-		commandBuffers = new CommandBuffers(*device, *renderPass, *swapChain, *graphicsPipeline, *commandPool, MAX_FRAMES_IN_FLIGHT);
-		fencesAndSemaphores = new FencesAndSemaphores(*device, swapChain->numImages(), MAX_FRAMES_IN_FLIGHT);		
+		samplerCache = new SamplerCache(*device);
+		textureCache = new TextureCache(*device, *commandPool, *samplerCache, *gpuTimeline, TEXTURE_CACHE_BUDGET);
+		currentModel = new Model(*device, *commandPool, *gpuTimeline);
+		if (!streamPath.empty()) {
+			// The model stays empty, chunks are read as the view needs them
+			streamingMesh = new StreamingMesh(*device, *commandPool, *gpuTimeline, streamPath, streamPoolSize);
+			const PackageTexture& texture = streamingMesh->texture();
+			currentTexture = !texture.levels.empty() ? textureCache->Acquire(texture) : textureCache->Acquire(TEXTURE_PATH);
+		}
+		else {
+			if (std::ifstream(PACKAGE_PATH, std::ios::binary).good()) {
+				currentModel->LoadPackage(PACKAGE_PATH);
+			}
+			else {
+				currentModel->LoadModel(MODEL_PATH);
+			}
+			if (currentModel->GetPackage() && currentModel->GetPackage()->FindSection(PackageSection::TextureLevel)) {
+				currentTexture = textureCache->Acquire(*currentModel->GetPackage());
+			}
+			else {
+				currentTexture = textureCache->Acquire(TEXTURE_PATH);
+			}
+			currentModel->BuildBVH();
+			currentModel->CreateVertexBuffer();
+			currentModel->CreateIndexBuffer();
+		}
+		descriptorLayouts = new DescriptorLayoutCache(*device);
+		descriptorAllocator = new DescriptorAllocator(*device);
+		for (uint32_t i = 0; i < framePacing.framesInFlight; ++i) {
+			frameDescriptorAllocators.push_back(new DescriptorAllocator(*device, FRAME_DESCRIPTOR_SETS));
+		}
+		descriptorSets = new DescriptorSets(*device, *descriptorAllocator, *descriptorLayouts, uniformRing->buffer(), *currentTexture, samplerCache->GetDefault());
+		if (useBindless && streamingMesh) {
+			std::cout << "streamed meshes are drawn without bindless textures" << std::endl;
+			useBindless = false;
+		}
+		if (useBindless && !device->descriptorIndexingEnabled()) {
+			std::cout << "descriptor indexing not supported, using the regular descriptor sets" << std::endl;
+			useBindless = false;
+		}
+		if (useBindless) {
+			bindlessTextures = new BindlessTextures(*device);
+			uint32_t material = bindlessTextures->AddMaterial(*currentTexture, samplerCache->GetDefault());
+			createDrawBuffer(material);
+		}
+		graphicsPipeline = new GraphicsPipeline(*device, *swapChain, *renderPass, *descriptorSets, useBindless ? bindlessTextures->layout() : VK_NULL_HANDLE);
+		commandBuffers = new CommandBuffers(*device, *renderPass, *swapChain, *graphicsPipeline, *commandPool, framePacing.framesInFlight);
+		commandBuffers->SetProfiler(gpuProfiler);
+		fencesAndSemaphores = new FencesAndSemaphores(*device, swapChain->numImages(), framePacing.framesInFlight);
+		latencyTracker = new LatencyTracker(framePacing.framesInFlight);
 	}
 
+	// The main thread handles window events and runs the update, the render thread records, submits and presents
+	// whatever snapshot is newest. Neither waits for the other, so a slow present never holds up input and the
+	// next update overlaps recording of the current frame
 	void mainLoop() {
+		startTime = std::chrono::steady_clock::now();
+		update();
+		std::thread renderThread(&HelloTriangleApplication::renderLoop, this);
 
-		window->setDrawFrameFunc([this](bool& framebufferResized) {
-			drawFrame(framebufferResized);
+		window->setUpdateFunc([this]() {
+			update();
 		});
-
-		window->mainLoop();
+		window->mainLoop(UPDATE_INTERVAL);
+		frameQueue.Close();
+		renderThread.join();
 		vkDeviceWaitIdle(device->logical());
+		if (renderError) {
+			std::rethrow_exception(renderError);
+		}
+
+		latencyTracker->Update(gpuTimeline->CompletedValue());
+		std::cout << pacingLabel() << ": " << latencyTracker->frameCount() << " frames, input-to-present "
+			<< latencyTracker->averageMs() << " ms avg, " << latencyTracker->maxMs() << " ms max" << std::endl;
+		std::cout << updateCount << " updates, " << frameQueue.skipped() << " snapshots not drawn" << std::endl;
+		gpuProfiler->Collect();
+		gpuProfiler->Report(std::cout, 0.0);
+		CpuProfiler::Finish(std::cout);
+		if (streamingMesh) {
+			streamingMesh->Report(std::cout);
+		}
+		if (MemoryTracker::reporting()) {
+			device->memory().Report(std::cout);
+		}
 	}
 
 	void cleanup() {
@@ -143,16 +281,32 @@ private:
 		graphicsPipeline->~GraphicsPipeline();
 		renderPass->~RenderPass();
 		
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			vkDestroyBuffer(device->logical(), uniformBuffers[i], nullptr);
-			vkFreeMemory(device->logical(), uniformBuffersMemory[i], nullptr);
-		}
+		uniformRing->~UniformRing();
 		commandBuffers->~CommandBuffers();
-		currentTexture->~Texture();
+		if (bindlessTextures) {
+			vkDestroyBuffer(device->logical(), drawBuffer, nullptr);
+			device->memory().Free(drawBufferMemory);
+			bindlessTextures->~BindlessTextures();
+		}
+		if (streamingMesh) {
+			streamingMesh->~StreamingMesh();
+		}
+		currentTexture.reset();
+		textureCache->~TextureCache();
 		currentModel->~Model();
 		descriptorSets->~DescriptorSets();
+		for (DescriptorAllocator* frameAllocator : frameDescriptorAllocators) {
+			frameAllocator->~DescriptorAllocator();
+		}
+		descriptorAllocator->~DescriptorAllocator();
+		descriptorLayouts->~DescriptorLayoutCache();
+		samplerCache->~SamplerCache();
+		gpuProfiler->~GpuProfiler();
+		// Releases everything textures and models retired on it
+		gpuTimeline->~GpuTimeline();
 
 		fencesAndSemaphores->~FencesAndSemaphores();
+		latencyTracker->~LatencyTracker();
 		device->~Device();
 		debugMessenger->~DebugMessenger();
 
@@ -224,11 +378,63 @@ private:
 		surface = window->getSurface();
 	}
 
-	void drawFrame(bool& framebufferResized) {
-		vkWaitForFences(device->logical(), 1, &fencesAndSemaphores->inFlightFence(currentFrame), VK_TRUE, UINT64_MAX);
+	// Main thread: samples input and the window size and publishes what the next frame shows
+	void update() {
+		CpuZone zone("update");
+		auto now = std::chrono::steady_clock::now();
+
+		FrameSnapshot snapshot;
+		snapshot.update = updateCount++;
+		snapshot.time = std::chrono::duration<float, std::chrono::seconds::period>(now - startTime).count();
+		snapshot.sampled = now;
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(window->getWindow(), &width, &height);
+		snapshot.width = static_cast<uint32_t>(width);
+		snapshot.height = static_cast<uint32_t>(height);
+		snapshot.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		snapshot.model = glm::rotate(glm::mat4(1.0f), snapshot.time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		frameQueue.Publish(snapshot);
+	}
+
+	void renderLoop() {
+		if (CpuProfiler::enabled()) {
+			CpuProfiler::SetThreadName("render");
+		}
+
+		try {
+			bool framebufferResized = false;
+			FrameSnapshot snapshot;
+			while (frameQueue.WaitLatest(snapshot)) {
+				// Minimized, nothing to draw into until an update sees a size again
+				if (snapshot.width == 0 || snapshot.height == 0) {
+					continue;
+				}
+				framebufferResized |= window->takeResized();
+				drawFrame(snapshot, framebufferResized);
+			}
+		}
+		catch (...) {
+			renderError = std::current_exception();
+			window->requestClose();
+		}
+	}
+
+	// Render thread: snapshot is the newest one when the frame starts, replaced by a newer one if the update
+	// published it while this frame waited for the GPU
+	void drawFrame(FrameSnapshot& snapshot, bool& framebufferResized) {
+		CpuZone frameZone("frame");
+		{
+			CpuZone zone("wait for frame");
+			gpuTimeline->Wait(fencesAndSemaphores->frameValue(currentFrame));
+		}
 
 		uint32_t imageIndex;
-		VkResult result = vkAcquireNextImageKHR(device->logical(), swapChain->handle(), UINT64_MAX, fencesAndSemaphores->imageAvailable(currentFrame), VK_NULL_HANDLE, &imageIndex);
+		VkResult result;
+		{
+			CpuZone zone("acquire");
+			result = vkAcquireNextImageKHR(device->logical(), swapChain->handle(), UINT64_MAX, fencesAndSemaphores->imageAvailable(currentFrame), VK_NULL_HANDLE, &imageIndex);
+		}
 		
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain(framebufferResized);
@@ -238,32 +444,63 @@ private:
 			throw std::runtime_error("failed to acquire swap chain image");
 		}
 
-		updateUniformBuffer(currentFrame);
-
-		vkResetFences(device->logical(), 1, &fencesAndSemaphores->inFlightFence(currentFrame));
-
-		commandBuffers->ResetCommandBuffer(currentFrame);
-		commandBuffers->RecordCommandBuffer(currentFrame, imageIndex, currentModel->GetVertextBuffer(), currentModel->GetIndexBuffer(), currentModel->GetIndices(), *descriptorSets);
-
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers->command(currentFrame);
+		if (framePacing.lowLatency) {
+			// Once the previous frame is done on the GPU it has been queued for present, so the input sampled
+			// below is shown as soon as possible instead of waiting behind frames already in flight
+			CpuZone zone("low latency wait");
+			gpuTimeline->Wait(gpuTimeline->lastSubmitted());
+		}
+		latencyTracker->Update(gpuTimeline->CompletedValue());
+		gpuProfiler->Collect();
+		gpuTimeline->Collect();
+
+		// The timeline wait above means the GPU is done with this frame's part of the ring and its descriptor sets
+		uniformRing->BeginFrame(currentFrame);
+		frameDescriptorAllocators[currentFrame]->Reset();
+		descriptorSets->BeginFrame(*frameDescriptorAllocators[currentFrame], *currentTexture);
+		// A window minimized since the frame started has nothing to show, the frame goes out with the snapshot it
+		// started with and the acquired image is presented as usual
+		FrameSnapshot latest;
+		if (frameQueue.TakeLatest(latest) && latest.width != 0 && latest.height != 0) {
+			snapshot = latest;
+		}
+		DrawConstants drawConstants;
+		latencyTracker->InputSampled(currentFrame, snapshot.sampled);
+		uint32_t uniformOffset;
+		UniformBufferObject ubo{};
+		{
+			CpuZone zone("update uniforms");
+			uniformOffset = updateUniformBuffer(snapshot, drawConstants, ubo);
+		}
+		if (streamingMesh) {
+			streamingMesh->Update(ubo.view, ubo.proj, snapshot.model);
+		}
 
-		VkSemaphore waitSemaphores[] = { fencesAndSemaphores->imageAvailable(currentFrame) };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
+		{
+			CpuZone zone("record");
+			commandBuffers->ResetCommandBuffer(currentFrame);
+			if (streamingMesh) {
+				commandBuffers->RecordDrawListCommandBuffer(currentFrame, imageIndex, streamingMesh->vertexBuffer(), streamingMesh->indexBuffer(), streamingMesh->indexType(), *descriptorSets, uniformOffset, drawConstants, streamingMesh->draws());
+			}
+			else if (useBindless) {
+				commandBuffers->RecordIndirectCommandBuffer(currentFrame, imageIndex, currentModel->GetVertextBuffer(), currentModel->GetIndexBuffer(), currentModel->GetIndexType(), *descriptorSets, uniformOffset, drawConstants, bindlessTextures->set(), drawBuffer, drawCount);
+			}
+			else {
+				commandBuffers->RecordCommandBuffer(currentFrame, imageIndex, currentModel->GetVertextBuffer(), currentModel->GetIndexBuffer(), currentModel->GetIndexCount(), currentModel->GetIndexType(), *descriptorSets, uniformOffset, drawConstants);
+			}
+		}
 
 		VkSemaphore signalSemaphores[] = { fencesAndSemaphores->renderFinished(currentFrame) };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-
-		if (vkQueueSubmit(device->graphicsQueue(), 1, &submitInfo, fencesAndSemaphores->inFlightFence(currentFrame)) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
+		{
+			CpuZone zone("submit");
+			fencesAndSemaphores->frameValue(currentFrame) = gpuTimeline->Submit(device->graphicsQueue(), commandBuffers->command(currentFrame),
+				fencesAndSemaphores->imageAvailable(currentFrame), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, signalSemaphores[0]);
 		}
+		latencyTracker->Submitted(currentFrame, fencesAndSemaphores->frameValue(currentFrame));
+		if (streamingMesh) {
+			streamingMesh->Submitted(fencesAndSemaphores->frameValue(currentFrame));
+		}
+		gpuProfiler->Submitted(currentFrame, fencesAndSemaphores->frameValue(currentFrame));
 
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -277,48 +514,43 @@ private:
 
 		presentInfo.pImageIndices = &imageIndex;
 
-		result = vkQueuePresentKHR(device->presentQueue(), &presentInfo);
+		{
+			CpuZone zone("present");
+			result = vkQueuePresentKHR(device->presentQueue(), &presentInfo);
+		}
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
 			recreateSwapChain(framebufferResized);
-			framebufferResized = false;
 		}
 		else if (result != VK_SUCCESS) {
 			throw std::runtime_error("Failed to present swap chain image");
 		}
 
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		latencyTracker->Report(std::cout, pacingLabel(), LATENCY_REPORT_INTERVAL);
+		gpuProfiler->Report(std::cout, LATENCY_REPORT_INTERVAL);
+		CpuProfiler::Collect();
+		CpuProfiler::Report(std::cout, LATENCY_REPORT_INTERVAL);
+		currentFrame = (currentFrame + 1) % framePacing.framesInFlight;
 
 	}
 
+	// Clears framebufferResized once the swap chain matches the surface. A surface without a size, the window was
+	// minimized after the update sampled it, leaves it set so a later frame tries again
 	void recreateSwapChain(bool& framebufferResized) {
+		CpuZone zone("recreate swap chain");
 		framebufferResized = true;
 
-		int awidth = 800;
-		int aheight = 400;
-		window->framebufferSize(awidth, aheight);
-		while (awidth == 0 || aheight == 0) {
-			window->framebufferSize(awidth, aheight);
-			glfwWaitEvents();
+		VkSurfaceCapabilitiesKHR capabilities;
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->physical(), window->surface(), &capabilities);
+		VkExtent2D extent = SwapChain::ChooseSwapExtent(capabilities, *window);
+		if (extent.width == 0 || extent.height == 0) {
+			return;
 		}
-		vkDeviceWaitIdle(device->logical());
 
-		//Destroy depth resources
-		renderPass->destroyDepthResources();
-		//Destroy framebuffers
-		renderPass->destroyFrameBuffers();
-		//Destroy image views
-		swapChain->destroyImageViews();
-		//Destroy swap chain
-		swapChain->destroySwapChain();
-		
-		//Create swapchain
-		swapChain->createSwapChain();
-		//Create image views
-		swapChain->createImageViews();
-		//Create depth resources
-		renderPass->CreateDepthResources();
-		//Create frame buffers
-		renderPass->CreateFramebuffers();
+		// Frames still in flight keep the old swap chain, framebuffers and depth image alive through the timeline,
+		// so nothing here waits for the GPU
+		swapChain->recreate(*gpuTimeline);
+		renderPass->recreate(*gpuTimeline);
+		framebufferResized = false;
 
 		//graphicsPipeline->recreate();
 
@@ -330,6 +562,11 @@ private:
 		renderPass->cleanupOld();*/
 	}
 
+	std::string pacingLabel() {
+		return std::string(FramePacing::PresentModeName(swapChain->presentMode())) + ", " + std::to_string(framePacing.framesInFlight)
+			+ (framePacing.framesInFlight == 1 ? " frame" : " frames") + " in flight" + (framePacing.lowLatency ? ", low latency" : "");
+	}
+
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
 		for (VkFormat format : candidates) {
 			VkFormatProperties props;
@@ -347,41 +584,363 @@ private:
 	}
 
 
-	void createUniformBuffers() {
-		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	// One indirect draw per material, the model currently has a single one
+	void createDrawBuffer(uint32_t material) {
+		std::vector<VkDrawIndexedIndirectCommand> draws(1);
+		draws[0].indexCount = currentModel->GetIndexCount();
+		draws[0].instanceCount = 1;
+		draws[0].firstIndex = 0;
+		draws[0].vertexOffset = 0;
+		draws[0].firstInstance = material;
+		drawCount = static_cast<uint32_t>(draws.size());
+
+		VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * draws.size();
+		Model::CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawBuffer, drawBufferMemory, *device, MemoryCategory::Other);
+
+		void* data;
+		vkMapMemory(device->logical(), drawBufferMemory, 0, bufferSize, 0, &data);
+		memcpy(data, draws.data(), static_cast<size_t>(bufferSize));
+		vkUnmapMemory(device->logical(), drawBufferMemory);
+	}
+
+	// Returns the dynamic offset of this frame's block, the per-draw transform goes into drawConstants and the
+	// matrices it was built from into ubo. The projection follows the swap chain, which only the render thread sees
+	uint32_t updateUniformBuffer(const FrameSnapshot& snapshot, DrawConstants& drawConstants, UniformBufferObject& ubo) {
+		ubo = {};
+		ubo.view = snapshot.view;
+		ubo.proj = glm::perspective(glm::radians(45.0f), swapChain->extent().width / (float)swapChain->extent().height, 0.1f, 10.0f);
+		ubo.proj[1][1] *= -1;
+		ubo.viewProj = ubo.proj * ubo.view;
 
-		uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-		uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-		uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+		drawConstants.mvp = ubo.viewProj * snapshot.model;
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			Model::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], *device);
+		return uniformRing->Push(ubo);
+	}
+};
 
-			vkMapMemory(device->logical(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+// The one %d, %Nd or %0Nd in a --headless output pattern with the text around it. The pattern is never handed to
+// printf, so any other conversion is rejected instead of being read from the wrong argument
+struct FramePattern {
+	std::string prefix;
+	std::string suffix;
+	size_t width = 0;
+	char fill = ' ';
+
+	// False for a path without %, throws for anything but a single integer conversion
+	bool Parse(const std::string& pattern) {
+		size_t percent = pattern.find('%');
+		if (percent == std::string::npos) {
+			return false;
 		}
+		size_t i = percent + 1;
+		if (i < pattern.size() && pattern[i] == '0') {
+			fill = '0';
+			++i;
+		}
+		size_t digits = i;
+		while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9') {
+			++i;
+		}
+		if (i - digits > 3 || i == pattern.size() || pattern[i] != 'd' || pattern.find('%', i) != std::string::npos) {
+			throw std::runtime_error("--output supports a single %d or %0Nd, got " + pattern + "!");
+		}
+		width = i > digits ? std::stoul(pattern.substr(digits, i - digits)) : 0;
+		prefix = pattern.substr(0, percent);
+		suffix = pattern.substr(i + 1);
+		return true;
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
-		static auto startTime = std::chrono::high_resolution_clock::now();
+	std::string Format(uint32_t frame) const {
+		std::string number = std::to_string(frame);
+		if (number.size() < width) {
+			number.insert(0, width - number.size(), fill);
+		}
+		return prefix + number + suffix;
+	}
+};
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+// --headless [--size WxH] [--count N] [--output path] [--frames N] [--validation] [model] [texture]
+// Renders count frames of the rotating model at 60 fps steps without a window. An output path with a frame number
+// pattern (frame_%04d.png) gets every frame, otherwise only the last one is written.
+void runHeadless(int argc, char* argv[]) {
+	uint32_t width = 800;
+	uint32_t height = 600;
+	uint32_t count = 1;
+	std::string output = "frame.png";
+	bool validation = false;
+	FramePacing framePacing;
+	std::vector<std::string> paths;
+
+	for (int i = 2; i < argc; ++i) {
+		if (framePacing.ParseArgument(argc, argv, i) || CpuProfiler::ParseArgument(argc, argv, i) || MemoryTracker::ParseArgument(argc, argv, i) || JobSystem::ParseArgument(argc, argv, i)) {
+			continue;
+		}
 
-		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(45.0f), swapChain->extent().width / (float)swapChain->extent().height, 0.1f, 10.0f);
-		ubo.proj[1][1] *= -1;
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--size" && hasValue) {
+			std::string size = argv[++i];
+			size_t x = size.find('x');
+			if (x == std::string::npos) {
+				throw std::runtime_error("--size expects WIDTHxHEIGHT!");
+			}
+			width = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+			height = static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+		}
+		else if (arg == "--count" && hasValue) {
+			count = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--output" && hasValue) {
+			output = argv[++i];
+		}
+		else if (arg == "--validation") {
+			validation = true;
+		}
+		else if (arg.compare(0, 2, "--") != 0) {
+			paths.push_back(arg);
+		}
+		else {
+			throw std::runtime_error("unknown argument " + arg + "!");
+		}
+	}
 
-		memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	FramePattern pattern;
+	bool everyFrame = pattern.Parse(output);
+	std::string modelPath = paths.size() > 0 ? paths[0] : (std::ifstream(PACKAGE_PATH, std::ios::binary).good() ? PACKAGE_PATH : MODEL_PATH);
+	std::string texturePath = paths.size() > 1 ? paths[1] : TEXTURE_PATH;
+
+	HeadlessRenderer renderer(width, height, framePacing.framesInFlight, validation);
+	renderer.LoadScene(modelPath, texturePath);
+
+	auto start = std::chrono::steady_clock::now();
+	uint32_t image = 0;
+	for (uint32_t frame = 0; frame < count; ++frame) {
+		image = renderer.RenderFrame(frame / 60.0f);
+		if (everyFrame) {
+			renderer.WriteFrame(image, pattern.Format(frame));
+		}
+		// Drained every frame like in the viewer, a long run would otherwise overflow the rings and drop zones
+		CpuProfiler::Collect();
+	}
+	if (!everyFrame) {
+		renderer.WriteFrame(image, output);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << count << " frames at " << width << "x" << height << " in " << seconds << " s (" << count / seconds << " fps)" << std::endl;
+	CpuProfiler::Finish(std::cout);
+	if (MemoryTracker::reporting()) {
+		renderer.device().memory().Report(std::cout);
+	}
+}
+
+void runThumbnails(int argc, char* argv[]) {
+	uint32_t width = 256;
+	uint32_t height = 256;
+	uint32_t slots = 3;
+	std::string output = "thumbnails";
+	std::string texturePath = TEXTURE_PATH;
+	bool validation = false;
+	std::vector<std::string> arguments;
+
+	for (int i = 2; i < argc; ++i) {
+		if (CpuProfiler::ParseArgument(argc, argv, i) || MemoryTracker::ParseArgument(argc, argv, i) || AsyncFileReader::ParseArgument(argc, argv, i) || JobSystem::ParseArgument(argc, argv, i)) {
+			continue;
+		}
+
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--size" && hasValue) {
+			std::string size = argv[++i];
+			size_t x = size.find('x');
+			if (x == std::string::npos) {
+				throw std::runtime_error("--size expects WIDTHxHEIGHT!");
+			}
+			width = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+			height = static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+		}
+		else if (arg == "--slots" && hasValue) {
+			slots = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--out" && hasValue) {
+			output = argv[++i];
+		}
+		else if (arg == "--texture" && hasValue) {
+			texturePath = argv[++i];
+		}
+		else if (arg == "--validation") {
+			validation = true;
+		}
+		else if (arg.compare(0, 2, "--") != 0) {
+			arguments.push_back(arg);
+		}
+		else {
+			throw std::runtime_error("unknown argument " + arg + "!");
+		}
+	}
+
+	std::vector<std::string> inputs = ThumbnailBatch::CollectInputs(arguments);
+	if (inputs.empty()) {
+		throw std::runtime_error("no models to render!");
+	}
+
+	HeadlessRenderer renderer(width, height, slots, validation);
+	ThumbnailBatch batch(renderer, output, texturePath);
+	batch.Run(inputs);
+	batch.Report(std::cout);
+	CpuProfiler::Finish(std::cout);
+	if (MemoryTracker::reporting()) {
+		renderer.device().memory().Report(std::cout);
+	}
+}
+
+void runLoaderBenchmark(int argc, char* argv[]) {
+	LoaderBenchmarkOptions options;
+
+	for (int i = 2; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--sizes" && hasValue) {
+			std::stringstream sizes(argv[++i]);
+			std::string size;
+			options.sizes.clear();
+			while (std::getline(sizes, size, ',')) {
+				options.sizes.push_back(std::stoull(size));
+			}
+		}
+		else if (arg == "--filter" && hasValue) {
+			options.filter = argv[++i];
+		}
+		else if (arg == "--min-time" && hasValue) {
+			options.minSeconds = std::stod(argv[++i]);
+		}
+		else if (arg == "--no-gpu") {
+			options.gpu = false;
+		}
+		else {
+			throw std::runtime_error("unknown argument " + arg + "!");
+		}
 	}
-};
 
-int main() {
+	Benchmarks::RunLoaderBenchmark(options);
+}
+
+bool runRenderBenchmark(int argc, char* argv[]) {
+	RenderBenchmarkOptions options;
+	FramePacing framePacing;
+	std::string texturePath = TEXTURE_PATH;
+	std::string suitePath;
+	std::vector<std::string> models;
+
+	for (int i = 2; i < argc; ++i) {
+		if (framePacing.ParseArgument(argc, argv, i)) {
+			continue;
+		}
+
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--size" && hasValue) {
+			std::string size = argv[++i];
+			size_t x = size.find('x');
+			if (x == std::string::npos) {
+				throw std::runtime_error("--size expects WIDTHxHEIGHT!");
+			}
+			options.width = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+			options.height = static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+		}
+		else if (arg == "--count" && hasValue) {
+			options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--warmup" && hasValue) {
+			options.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--out" && hasValue) {
+			options.outputPath = argv[++i];
+		}
+		else if (arg == "--baseline" && hasValue) {
+			options.baselinePath = argv[++i];
+		}
+		else if (arg == "--update-baseline") {
+			options.updateBaseline = true;
+		}
+		else if (arg == "--tolerance" && hasValue) {
+			options.tolerance = std::stod(argv[++i]);
+		}
+		else if (arg == "--suite" && hasValue) {
+			suitePath = argv[++i];
+		}
+		else if (arg == "--texture" && hasValue) {
+			texturePath = argv[++i];
+		}
+		else if (arg == "--validation") {
+			options.validation = true;
+		}
+		else if (arg.compare(0, 2, "--") != 0) {
+			models.push_back(arg);
+		}
+		else {
+			throw std::runtime_error("unknown argument " + arg + "!");
+		}
+	}
+
+	if (!suitePath.empty()) {
+		options.cases = Benchmarks::ReadSuite(suitePath, texturePath);
+	}
+	for (const std::string& model : models) {
+		options.cases.push_back({ "", model, texturePath });
+	}
+	if (options.cases.empty()) {
+		options.cases.push_back({ "", std::ifstream(PACKAGE_PATH, std::ios::binary).good() ? PACKAGE_PATH : MODEL_PATH, texturePath });
+	}
+	options.framesInFlight = framePacing.framesInFlight;
+
+	return Benchmarks::RunRenderBenchmark(options);
+}
+
+int main(int argc, char* argv[]) {
 	HelloTriangleApplication app;
 
 	try {
-		app.run();
+		std::string mode = argc > 1 ? argv[1] : "";
+
+		if (mode == "--bench-bvh") {
+			Benchmarks::RunBVHBenchmark(argc > 2 ? std::stoull(argv[2]) : 5000000);
+		}
+		else if (mode == "--bench-loader") {
+			runLoaderBenchmark(argc, argv);
+		}
+		else if (mode == "--bench-jobs") {
+			Benchmarks::RunJobBenchmark(argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : std::max(1u, std::thread::hardware_concurrency()));
+		}
+		else if (mode == "--bench-render") {
+			if (!runRenderBenchmark(argc, argv)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else if (mode == "--headless") {
+			runHeadless(argc, argv);
+		}
+		else if (mode == "--thumbnails") {
+			runThumbnails(argc, argv);
+		}
+		else {
+			for (int i = 1; i < argc; ++i) {
+				std::string arg = argv[i];
+				if (arg == "--bindless") {
+					app.useBindless = true;
+				}
+				else if (arg == "--stream" && i + 1 < argc) {
+					app.streamPath = argv[++i];
+				}
+				else if (arg == "--stream-pool" && i + 1 < argc) {
+					app.streamPoolSize = static_cast<VkDeviceSize>(std::stod(argv[++i]) * 1024 * 1024);
+				}
+				else if (!app.framePacing.ParseArgument(argc, argv, i) && !CpuProfiler::ParseArgument(argc, argv, i) && !MemoryTracker::ParseArgument(argc, argv, i) && !JobSystem::ParseArgument(argc, argv, i)) {
+					throw std::runtime_error("unknown argument " + arg + "!");
+				}
+			}
+			app.run();
+		}
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
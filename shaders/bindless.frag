@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
+
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+layout(set = 1, binding = 2) readonly buffer Materials {
+	uint samplerIndex[];
+} materials;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    uint samplerSlot = materials.samplerIndex[fragMaterial];
+    outColor = texture(sampler2D(textures[nonuniformEXT(fragMaterial)], samplers[nonuniformEXT(samplerSlot)]), fragTexCoord);
+}
@@ -0,0 +1,27 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 view;
+	mat4 proj;
+	mat4 viewProj;
+} ubo;
+
+layout(push_constant) uniform DrawConstants {
+	mat4 mvp;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+
+void main() {
+    gl_Position = draw.mvp * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	fragTexCoord = inTexCoord;
+	// firstInstance of the indirect draw carries the material ID
+	fragMaterial = gl_InstanceIndex;
+}
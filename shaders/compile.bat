@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe bindless.vert -o bindless_vert.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe bindless.frag -o bindless_frag.spv
 pause
\ No newline at end of file
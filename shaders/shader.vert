@@ -1,11 +1,15 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-	mat4 model;
 	mat4 view;
 	mat4 proj;
+	mat4 viewProj;
 } ubo;
 
+layout(push_constant) uniform DrawConstants {
+	mat4 mvp;
+} draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -14,7 +18,7 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = draw.mvp * vec4(inPosition, 1.0);
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
 }
\ No newline at end of file